@@ -0,0 +1,795 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#include "spatial_hash/SpatialHash2DVector.h"
+#include "spatial_hash/SpatialHash3DVector.h"
+#include "spatial_hash/SpatialHash3DCompact.h"
+#include "spatial_hash/SpatialHash3DPoints.h"
+#include "spatial_hash/SpatialHash3DRolling.h"
+#include "spatial_hash/SpatialHash3DPyramid.h"
+#include "spatial_hash/SpatialHashNDVector.h"
+#include "spatial_hash/VoxelDownsample.h"
+#include "spatial_hash/BatchSearch.h"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+#include <cmath>
+
+using namespace libs::spatial_hash;
+
+namespace {
+
+/// @brief Point cloud shapes
+enum CloudType : int64_t {
+    kUniform = 0,   // uniform in [-10, 10] cube / square
+    kClustered = 1, // gaussian clusters around random centers
+    kSphere = 2,    // sphere / circle surface of radius 10
+};
+
+/// @brief Fixed seed, every run benchmarks the same clouds and queries
+constexpr uint32_t kSeed = 42;
+constexpr size_t kQueryCount = 1024;
+constexpr size_t kQueryCloudSize = 100000;
+constexpr double kVoxelSize = 0.5;
+
+/// @brief Generates point cloud as array of "count" points with "Dim" coordinates.
+/// @param cloud_type - CloudType
+/// @param count - number of points
+template<typename DataType, int Dim>
+std::vector<DataType> GenerateCloud(int64_t cloud_type, size_t count, uint32_t seed = kSeed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> uniform(-10.0, 10.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    std::vector<double> cluster_centers(64 * Dim);
+    for(double& value : cluster_centers) {
+        value = uniform(rng);
+    }
+
+    std::vector<DataType> result(count * Dim);
+    for(size_t i = 0; i < count; ++i) {
+        DataType* point = result.data() + Dim * i;
+        if (kUniform == cloud_type) {
+            for(int j = 0; j < Dim; ++j) {
+                point[j] = static_cast<DataType>(uniform(rng));
+            }
+        } else if (kClustered == cloud_type) {
+            const double* center = cluster_centers.data() + Dim * (rng() % 64);
+            for(int j = 0; j < Dim; ++j) {
+                point[j] = static_cast<DataType>(center[j] + 0.3 * normal(rng));
+            }
+        } else {
+            double direction[Dim];
+            double norm = 0;
+            do {
+                norm = 0;
+                for(int j = 0; j < Dim; ++j) {
+                    direction[j] = normal(rng);
+                    norm += direction[j] * direction[j];
+                }
+            } while (norm < 1e-12);
+            norm = std::sqrt(norm);
+            for(int j = 0; j < Dim; ++j) {
+                point[j] = static_cast<DataType>(10.0 * direction[j] / norm);
+            }
+        }
+    }
+    return result;
+}
+
+/// @brief Query centers are sampled from the cloud itself, so queries hit populated regions
+template<typename DataType, int Dim>
+std::vector<DataType> SampleQueries(const std::vector<DataType>& cloud, size_t count, uint32_t seed = kSeed + 1) {
+    std::mt19937 rng(seed);
+    const size_t point_count = cloud.size() / Dim;
+    std::vector<DataType> result(count * Dim);
+    for(size_t i = 0; i < count; ++i) {
+        const size_t idx = rng() % point_count;
+        for(int j = 0; j < Dim; ++j) {
+            result[Dim * i + j] = cloud[Dim * idx + j];
+        }
+    }
+    return result;
+}
+
+void SetCloudLabel(benchmark::State& state, int64_t cloud_type) {
+    static const char* names[] = {"uniform", "clustered", "sphere"};
+    state.SetLabel(names[cloud_type]);
+}
+
+/// @brief Insert throughput of dynamic 3D table, args: cloud type, number of points
+template<typename DataType, typename MapBackend>
+void BM_Add3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), state.range(1));
+    const size_t count = state.range(1);
+    SpatialHashTable3DVector<DataType, uint32_t, MapBackend> table(kVoxelSize);
+    for (auto _ : state) {
+        table.Clear();
+        for(size_t i = 0; i < count; ++i) {
+            table.Add(cloud.data() + 3 * i, static_cast<uint32_t>(i));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Parallel build throughput of dynamic 3D table, args: cloud type, number of points, number of threads
+template<typename DataType, typename MapBackend>
+void BM_Build3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), state.range(1));
+    const size_t count = state.range(1);
+    SpatialHashTable3DVector<DataType, uint32_t, MapBackend> table(kVoxelSize);
+    for (auto _ : state) {
+        table.Build(cloud.data(), count, state.range(2));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Build throughput of compacted 3D table, args: cloud type, number of points
+template<typename DataType>
+void BM_Build3DCompact(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), state.range(1));
+    const size_t count = state.range(1);
+    SpatialHashTable3DCompact<DataType, uint32_t> table(kVoxelSize);
+    for (auto _ : state) {
+        table.Build(cloud.data(), count);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Cube search latency, args: cloud type, half size in voxels
+template<typename TableType, typename DataType>
+void RunCubeSearch(benchmark::State& state, const TableType& table, const std::vector<DataType>& queries) {
+    const DataType half_size = static_cast<DataType>(state.range(1) * kVoxelSize);
+    std::vector<uint32_t> buffer;
+    size_t query_idx = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        buffer.clear();
+        table.CubeSearch(queries.data() + 3 * query_idx, half_size, buffer);
+        found += buffer.size();
+        benchmark::DoNotOptimize(buffer.data());
+        query_idx = (query_idx + 1) % kQueryCount;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["refs"] = benchmark::Counter(static_cast<double>(found) / state.iterations());
+    SetCloudLabel(state, state.range(0));
+}
+
+template<typename DataType, typename MapBackend>
+void BM_CubeSearch3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kQueryCloudSize);
+    const auto queries = SampleQueries<DataType, 3>(cloud, kQueryCount);
+    SpatialHashTable3DVector<DataType, uint32_t, MapBackend> table(kVoxelSize);
+    table.Build(cloud.data(), kQueryCloudSize);
+    RunCubeSearch(state, table, queries);
+}
+
+/// @brief Sphere search latency, voxels outside the sphere are not probed, args: cloud type, radius in voxels
+template<typename DataType, typename MapBackend>
+void BM_SphereSearch3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kQueryCloudSize);
+    const auto queries = SampleQueries<DataType, 3>(cloud, kQueryCount);
+    SpatialHashTable3DVector<DataType, uint32_t, MapBackend> table(kVoxelSize);
+    table.Build(cloud.data(), kQueryCloudSize);
+
+    const DataType radius = static_cast<DataType>(state.range(1) * kVoxelSize);
+    std::vector<uint32_t> buffer;
+    size_t query_idx = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        buffer.clear();
+        table.SphereSearch(queries.data() + 3 * query_idx, radius, buffer);
+        found += buffer.size();
+        benchmark::DoNotOptimize(buffer.data());
+        query_idx = (query_idx + 1) % kQueryCount;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["refs"] = benchmark::Counter(static_cast<double>(found) / state.iterations());
+    SetCloudLabel(state, state.range(0));
+}
+
+template<typename DataType>
+void BM_CubeSearch3DCompact(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kQueryCloudSize);
+    const auto queries = SampleQueries<DataType, 3>(cloud, kQueryCount);
+    SpatialHashTable3DCompact<DataType, uint32_t> table(kVoxelSize);
+    table.Build(cloud.data(), kQueryCloudSize);
+    RunCubeSearch(state, table, queries);
+}
+
+/// @brief Linear scan baseline for cube search, args: cloud type, half size in voxels
+template<typename DataType>
+void BM_BruteForceCube3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kQueryCloudSize);
+    const auto queries = SampleQueries<DataType, 3>(cloud, kQueryCount);
+    const DataType half_size = static_cast<DataType>(state.range(1) * kVoxelSize);
+    std::vector<uint32_t> buffer;
+    size_t query_idx = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        buffer.clear();
+        const DataType* center = queries.data() + 3 * query_idx;
+        for(size_t i = 0; i < kQueryCloudSize; ++i) {
+            const DataType* point = cloud.data() + 3 * i;
+            if (std::abs(point[0] - center[0]) <= half_size &&
+                std::abs(point[1] - center[1]) <= half_size &&
+                std::abs(point[2] - center[2]) <= half_size) {
+                buffer.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        found += buffer.size();
+        benchmark::DoNotOptimize(buffer.data());
+        query_idx = (query_idx + 1) % kQueryCount;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["refs"] = benchmark::Counter(static_cast<double>(found) / state.iterations());
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Insert throughput of 2D table, args: cloud type, number of points
+template<typename DataType, typename MapBackend>
+void BM_Add2D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 2>(state.range(0), state.range(1));
+    const size_t count = state.range(1);
+    SpatialHashTable2DVector<DataType, uint32_t, MapBackend> table(kVoxelSize);
+    for (auto _ : state) {
+        table.Clear();
+        for(size_t i = 0; i < count; ++i) {
+            table.Add(cloud.data() + 2 * i, static_cast<uint32_t>(i));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Square search latency, args: cloud type, half size in cells
+template<typename DataType, typename MapBackend>
+void BM_SquareSearch2D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 2>(state.range(0), kQueryCloudSize);
+    const auto queries = SampleQueries<DataType, 2>(cloud, kQueryCount);
+    SpatialHashTable2DVector<DataType, uint32_t, MapBackend> table(kVoxelSize);
+    for(size_t i = 0; i < kQueryCloudSize; ++i) {
+        table.Add(cloud.data() + 2 * i, static_cast<uint32_t>(i));
+    }
+
+    const DataType half_size = static_cast<DataType>(state.range(1) * kVoxelSize);
+    std::vector<uint32_t> buffer;
+    size_t query_idx = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        buffer.clear();
+        table.SquareSearch(queries.data() + 2 * query_idx, half_size, buffer);
+        found += buffer.size();
+        benchmark::DoNotOptimize(buffer.data());
+        query_idx = (query_idx + 1) % kQueryCount;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["refs"] = benchmark::Counter(static_cast<double>(found) / state.iterations());
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Linear scan baseline for square search, args: cloud type, half size in cells
+template<typename DataType>
+void BM_BruteForceSquare2D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 2>(state.range(0), kQueryCloudSize);
+    const auto queries = SampleQueries<DataType, 2>(cloud, kQueryCount);
+    const DataType half_size = static_cast<DataType>(state.range(1) * kVoxelSize);
+    std::vector<uint32_t> buffer;
+    size_t query_idx = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        buffer.clear();
+        const DataType* center = queries.data() + 2 * query_idx;
+        for(size_t i = 0; i < kQueryCloudSize; ++i) {
+            const DataType* point = cloud.data() + 2 * i;
+            if (std::abs(point[0] - center[0]) <= half_size && std::abs(point[1] - center[1]) <= half_size) {
+                buffer.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        found += buffer.size();
+        benchmark::DoNotOptimize(buffer.data());
+        query_idx = (query_idx + 1) % kQueryCount;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["refs"] = benchmark::Counter(static_cast<double>(found) / state.iterations());
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief 4D (space-time) box search latency, args: cloud type, half size in cells
+template<typename DataType, typename MapBackend>
+void BM_BoxSearch4D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 4>(state.range(0), kQueryCloudSize);
+    const auto queries = SampleQueries<DataType, 4>(cloud, kQueryCount);
+    SpatialHashTable4DVector<DataType, uint32_t, MapBackend> table(kVoxelSize);
+    table.Build(cloud.data(), kQueryCloudSize);
+
+    const DataType half_size = static_cast<DataType>(state.range(1) * kVoxelSize);
+    std::vector<uint32_t> buffer;
+    size_t query_idx = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        buffer.clear();
+        table.BoxSearch(queries.data() + 4 * query_idx, half_size, buffer);
+        found += buffer.size();
+        benchmark::DoNotOptimize(buffer.data());
+        query_idx = (query_idx + 1) % kQueryCount;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["refs"] = benchmark::Counter(static_cast<double>(found) / state.iterations());
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Best K per voxel selection throughput, args: cloud type, K
+template<typename DataType, typename ContainerType>
+void BM_TopKAdd3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kQueryCloudSize);
+    const size_t limit = state.range(1);
+    std::mt19937 rng(kSeed);
+    std::uniform_real_distribution<DataType> score_dst(0, 1);
+    std::vector<DataType> scores(kQueryCloudSize);
+    for(DataType& score : scores) {
+        score = score_dst(rng);
+    }
+
+    // cell containers are benchmarked directly, voxel indices are precomputed
+    std::vector<HashIndex3D> indices(kQueryCloudSize);
+    for(size_t i = 0; i < kQueryCloudSize; ++i) {
+        const DataType* point = cloud.data() + 3 * i;
+        indices[i] = HashIndex3D(std::floor(point[0] / kVoxelSize), std::floor(point[1] / kVoxelSize), std::floor(point[2] / kVoxelSize));
+    }
+    FlatHashMap<HashIndex3D, ContainerType, SpatalHash3D> voxels;
+    for (auto _ : state) {
+        voxels.clear();
+        for(size_t i = 0; i < kQueryCloudSize; ++i) {
+            voxels[indices[i]].Add(scores[i], static_cast<uint32_t>(i), limit);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kQueryCloudSize);
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Voxel downsampling throughput, args: cloud type, DownsampleMode, number of threads
+template<typename DataType>
+void BM_VoxelDownsample3D(benchmark::State& state) {
+    const size_t count = 1000000;
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), count);
+    const DownsampleMode mode = static_cast<DownsampleMode>(state.range(1));
+    size_t voxel_count = 0;
+    for (auto _ : state) {
+        auto result = VoxelDownsample3D(cloud.data(), count, static_cast<DataType>(kVoxelSize), mode, state.range(2));
+        voxel_count = result.size() / 3;
+        benchmark::DoNotOptimize(result.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.counters["voxels"] = static_cast<double>(voxel_count);
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Centroid downsampling baseline, the table is built and voxels are averaged by walking GetTable(), args: cloud type
+template<typename DataType>
+void BM_VoxelDownsampleTable3D(benchmark::State& state) {
+    const size_t count = 1000000;
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), count);
+    SpatialHashTable3DVector<DataType, uint32_t, FlatHashMapBackend> table(kVoxelSize);
+    for (auto _ : state) {
+        table.Clear();
+        for(size_t i = 0; i < count; ++i) {
+            table.Add(cloud.data() + 3 * i, static_cast<uint32_t>(i));
+        }
+        std::vector<DataType> result;
+        result.reserve(3 * table.GetTable().size());
+        for(const auto& voxel : table.GetTable()) {
+            double sum[3] = {0, 0, 0};
+            for(uint32_t idx : voxel.second) {
+                for(int j = 0; j < 3; ++j) {
+                    sum[j] += cloud[3 * idx + j];
+                }
+            }
+            for(int j = 0; j < 3; ++j) {
+                result.push_back(static_cast<DataType>(sum[j] / voxel.second.size()));
+            }
+        }
+        benchmark::DoNotOptimize(result.data());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief All pairs within radius self join, args: cloud type, radius in voxel sizes x 4, number of threads
+template<typename DataType>
+void BM_RadiusPairs3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kQueryCloudSize);
+    const DataType radius = static_cast<DataType>(kVoxelSize * state.range(1) / 4);
+    SpatialHashTable3DPoints<DataType, uint32_t, FlatHashMapBackend> table(kVoxelSize);
+    for(size_t i = 0; i < kQueryCloudSize; ++i) {
+        table.Add(cloud.data() + 3 * i, static_cast<uint32_t>(i));
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    for (auto _ : state) {
+        pairs.clear();
+        table.RadiusPairs(radius, pairs, state.range(2));
+        benchmark::DoNotOptimize(pairs.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kQueryCloudSize);
+    state.counters["pairs"] = static_cast<double>(pairs.size());
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Per frame batch of cube searches, args: cloud type, batch size, number of threads
+template<typename DataType>
+void BM_BatchCubeSearch3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kQueryCloudSize);
+    const size_t batch_size = static_cast<size_t>(state.range(1));
+    SpatialHashTable3DVector<DataType, uint32_t, FlatHashMapBackend> table(kVoxelSize);
+    for(size_t i = 0; i < kQueryCloudSize; ++i) {
+        table.Add(cloud.data() + 3 * i, static_cast<uint32_t>(i));
+    }
+
+    BatchSearchResult<uint32_t> result;
+    for (auto _ : state) {
+        BatchCubeSearch(table, cloud.data(), batch_size, static_cast<DataType>(kVoxelSize), state.range(2), result);
+        benchmark::DoNotOptimize(result.Begin(0));
+    }
+    state.SetItemsProcessed(state.iterations() * batch_size);
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Dispatch overhead of a parallel loop with trivial work, args: number of threads
+void BM_ParallelFor(benchmark::State& state) {
+    const size_t num_threads = static_cast<size_t>(state.range(0));
+    std::vector<size_t> sums(num_threads);
+    for (auto _ : state) {
+        ParallelFor(1024, num_threads, [&sums](size_t thread_idx, size_t begin, size_t end) {
+            sums[thread_idx] += end - begin;
+        });
+        benchmark::DoNotOptimize(sums.data());
+    }
+}
+
+/// @brief Self join baseline, radius search per point, every pair is found twice, args: cloud type, radius in voxel sizes x 4
+template<typename DataType>
+void BM_RadiusSearchPairs3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kQueryCloudSize);
+    const DataType radius = static_cast<DataType>(kVoxelSize * state.range(1) / 4);
+    SpatialHashTable3DPoints<DataType, uint32_t, FlatHashMapBackend> table(kVoxelSize);
+    for(size_t i = 0; i < kQueryCloudSize; ++i) {
+        table.Add(cloud.data() + 3 * i, static_cast<uint32_t>(i));
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    std::vector<uint32_t> buffer;
+    for (auto _ : state) {
+        pairs.clear();
+        for(uint32_t i = 0; i < kQueryCloudSize; ++i) {
+            buffer.clear();
+            table.RadiusSearch(cloud.data() + 3 * i, radius, buffer);
+            for(uint32_t ref : buffer) {
+                if (i < ref) {
+                    pairs.emplace_back(i, ref);
+                }
+            }
+        }
+        benchmark::DoNotOptimize(pairs.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kQueryCloudSize);
+    state.counters["pairs"] = static_cast<double>(pairs.size());
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Random ray directions, fixed seed
+template<typename DataType>
+std::vector<DataType> SampleDirections(size_t count, uint32_t seed = kSeed + 2) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::vector<DataType> result(3 * count);
+    for(DataType& value : result) {
+        value = static_cast<DataType>(normal(rng));
+    }
+    return result;
+}
+
+/// @brief Ray traversal latency, args: cloud type, ray length in voxels
+template<typename DataType>
+void BM_Raycast3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kQueryCloudSize);
+    const auto origins = SampleQueries<DataType, 3>(cloud, kQueryCount);
+    const auto directions = SampleDirections<DataType>(kQueryCount);
+    const DataType max_range = static_cast<DataType>(kVoxelSize * state.range(1));
+    SpatialHashTable3DVector<DataType, uint32_t, FlatHashMapBackend> table(kVoxelSize);
+    table.Build(cloud.data(), kQueryCloudSize);
+
+    size_t query_idx = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        table.Raycast(origins.data() + 3 * query_idx, directions.data() + 3 * query_idx, max_range,
+            [&found](uint32_t, DataType) { ++found; });
+        query_idx = (query_idx + 1) % kQueryCount;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["refs"] = benchmark::Counter(static_cast<double>(found) / state.iterations());
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Ray baseline, cube search over the ray bounding box, args: cloud type, ray length in voxels
+template<typename DataType>
+void BM_RayBoxSearch3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kQueryCloudSize);
+    const auto origins = SampleQueries<DataType, 3>(cloud, kQueryCount);
+    const auto directions = SampleDirections<DataType>(kQueryCount);
+    const DataType max_range = static_cast<DataType>(kVoxelSize * state.range(1));
+    SpatialHashTable3DVector<DataType, uint32_t, FlatHashMapBackend> table(kVoxelSize);
+    table.Build(cloud.data(), kQueryCloudSize);
+
+    std::vector<DataType> ends(3 * kQueryCount);
+    for(size_t i = 0; i < kQueryCount; ++i) {
+        const DataType* d = directions.data() + 3 * i;
+        const DataType norm = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        for(int j = 0; j < 3; ++j) {
+            ends[3 * i + j] = origins[3 * i + j] + max_range * d[j] / norm;
+        }
+    }
+
+    size_t query_idx = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        table.ForEachInCube(origins.data() + 3 * query_idx, ends.data() + 3 * query_idx, [&found](uint32_t) { ++found; });
+        query_idx = (query_idx + 1) % kQueryCount;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["refs"] = benchmark::Counter(static_cast<double>(found) / state.iterations());
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Camera frustums with 90 degree field of view looking along sampled directions
+template<typename DataType>
+std::vector<ConvexRegion<DataType, 3>> SampleFrustums(const std::vector<DataType>& origins, DataType depth) {
+    const auto directions = SampleDirections<DataType>(kQueryCount);
+    std::vector<ConvexRegion<DataType, 3>> result;
+    for(size_t q = 0; q < kQueryCount; ++q) {
+        const DataType* o = origins.data() + 3 * q;
+        const DataType* d = directions.data() + 3 * q;
+        const DataType norm = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        const DataType f[3] = {d[0] / norm, d[1] / norm, d[2] / norm};
+        // any axis not parallel to the view direction gives the image plane basis
+        const DataType a[3] = {std::abs(f[0]) < DataType(0.9) ? DataType(1) : DataType(0), std::abs(f[0]) < DataType(0.9) ? DataType(0) : DataType(1), 0};
+        DataType u[3] = {f[1] * a[2] - f[2] * a[1], f[2] * a[0] - f[0] * a[2], f[0] * a[1] - f[1] * a[0]};
+        const DataType u_norm = std::sqrt(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+        for(DataType& value : u) {
+            value /= u_norm;
+        }
+        const DataType v[3] = {f[1] * u[2] - f[2] * u[1], f[2] * u[0] - f[0] * u[2], f[0] * u[1] - f[1] * u[0]};
+
+        DataType near[12];
+        DataType far[12];
+        const int signs[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+        for(int c = 0; c < 4; ++c) {
+            for(int j = 0; j < 3; ++j) {
+                const DataType side = signs[c][0] * u[j] + signs[c][1] * v[j];
+                near[3 * c + j] = o[j] + DataType(kVoxelSize) * (f[j] + side);
+                far[3 * c + j] = o[j] + depth * (f[j] + side);
+            }
+        }
+        result.push_back(ConvexRegion<DataType, 3>::Frustum(near, far));
+    }
+    return result;
+}
+
+/// @brief Exact frustum query with voxel culling, points of inside voxels aren't tested, args: cloud type, depth in voxels
+template<typename DataType>
+void BM_FrustumSearch3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kQueryCloudSize);
+    const auto frustums = SampleFrustums(SampleQueries<DataType, 3>(cloud, kQueryCount), static_cast<DataType>(kVoxelSize * state.range(1)));
+    SpatialHashTable3DVector<DataType, uint32_t, FlatHashMapBackend> table(kVoxelSize);
+    table.Build(cloud.data(), kQueryCloudSize);
+
+    std::vector<uint32_t> inside;
+    std::vector<uint32_t> boundary;
+    size_t query_idx = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        const auto& frustum = frustums[query_idx];
+        inside.clear();
+        boundary.clear();
+        table.RegionSearch(frustum, inside, boundary);
+        found += inside.size();
+        for(uint32_t ref : boundary) {
+            found += frustum.IsInside(cloud.data() + 3 * static_cast<size_t>(ref)) ? 1 : 0;
+        }
+        query_idx = (query_idx + 1) % kQueryCount;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["refs"] = benchmark::Counter(static_cast<double>(found) / state.iterations());
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Frustum query baseline, bounding box search and per point test, args: cloud type, depth in voxels
+template<typename DataType>
+void BM_FrustumBoxSearch3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kQueryCloudSize);
+    const auto frustums = SampleFrustums(SampleQueries<DataType, 3>(cloud, kQueryCount), static_cast<DataType>(kVoxelSize * state.range(1)));
+    SpatialHashTable3DVector<DataType, uint32_t, FlatHashMapBackend> table(kVoxelSize);
+    table.Build(cloud.data(), kQueryCloudSize);
+
+    size_t query_idx = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        const auto& frustum = frustums[query_idx];
+        table.ForEachInCube(frustum.GetMin(), frustum.GetMax(), [&](uint32_t ref) {
+            found += frustum.IsInside(cloud.data() + 3 * static_cast<size_t>(ref)) ? 1 : 0;
+        });
+        query_idx = (query_idx + 1) % kQueryCount;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["refs"] = benchmark::Counter(static_cast<double>(found) / state.iterations());
+    SetCloudLabel(state, state.range(0));
+}
+
+constexpr size_t kScanSize = 10000;
+
+/// @brief Scan of the sensor moving along x axis, the cloud is shifted to the pose of the frame
+template<typename DataType>
+void ShiftScan(const std::vector<DataType>& cloud, uint32_t frame, DataType* scan) {
+    const DataType offset = static_cast<DataType>(0.37 * frame);
+    for(size_t i = 0; i < kScanSize; ++i) {
+        scan[3 * i] = cloud[3 * i] + offset;
+        scan[3 * i + 1] = cloud[3 * i + 1];
+        scan[3 * i + 2] = cloud[3 * i + 2];
+    }
+}
+
+/// @brief Rolling local map frame time, one scan is added and the oldest epoch evicted, args: cloud type, window in frames
+template<typename DataType>
+void BM_RollingMap3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kScanSize);
+    const uint32_t window = static_cast<uint32_t>(state.range(1));
+    SpatialHashTable3DRolling<DataType, uint32_t> table(kVoxelSize);
+    std::vector<DataType> scan(3 * kScanSize);
+
+    uint32_t frame = 0;
+    for (auto _ : state) {
+        ShiftScan(cloud, frame, scan.data());
+        for(size_t i = 0; i < kScanSize; ++i) {
+            table.Add(scan.data() + 3 * i, static_cast<uint32_t>(i), frame);
+        }
+        table.EvictOlderThan(frame + 1 >= window ? frame + 1 - window : 0);
+        ++frame;
+    }
+    state.SetItemsProcessed(state.iterations() * kScanSize);
+    state.counters["voxels"] = benchmark::Counter(static_cast<double>(table.GetTable().size()));
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Rolling map baseline, the table is rebuilt from the window scans every frame, args: cloud type, window in frames
+template<typename DataType>
+void BM_RebuildMap3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kScanSize);
+    const size_t window = static_cast<size_t>(state.range(1));
+    SpatialHashTable3DVector<DataType, uint32_t, FlatHashMapBackend> table(kVoxelSize);
+    std::vector<DataType> scans(3 * kScanSize * window);
+
+    uint32_t frame = 0;
+    for (auto _ : state) {
+        ShiftScan(cloud, frame, scans.data() + 3 * kScanSize * (frame % window));
+        table.Build(scans.data(), kScanSize * std::min<size_t>(frame + 1, window));
+        ++frame;
+    }
+    state.SetItemsProcessed(state.iterations() * kScanSize);
+    state.counters["voxels"] = benchmark::Counter(static_cast<double>(table.GetTable().size()));
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Sphere search by descent from the coarse level, args: cloud type, radius in voxels
+template<typename DataType>
+void BM_PyramidSphereSearch3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kQueryCloudSize);
+    const auto queries = SampleQueries<DataType, 3>(cloud, kQueryCount);
+    SpatialHashTable3DPyramid<DataType, uint32_t, FlatHashMapBackend> table(kVoxelSize);
+    table.Build(cloud.data(), kQueryCloudSize);
+
+    const DataType radius = static_cast<DataType>(state.range(1) * kVoxelSize);
+    std::vector<uint32_t> buffer;
+    size_t query_idx = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        buffer.clear();
+        table.SphereSearchHierarchical(queries.data() + 3 * query_idx, radius, buffer);
+        found += buffer.size();
+        benchmark::DoNotOptimize(buffer.data());
+        query_idx = (query_idx + 1) % kQueryCount;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["refs"] = benchmark::Counter(static_cast<double>(found) / state.iterations());
+    SetCloudLabel(state, state.range(0));
+}
+
+/// @brief Sphere count, coarse voxels inside the sphere are counted without descent, args: cloud type, radius in voxels
+template<typename DataType>
+void BM_PyramidCountInSphere3D(benchmark::State& state) {
+    const auto cloud = GenerateCloud<DataType, 3>(state.range(0), kQueryCloudSize);
+    const auto queries = SampleQueries<DataType, 3>(cloud, kQueryCount);
+    SpatialHashTable3DPyramid<DataType, uint32_t, FlatHashMapBackend> table(kVoxelSize);
+    table.Build(cloud.data(), kQueryCloudSize);
+
+    const DataType radius = static_cast<DataType>(state.range(1) * kVoxelSize);
+    size_t query_idx = 0;
+    size_t found = 0;
+    for (auto _ : state) {
+        found += table.CountInSphere(queries.data() + 3 * query_idx, radius);
+        query_idx = (query_idx + 1) % kQueryCount;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["refs"] = benchmark::Counter(static_cast<double>(found) / state.iterations());
+    SetCloudLabel(state, state.range(0));
+}
+
+const std::vector<int64_t> kClouds = {kUniform, kClustered, kSphere};
+const std::vector<int64_t> kAddCounts = {10000, 1000000};
+const std::vector<int64_t> kBuildThreads = {1, 2, 4, 8, 16};
+const std::vector<int64_t> kHalfSizes = {0, 1, 2, 4, 8};
+/// @brief Radii over three orders of magnitude in voxels
+const std::vector<int64_t> kPyramidRadii = {1, 8, 64, 512};
+
+}
+
+BENCHMARK_TEMPLATE(BM_Add3D, float, StdHashMapBackend)->ArgsProduct({kClouds, kAddCounts})->ArgNames({"cloud", "points"});
+BENCHMARK_TEMPLATE(BM_Add3D, float, FlatHashMapBackend)->ArgsProduct({kClouds, kAddCounts})->ArgNames({"cloud", "points"});
+BENCHMARK_TEMPLATE(BM_Add3D, double, StdHashMapBackend)->ArgsProduct({kClouds, kAddCounts})->ArgNames({"cloud", "points"});
+BENCHMARK_TEMPLATE(BM_Add3D, double, FlatHashMapBackend)->ArgsProduct({kClouds, kAddCounts})->ArgNames({"cloud", "points"});
+BENCHMARK_TEMPLATE(BM_Build3D, float, StdHashMapBackend)->ArgsProduct({kClouds, {1000000}, kBuildThreads})->ArgNames({"cloud", "points", "threads"})->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Build3D, float, FlatHashMapBackend)->ArgsProduct({kClouds, {1000000}, kBuildThreads})->ArgNames({"cloud", "points", "threads"})->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Build3DCompact, float)->ArgsProduct({kClouds, kAddCounts})->ArgNames({"cloud", "points"});
+BENCHMARK_TEMPLATE(BM_Build3DCompact, double)->ArgsProduct({kClouds, kAddCounts})->ArgNames({"cloud", "points"});
+
+BENCHMARK_TEMPLATE(BM_CubeSearch3D, float, StdHashMapBackend)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_CubeSearch3D, float, FlatHashMapBackend)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_CubeSearch3D, double, StdHashMapBackend)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_CubeSearch3D, double, FlatHashMapBackend)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_SphereSearch3D, float, FlatHashMapBackend)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_CubeSearch3DCompact, float)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_CubeSearch3DCompact, double)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_BruteForceCube3D, float)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_BruteForceCube3D, double)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+
+BENCHMARK_TEMPLATE(BM_Add2D, float, StdHashMapBackend)->ArgsProduct({kClouds, kAddCounts})->ArgNames({"cloud", "points"});
+BENCHMARK_TEMPLATE(BM_Add2D, float, FlatHashMapBackend)->ArgsProduct({kClouds, kAddCounts})->ArgNames({"cloud", "points"});
+BENCHMARK_TEMPLATE(BM_Add2D, double, StdHashMapBackend)->ArgsProduct({kClouds, kAddCounts})->ArgNames({"cloud", "points"});
+BENCHMARK_TEMPLATE(BM_Add2D, double, FlatHashMapBackend)->ArgsProduct({kClouds, kAddCounts})->ArgNames({"cloud", "points"});
+BENCHMARK_TEMPLATE(BM_SquareSearch2D, float, StdHashMapBackend)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_SquareSearch2D, float, FlatHashMapBackend)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_SquareSearch2D, double, StdHashMapBackend)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_SquareSearch2D, double, FlatHashMapBackend)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_BruteForceSquare2D, float)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_BruteForceSquare2D, double)->ArgsProduct({kClouds, kHalfSizes})->ArgNames({"cloud", "half"});
+
+BENCHMARK_TEMPLATE(BM_BoxSearch4D, float, StdHashMapBackend)->ArgsProduct({kClouds, {0, 1, 2}})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_BoxSearch4D, float, FlatHashMapBackend)->ArgsProduct({kClouds, {0, 1, 2}})->ArgNames({"cloud", "half"});
+BENCHMARK_TEMPLATE(BM_TopKAdd3D, float, ContainerHeap<float, uint32_t>)->ArgsProduct({kClouds, {1, 4, 16}})->ArgNames({"cloud", "k"});
+BENCHMARK_TEMPLATE(BM_TopKAdd3D, float, ContainerTopK<float, uint32_t>)->ArgsProduct({kClouds, {1, 4, 16}})->ArgNames({"cloud", "k"});
+
+BENCHMARK_TEMPLATE(BM_VoxelDownsample3D, float)->ArgsProduct({kClouds, {0, 1, 2}, {1, 4, 16}})->ArgNames({"cloud", "mode", "threads"})->UseRealTime();
+BENCHMARK_TEMPLATE(BM_VoxelDownsampleTable3D, float)->ArgsProduct({kClouds})->ArgNames({"cloud"});
+BENCHMARK_TEMPLATE(BM_RadiusPairs3D, float)->ArgsProduct({kClouds, {1, 4, 8}, {1, 4}})->ArgNames({"cloud", "radius", "threads"})->UseRealTime();
+BENCHMARK(BM_ParallelFor)->Arg(2)->Arg(4)->Arg(8)->ArgName("threads")->UseRealTime();
+BENCHMARK_TEMPLATE(BM_BatchCubeSearch3D, float)->ArgsProduct({{kUniform}, {64, 1024, 16384}, {1, 4}})->ArgNames({"cloud", "batch", "threads"})->UseRealTime();
+BENCHMARK_TEMPLATE(BM_RadiusSearchPairs3D, float)->ArgsProduct({kClouds, {1, 4, 8}})->ArgNames({"cloud", "radius"});
+BENCHMARK_TEMPLATE(BM_Raycast3D, float)->ArgsProduct({kClouds, {4, 16, 64}})->ArgNames({"cloud", "range"});
+BENCHMARK_TEMPLATE(BM_RayBoxSearch3D, float)->ArgsProduct({kClouds, {4, 16, 64}})->ArgNames({"cloud", "range"});
+BENCHMARK_TEMPLATE(BM_FrustumSearch3D, float)->ArgsProduct({kClouds, {4, 16, 32}})->ArgNames({"cloud", "depth"});
+BENCHMARK_TEMPLATE(BM_FrustumBoxSearch3D, float)->ArgsProduct({kClouds, {4, 16, 32}})->ArgNames({"cloud", "depth"});
+BENCHMARK_TEMPLATE(BM_RollingMap3D, float)->ArgsProduct({kClouds, {10, 50}})->ArgNames({"cloud", "window"});
+BENCHMARK_TEMPLATE(BM_RebuildMap3D, float)->ArgsProduct({kClouds, {10, 50}})->ArgNames({"cloud", "window"});
+BENCHMARK_TEMPLATE(BM_SphereSearch3D, float, FlatHashMapBackend)->ArgsProduct({kClouds, kPyramidRadii})->ArgNames({"cloud", "radius"});
+BENCHMARK_TEMPLATE(BM_PyramidSphereSearch3D, float)->ArgsProduct({kClouds, kPyramidRadii})->ArgNames({"cloud", "radius"});
+BENCHMARK_TEMPLATE(BM_PyramidCountInSphere3D, float)->ArgsProduct({kClouds, kPyramidRadii})->ArgNames({"cloud", "radius"});
+
+BENCHMARK_MAIN();
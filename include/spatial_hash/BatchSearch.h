@@ -0,0 +1,160 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include "spatial_hash/SpatialHash2D.h"
+#include "spatial_hash/SpatialHash3D.h"
+#include "spatial_hash/Parallel.h"
+#include "spatial_hash/RadixSort.h"
+#include "spatial_hash/Morton.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+namespace libs::spatial_hash {
+
+/// @brief Batch search result in compressed sparse row layout.
+/// References of query i are refs_[offsets_[i]] .. refs_[offsets_[i + 1] - 1].
+/// @tparam RefType - associated data type
+template<typename RefType>
+struct BatchSearchResult {
+    std::vector<size_t> offsets_;
+    std::vector<RefType> refs_;
+
+    /// @brief Returns number of queries
+    size_t Size() const {
+        return offsets_.empty() ? 0 : offsets_.size() - 1;
+    }
+
+    /// @brief Returns number of references found for the query
+    size_t Count(size_t query_idx) const {
+        return offsets_[query_idx + 1] - offsets_[query_idx];
+    }
+
+    /// @brief Returns pointer to the first reference of the query
+    const RefType* Begin(size_t query_idx) const {
+        return refs_.data() + offsets_[query_idx];
+    }
+
+    /// @brief Returns pointer past the last reference of the query
+    const RefType* End(size_t query_idx) const {
+        return refs_.data() + offsets_[query_idx + 1];
+    }
+};
+
+namespace detail {
+
+/// @brief Runs queries in key order across threads and gathers results in query order.
+/// @param count - number of queries
+/// @param key_fn - callable with (size_t query_idx) argument, returns uint64_t cell key of the query
+/// @param search_fn - callable with (size_t query_idx, std::vector<RefType>& buffer) arguments, appends query result
+template<typename RefType, typename KeyFn, typename SearchFn>
+void BatchSearch(size_t count, KeyFn&& key_fn, SearchFn&& search_fn, size_t num_threads, BatchSearchResult<RefType>& result) {
+    // neighbouring queries share cells, processing them in key order keeps cells in cache
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> order;
+    SortByKey(count, key_fn, num_threads, keys, order);
+
+    num_threads = GetThreadCount(num_threads, count, 64);
+    std::vector<std::vector<RefType>> local_refs(num_threads);
+    std::vector<size_t> counts(count);
+    ParallelFor(count, num_threads, [&](size_t thread_idx, size_t begin, size_t end) {
+        std::vector<RefType>& buffer = local_refs[thread_idx];
+        for(size_t i = begin; i < end; ++i) {
+            const size_t query_idx = order[i];
+            const size_t before = buffer.size();
+            search_fn(query_idx, buffer);
+            counts[query_idx] = buffer.size() - before;
+        }
+    });
+
+    result.offsets_.resize(count + 1);
+    result.offsets_[0] = 0;
+    for(size_t i = 0; i < count; ++i) {
+        result.offsets_[i + 1] = result.offsets_[i] + counts[i];
+    }
+
+    result.refs_.resize(result.offsets_[count]);
+    ParallelFor(count, num_threads, [&](size_t thread_idx, size_t begin, size_t end) {
+        const RefType* src = local_refs[thread_idx].data();
+        for(size_t i = begin; i < end; ++i) {
+            const size_t query_idx = order[i];
+            std::copy(src, src + counts[query_idx], result.refs_.begin() + result.offsets_[query_idx]);
+            src += counts[query_idx];
+        }
+    });
+}
+
+}
+
+/// @brief Cube search for a batch of centers with the same half size.
+/// Queries are sorted by voxel Morton code and processed in parallel. Table must provide
+/// GetVoxelIndex(point) and CubeSearch(center, half_size, buffer), the const methods have to be thread safe.
+/// @param table - 3D spatial hash table
+/// @param centers - array of "count" 3D points (x, y, z)
+/// @param count - number of queries
+/// @param half_size - half cube size in R3
+/// @param num_threads - number of threads, 0 - hardware concurrency
+/// @param result - output, results in query order
+template<typename TableType, typename DataType, typename RefType>
+void BatchCubeSearch(const TableType& table, const DataType* centers, size_t count, DataType half_size,
+    size_t num_threads, BatchSearchResult<RefType>& result) {
+    detail::BatchSearch(count,
+        [&](size_t i) { return MortonEncode3D(table.GetVoxelIndex(centers + 3 * i)); },
+        [&](size_t i, std::vector<RefType>& buffer) { table.CubeSearch(centers + 3 * i, half_size, buffer); },
+        num_threads, result);
+}
+
+/// @brief Cube search for a batch of centers with individual half sizes.
+/// @param table - 3D spatial hash table
+/// @param centers - array of "count" 3D points (x, y, z)
+/// @param half_sizes - array of "count" half cube sizes in R3
+/// @param count - number of queries
+/// @param num_threads - number of threads, 0 - hardware concurrency
+/// @param result - output, results in query order
+template<typename TableType, typename DataType, typename RefType>
+void BatchCubeSearch(const TableType& table, const DataType* centers, const DataType* half_sizes, size_t count,
+    size_t num_threads, BatchSearchResult<RefType>& result) {
+    detail::BatchSearch(count,
+        [&](size_t i) { return MortonEncode3D(table.GetVoxelIndex(centers + 3 * i)); },
+        [&](size_t i, std::vector<RefType>& buffer) { table.CubeSearch(centers + 3 * i, half_sizes[i], buffer); },
+        num_threads, result);
+}
+
+/// @brief Square search for a batch of centers with the same half size.
+/// Queries are sorted by cell key and processed in parallel. Table must provide
+/// GetCellIndex(point) and SquareSearch(center, half_size, buffer), the const methods have to be thread safe.
+/// @param table - 2D spatial hash table
+/// @param centers - array of "count" 2D points (x, y)
+/// @param count - number of queries
+/// @param half_size - half square size in R2
+/// @param num_threads - number of threads, 0 - hardware concurrency
+/// @param result - output, results in query order
+template<typename TableType, typename DataType, typename RefType>
+void BatchSquareSearch(const TableType& table, const DataType* centers, size_t count, DataType half_size,
+    size_t num_threads, BatchSearchResult<RefType>& result) {
+    detail::BatchSearch(count,
+        [&](size_t i) { return SpatalHash2D()(table.GetCellIndex(centers + 2 * i)); },
+        [&](size_t i, std::vector<RefType>& buffer) { table.SquareSearch(centers + 2 * i, half_size, buffer); },
+        num_threads, result);
+}
+
+/// @brief Square search for a batch of centers with individual half sizes.
+/// @param table - 2D spatial hash table
+/// @param centers - array of "count" 2D points (x, y)
+/// @param half_sizes - array of "count" half square sizes in R2
+/// @param count - number of queries
+/// @param num_threads - number of threads, 0 - hardware concurrency
+/// @param result - output, results in query order
+template<typename TableType, typename DataType, typename RefType>
+void BatchSquareSearch(const TableType& table, const DataType* centers, const DataType* half_sizes, size_t count,
+    size_t num_threads, BatchSearchResult<RefType>& result) {
+    detail::BatchSearch(count,
+        [&](size_t i) { return SpatalHash2D()(table.GetCellIndex(centers + 2 * i)); },
+        [&](size_t i, std::vector<RefType>& buffer) { table.SquareSearch(centers + 2 * i, half_sizes[i], buffer); },
+        num_threads, result);
+}
+
+}
@@ -0,0 +1,280 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include "spatial_hash/SpatialHash3D.h"
+#include "spatial_hash/Containers.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+
+namespace libs::spatial_hash {
+
+/// @brief Thread safe 3D spatial hash table with vector container.
+/// Voxels are distributed over lock striped shards by voxel key. Add locks one shard exclusively,
+/// searches lock shards shared one voxel probe at a time, so readers never wait for writers of other shards.
+/// @tparam DataType - 3D spase data type (float, double)
+/// @tparam RefType - associated data type
+/// @tparam MapBackend - hash table backend (StdHashMapBackend, FlatHashMapBackend)
+template<typename DataType, typename RefType, typename MapBackend = StdHashMapBackend>
+class ConcurrentSpatialHashTable3D {
+public:
+    using CellType = ContainerVector<RefType>;
+    using HashTableType = typename MapBackend::template Map<HashIndex3D, CellType, SpatalHash3D>;
+public:
+    /// @brief Constructor with voxel size.
+    /// @param voxel_size - voxel size
+    /// @param shard_count - number of shards, rounded up to power of two
+    explicit ConcurrentSpatialHashTable3D(DataType voxel_size, size_t shard_count = 64)
+        : voxel_size_(voxel_size), inv_voxel_size_(1 / voxel_size) {
+        shard_count_ = 1;
+        while (shard_count_ < shard_count) {
+            shard_count_ *= 2;
+        }
+        shards_.reset(new Shard[shard_count_]);
+    }
+
+    /// @brief Returns voxel size.
+    /// @return voxel size
+    DataType GetVoxelSize() const {
+        return voxel_size_;
+    }
+
+    /// @brief Returns inverse voxel size.
+    /// @return - inverse voxel size
+    DataType GetInvVoxelSize() const {
+        return inv_voxel_size_;
+    }
+
+    /// @brief Returns number of shards
+    size_t GetShardCount() const {
+        return shard_count_;
+    }
+
+    /// @brief Clear the hash table. Shards are cleared one by one.
+    void Clear() {
+        for(size_t i = 0; i < shard_count_; ++i) {
+            std::unique_lock<std::shared_mutex> lock(shards_[i].mutex_);
+            cell_count_.fetch_sub(shards_[i].table_.size(), std::memory_order_relaxed);
+            shards_[i].table_.clear();
+        }
+    }
+
+    /// @brief Returns number of populated voxels
+    size_t GetCellCount() const {
+        return cell_count_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Convert continuous 3D space point in discrete hash space index
+    /// @param point - continuous 3D space point
+    /// @return hash table index
+    HashIndex3D GetVoxelIndex(const DataType point[3]) const {
+        HashIndex3D result;
+        result.x_ = static_cast<int32_t>(std::floor(point[0] * inv_voxel_size_));
+        result.y_ = static_cast<int32_t>(std::floor(point[1] * inv_voxel_size_));
+        result.z_ = static_cast<int32_t>(std::floor(point[2] * inv_voxel_size_));
+        return result;
+    }
+
+    /// @brief Add value to hash table. Thread safe.
+    /// @param point - continuous 3D space point
+    /// @param ref - associated data
+    void Add(const DataType point[3], RefType ref) {
+        HashIndex3D voxel_index = GetVoxelIndex(point);
+        Shard& shard = GetShard(voxel_index);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+        const size_t size = shard.table_.size();
+        shard.table_[voxel_index].Add(ref);
+        if (shard.table_.size() != size) {
+            cell_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /// @brief Returns copy of data for specific voxel index. Thread safe.
+    /// @param index - voxel index
+    /// @return voxel references
+    std::vector<RefType> GetVoxelData(HashIndex3D index) const {
+        std::vector<RefType> result;
+        const Shard& shard = GetShard(index);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+        auto itr = shard.table_.find(index);
+        if (shard.table_.end() != itr) {
+            result.insert(result.end(), itr->second.begin(), itr->second.end());
+        }
+        return result;
+    }
+
+    /// @brief Visit all data references in specified cube. Cube parameters in discrete hash table space.
+    /// Visitor is called under shared lock of the voxel shard and must not modify the table.
+    /// @param center - central voxel
+    /// @param half_size - half cube size
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInCube(HashIndex3D center, int32_t half_size, Visitor&& visitor) const {
+        HashIndex3D corner_min(center.x_ - half_size, center.y_ - half_size, center.z_ - half_size);
+        HashIndex3D corner_max(center.x_ + half_size, center.y_ + half_size, center.z_ + half_size);
+        ForEachVoxel(corner_min, corner_max, [&visitor](const CellType& cell) {
+            for(const RefType& ref : cell) {
+                visitor(ref);
+            }
+        });
+    }
+
+    /// @brief Visit all data references in specified cube. Cube parameters in R3 space.
+    /// Visitor is called under shared lock of the voxel shard and must not modify the table.
+    /// @param center - central point
+    /// @param half_size - half cube size in R3
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInCube(const DataType center[3], DataType half_size, Visitor&& visitor) const {
+        HashIndex3D center_index = GetVoxelIndex(center);
+        uint32_t half_size_i = half_size * GetInvVoxelSize();
+        ForEachInCube(center_index, half_size_i, std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Append all data references in specified cube to caller owned buffer. Cube parameters in discrete hash table space.
+    /// @param center - central voxel
+    /// @param half_size - half cube size
+    /// @param result - output buffer, references are appended
+    void CubeSearch(HashIndex3D center, int32_t half_size, std::vector<RefType>& result) const {
+        HashIndex3D corner_min(center.x_ - half_size, center.y_ - half_size, center.z_ - half_size);
+        HashIndex3D corner_max(center.x_ + half_size, center.y_ + half_size, center.z_ + half_size);
+        ForEachVoxel(corner_min, corner_max, [&result](const CellType& cell) {
+            result.insert(result.end(), cell.begin(), cell.end());
+        });
+    }
+
+    /// @brief Append all data references in specified cube to caller owned buffer. Cube parameters in discrete hash table space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point
+    /// @param result - output buffer, references are appended
+    void CubeSearch(HashIndex3D corner_min, HashIndex3D corner_max, std::vector<RefType>& result) const {
+        if (corner_max.x_ < corner_min.x_) {
+            std::swap(corner_min.x_, corner_max.x_);
+        }
+        if (corner_max.y_ < corner_min.y_) {
+            std::swap(corner_min.y_, corner_max.y_);
+        }
+        if (corner_max.z_ < corner_min.z_) {
+            std::swap(corner_min.z_, corner_max.z_);
+        }
+        ForEachVoxel(corner_min, corner_max, [&result](const CellType& cell) {
+            result.insert(result.end(), cell.begin(), cell.end());
+        });
+    }
+
+    /// @brief Append all data references in specified cube to caller owned buffer. Cube parameters in R3 space.
+    /// @param center - central point
+    /// @param half_size - half cube size in R3
+    /// @param result - output buffer, references are appended
+    void CubeSearch(const DataType center[3], DataType half_size, std::vector<RefType>& result) const {
+        HashIndex3D center_index = GetVoxelIndex(center);
+        uint32_t half_size_i = half_size * GetInvVoxelSize();
+        CubeSearch(center_index, half_size_i, result);
+    }
+
+    /// @brief Append all data references in specified cube to caller owned buffer. Cube parameters in R3 space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point
+    /// @param result - output buffer, references are appended
+    void CubeSearch(const DataType corner_min[3], const DataType corner_max[3], std::vector<RefType>& result) const {
+        CubeSearch(GetVoxelIndex(corner_min), GetVoxelIndex(corner_max), result);
+    }
+
+    /// @brief Search all data references in specified cube. Cube parameters in R3 space.
+    /// @param center - central point
+    /// @param half_size - half cube size in R3
+    /// @return all data references in cube
+    std::vector<RefType> CubeSearch(const DataType center[3], DataType half_size) const {
+        std::vector<RefType> result;
+        CubeSearch(center, half_size, result);
+        return result;
+    }
+
+    /// @brief Search all data references in specified cube. Cube parameters in R3 space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point
+    /// @return all data references in cube
+    std::vector<RefType> CubeSearch(const DataType corner_min[3], const DataType corner_max[3]) const {
+        std::vector<RefType> result;
+        CubeSearch(corner_min, corner_max, result);
+        return result;
+    }
+
+private:
+    struct Shard {
+        mutable std::shared_mutex mutex_;
+        HashTableType table_;
+    };
+
+    Shard& GetShard(const HashIndex3D& index) {
+        return shards_[ShardIndex(index)];
+    }
+
+    const Shard& GetShard(const HashIndex3D& index) const {
+        return shards_[ShardIndex(index)];
+    }
+
+    /// @brief Shard is selected by low bits of mixed key,
+    /// flat map backend uses high bits of different mix, so keys of one shard stay spread in the shard table.
+    size_t ShardIndex(const HashIndex3D& index) const {
+        uint64_t key = SpatalHash3D()(index);
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33;
+        return static_cast<size_t>(key & (shard_count_ - 1));
+    }
+
+    /// @brief Visit all populated voxels in the box between ordered corners, every probe takes shared lock of its shard.
+    /// Boxes with more voxels than the table are served by scanning shards one by one under shared lock.
+    template<typename Visitor>
+    void ForEachVoxel(HashIndex3D corner_min, HashIndex3D corner_max, Visitor&& visitor) const {
+        if (corner_max.x_ < corner_min.x_ || corner_max.y_ < corner_min.y_ || corner_max.z_ < corner_min.z_) {
+            return;
+        }
+
+        const double box_volume = (double(corner_max.x_) - corner_min.x_ + 1) * 
+            (double(corner_max.y_) - corner_min.y_ + 1) * (double(corner_max.z_) - corner_min.z_ + 1);
+        if (box_volume > GetCellCount()) {
+            for(size_t i = 0; i < shard_count_; ++i) {
+                std::shared_lock<std::shared_mutex> lock(shards_[i].mutex_);
+                for(const auto& voxel : shards_[i].table_) {
+                    const HashIndex3D& index = voxel.first;
+                    if (corner_min.x_ <= index.x_ && index.x_ <= corner_max.x_ &&
+                        corner_min.y_ <= index.y_ && index.y_ <= corner_max.y_ &&
+                        corner_min.z_ <= index.z_ && index.z_ <= corner_max.z_) {
+                        visitor(voxel.second);
+                    }
+                }
+            }
+            return;
+        }
+
+        HashIndex3D grid_point;
+        for(grid_point.x_ = corner_min.x_; grid_point.x_ <= corner_max.x_; ++grid_point.x_) {
+            for(grid_point.y_ = corner_min.y_; grid_point.y_ <= corner_max.y_; ++grid_point.y_) {
+                for(grid_point.z_ = corner_min.z_; grid_point.z_ <= corner_max.z_; ++grid_point.z_) {
+                    const Shard& shard = GetShard(grid_point);
+                    std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+                    auto itr = shard.table_.find(grid_point);
+                    if(shard.table_.end() == itr) {
+                        continue;
+                    }
+                    visitor(itr->second);
+                }
+            }
+        }
+    }
+
+    DataType voxel_size_;
+    DataType inv_voxel_size_;
+    size_t shard_count_;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<size_t> cell_count_ {0};
+};
+
+}
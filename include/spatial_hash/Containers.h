@@ -7,6 +7,11 @@
 #include <vector>
 #include <map>
 #include <queue>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
 
 namespace libs::spatial_hash {
 
@@ -18,6 +23,23 @@ public:
     void Add(const RefType& v) {
         std::vector<RefType>::push_back(v);
     }
+
+    /// @brief Remove first occurrence of the value, the last element takes its place.
+    /// @return true if value was found
+    bool Remove(const RefType& v) {
+        auto itr = std::find(std::vector<RefType>::begin(), std::vector<RefType>::end(), v);
+        if (std::vector<RefType>::end() == itr) {
+            return false;
+        }
+        *itr = std::vector<RefType>::back();
+        std::vector<RefType>::pop_back();
+        return true;
+    }
+
+    /// @brief Returns heap memory owned by the container in bytes
+    size_t MemoryUsage() const {
+        return std::vector<RefType>::capacity() * sizeof(RefType);
+    }
 };
 
 /// @brief Priority queue based contaner with size limit.
@@ -36,6 +58,422 @@ public:
             BaseClass::erase(BaseClass::begin());
         }
     }
+
+    /// @brief Remove first occurrence of the value.
+    /// @return true if value was found
+    bool Remove(const RefType& v) {
+        for(auto itr = BaseClass::begin(); itr != BaseClass::end(); ++itr) {
+            if (itr->second == v) {
+                BaseClass::erase(itr);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @brief Returns approximate heap memory owned by the container in bytes, tree node is value and three pointers
+    size_t MemoryUsage() const {
+        return BaseClass::size() * (sizeof(typename BaseClass::value_type) + 4 * sizeof(void*));
+    }
+};
+
+/// @brief Bounded top K container with ContainerHeap semantics: keeps "limit" values with the largest keys,
+/// values with a key already present are dropped, iteration is in ascending key order.
+/// Values are stored in one sorted array, the storage is allocated once per cell and reused by following inserts.
+/// @tparam KeyT - key type, ordered by operator <
+/// @tparam RefType - associated data type
+template<typename KeyT, typename RefType>
+class ContainerTopK {
+public:
+    using value_type = std::pair<KeyT, RefType>;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    /// @brief Insert value if it is in top "limit" keys
+    /// @param key - value key
+    /// @param v - value
+    /// @param limit - max number of values
+    void Add(KeyT key, const RefType& v, size_t limit) {
+        if (values_.size() > limit) {
+            values_.erase(values_.begin(), values_.end() - limit);
+        }
+        if (0 == limit) {
+            return;
+        }
+        if (values_.capacity() == 0) {
+            values_.reserve(std::min(limit, kMaxReserve));
+        }
+
+        auto pos = std::lower_bound(values_.begin(), values_.end(), key,
+            [](const value_type& value, const KeyT& k) { return value.first < k; });
+        if (values_.end() != pos && !(key < pos->first)) {
+            return;
+        }
+
+        if (values_.size() < limit) {
+            values_.emplace(pos, key, v);
+            return;
+        }
+
+        if (values_.begin() == pos) {
+            return;
+        }
+        // the smallest key is dropped, values before the insert position move one slot down
+        std::move(values_.begin() + 1, pos, values_.begin());
+        *(pos - 1) = value_type(key, v);
+    }
+
+    /// @brief Remove first occurrence of the value.
+    /// @return true if value was found
+    bool Remove(const RefType& v) {
+        for(auto itr = values_.begin(); itr != values_.end(); ++itr) {
+            if (itr->second == v) {
+                values_.erase(itr);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t size() const {
+        return values_.size();
+    }
+
+    bool empty() const {
+        return values_.empty();
+    }
+
+    const_iterator begin() const {
+        return values_.begin();
+    }
+
+    const_iterator end() const {
+        return values_.end();
+    }
+
+    /// @brief Returns heap memory owned by the container in bytes
+    size_t MemoryUsage() const {
+        return values_.capacity() * sizeof(value_type);
+    }
+
+private:
+    /// @brief Larger limits grow the storage on demand
+    static constexpr size_t kMaxReserve = 64;
+
+    std::vector<value_type> values_;
+};
+
+/// @brief Vector container with insertion epoch of every value. Values are kept in non-decreasing epoch order,
+/// so eviction of old epochs erases a prefix. Iteration is over values.
+/// @tparam RefType - associated data type
+template<typename RefType>
+class ContainerEpochVector {
+public:
+    /// @param v - value
+    /// @param epoch - insertion epoch, not less than epochs of the stored values
+    void Add(const RefType& v, uint32_t epoch) {
+        refs_.push_back(v);
+        epochs_.push_back(epoch);
+    }
+
+    /// @brief Remove first occurrence of the value, order of the others is kept.
+    /// @return true if value was found
+    bool Remove(const RefType& v) {
+        auto itr = std::find(refs_.begin(), refs_.end(), v);
+        if (refs_.end() == itr) {
+            return false;
+        }
+        epochs_.erase(epochs_.begin() + (itr - refs_.begin()));
+        refs_.erase(itr);
+        return true;
+    }
+
+    /// @brief Remove values added before the epoch
+    /// @return number of removed values
+    size_t EvictOlderThan(uint32_t epoch) {
+        const size_t count = std::lower_bound(epochs_.begin(), epochs_.end(), epoch) - epochs_.begin();
+        refs_.erase(refs_.begin(), refs_.begin() + count);
+        epochs_.erase(epochs_.begin(), epochs_.begin() + count);
+        return count;
+    }
+
+    /// @brief Returns epoch of the last added value, the container has to be non-empty
+    uint32_t NewestEpoch() const {
+        return epochs_.back();
+    }
+
+    const std::vector<uint32_t>& Epochs() const {
+        return epochs_;
+    }
+
+    size_t size() const {
+        return refs_.size();
+    }
+
+    bool empty() const {
+        return refs_.empty();
+    }
+
+    typename std::vector<RefType>::const_iterator begin() const {
+        return refs_.begin();
+    }
+
+    typename std::vector<RefType>::const_iterator end() const {
+        return refs_.end();
+    }
+
+    /// @brief Returns heap memory owned by the container in bytes
+    size_t MemoryUsage() const {
+        return refs_.capacity() * sizeof(RefType) + epochs_.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    std::vector<RefType> refs_;
+    std::vector<uint32_t> epochs_;
+};
+
+/// @brief Block arena for spilled cell storage, owned by the table.
+/// Storage is allocated in power of two capacities from large blocks, freed storage is reused by capacity class.
+/// Reset() makes all storage available again without freeing the blocks.
+/// @tparam RefType - associated data type
+template<typename RefType>
+class RefArena {
+public:
+    /// @param block_size - number of references in one block
+    explicit RefArena(size_t block_size = 1 << 16) : block_size_(block_size) {}
+
+    RefArena(const RefArena&) = delete;
+    RefArena& operator = (const RefArena&) = delete;
+    RefArena(RefArena&&) = default;
+    RefArena& operator = (RefArena&&) = default;
+
+    /// @brief Allocate storage for "capacity" references
+    /// @param capacity - power of two capacity
+    RefType* Allocate(uint32_t capacity) {
+        const size_t size_class = SizeClass(capacity);
+        if (size_class < free_lists_.size() && !free_lists_[size_class].empty()) {
+            RefType* result = free_lists_[size_class].back();
+            free_lists_[size_class].pop_back();
+            return result;
+        }
+
+        while (block_idx_ < blocks_.size() && block_used_ + capacity > blocks_[block_idx_].size_) {
+            ++block_idx_;
+            block_used_ = 0;
+        }
+        if (block_idx_ == blocks_.size()) {
+            const size_t size = std::max<size_t>(block_size_, capacity);
+            blocks_.push_back(Block{std::unique_ptr<RefType[]>(new RefType[size]), size});
+            block_used_ = 0;
+        }
+
+        RefType* result = blocks_[block_idx_].data_.get() + block_used_;
+        block_used_ += capacity;
+        return result;
+    }
+
+    /// @brief Return storage to the arena for reuse
+    /// @param data - storage returned by Allocate
+    /// @param capacity - capacity passed to Allocate
+    void Free(RefType* data, uint32_t capacity) {
+        const size_t size_class = SizeClass(capacity);
+        if (size_class >= free_lists_.size()) {
+            free_lists_.resize(size_class + 1);
+        }
+        free_lists_[size_class].push_back(data);
+    }
+
+    /// @brief Make all storage available again, blocks are kept, O(number of blocks)
+    void Reset() {
+        block_idx_ = 0;
+        block_used_ = 0;
+        for(auto& free_list : free_lists_) {
+            free_list.clear();
+        }
+    }
+
+    /// @brief Returns memory of all blocks in bytes
+    size_t MemoryUsage() const {
+        size_t result = 0;
+        for(const Block& block : blocks_) {
+            result += block.size_ * sizeof(RefType);
+        }
+        return result;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<RefType[]> data_;
+        size_t size_;
+    };
+
+    static size_t SizeClass(uint32_t capacity) {
+        size_t result = 0;
+        while ((uint32_t(1) << result) < capacity) {
+            ++result;
+        }
+        return result;
+    }
+
+    size_t block_size_;
+    std::vector<Block> blocks_;
+    size_t block_idx_ = 0;
+    size_t block_used_ = 0;
+    std::vector<std::vector<RefType*>> free_lists_;
+};
+
+/// @brief Small buffer container, up to N references are stored inline without allocation,
+/// larger cells spill to storage allocated from the table RefArena.
+/// Copy is shallow, spilled storage belongs to the arena.
+/// @tparam RefType - trivially copyable associated data type
+/// @tparam N - number of inline references
+template<typename RefType, uint32_t N = 4>
+class ContainerSmallVector {
+    static_assert(std::is_trivially_copyable<RefType>::value, "RefType has to be trivially copyable");
+    static_assert(N > 0, "N has to be positive");
+public:
+    ContainerSmallVector() : size_(0), capacity_(N) {}
+
+    void Add(const RefType& v, RefArena<RefType>& arena) {
+        if (size_ == capacity_) {
+            Grow(arena);
+        }
+        data()[size_++] = v;
+    }
+
+    /// @brief Remove first occurrence of the value, the last element takes its place.
+    /// @return true if value was found
+    bool Remove(const RefType& v) {
+        RefType* values = data();
+        RefType* itr = std::find(values, values + size_, v);
+        if (itr == values + size_) {
+            return false;
+        }
+        *itr = values[--size_];
+        return true;
+    }
+
+    /// @brief Return spilled storage to the arena, container becomes empty
+    void Release(RefArena<RefType>& arena) {
+        if (capacity_ > N) {
+            arena.Free(heap_, capacity_);
+        }
+        size_ = 0;
+        capacity_ = N;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return 0 == size_;
+    }
+
+    const RefType* data() const {
+        return capacity_ > N ? heap_ : inline_;
+    }
+
+    const RefType* begin() const {
+        return data();
+    }
+
+    const RefType* end() const {
+        return data() + size_;
+    }
+
+    /// @brief Returns spilled storage size in bytes, the storage is owned by the arena
+    size_t MemoryUsage() const {
+        return capacity_ > N ? capacity_ * sizeof(RefType) : 0;
+    }
+
+private:
+    RefType* data() {
+        return capacity_ > N ? heap_ : inline_;
+    }
+
+    void Grow(RefArena<RefType>& arena) {
+        uint32_t capacity = 2;
+        while (capacity < 2 * capacity_) {
+            capacity *= 2;
+        }
+        RefType* values = arena.Allocate(capacity);
+        std::memcpy(values, data(), size_ * sizeof(RefType));
+        if (capacity_ > N) {
+            arena.Free(heap_, capacity_);
+        }
+        heap_ = values;
+        capacity_ = capacity;
+    }
+
+    union {
+        RefType inline_[N];
+        RefType* heap_;
+    };
+    uint32_t size_;
+    uint32_t capacity_;
+};
+
+/// @brief Structure of arrays container, stores 3D point coordinates next to references.
+/// @tparam DataType - 3D spase data type (float, double)
+/// @tparam RefType - associated data type 
+template<typename DataType, typename RefType>
+class ContainerPoints3D {
+public:
+    void Add(const DataType point[3], const RefType& v) {
+        x_.push_back(point[0]);
+        y_.push_back(point[1]);
+        z_.push_back(point[2]);
+        refs_.push_back(v);
+    }
+
+    /// @brief Returns position of the first occurrence of the value or size() if not found
+    size_t Find(const RefType& v) const {
+        return std::find(refs_.begin(), refs_.end(), v) - refs_.begin();
+    }
+
+    /// @brief Remove first occurrence of the value, the last point takes its place.
+    /// @return true if value was found
+    bool Remove(const RefType& v) {
+        size_t i = Find(v);
+        if (i == refs_.size()) {
+            return false;
+        }
+        x_[i] = x_.back();
+        y_[i] = y_.back();
+        z_[i] = z_.back();
+        refs_[i] = refs_.back();
+        x_.pop_back();
+        y_.pop_back();
+        z_.pop_back();
+        refs_.pop_back();
+        return true;
+    }
+
+    size_t size() const {
+        return refs_.size();
+    }
+
+    bool empty() const {
+        return refs_.empty();
+    }
+
+    typename std::vector<RefType>::const_iterator begin() const {
+        return refs_.begin();
+    }
+
+    typename std::vector<RefType>::const_iterator end() const {
+        return refs_.end();
+    }
+
+    /// @brief Returns heap memory owned by the container in bytes
+    size_t MemoryUsage() const {
+        return (x_.capacity() + y_.capacity() + z_.capacity()) * sizeof(DataType) + refs_.capacity() * sizeof(RefType);
+    }
+
+    std::vector<DataType> x_;
+    std::vector<DataType> y_;
+    std::vector<DataType> z_;
+    std::vector<RefType> refs_;
 };
 
-}
\ No newline at end of file
+}
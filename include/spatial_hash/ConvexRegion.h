@@ -0,0 +1,162 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstddef>
+
+namespace libs::spatial_hash {
+
+/// @brief Half-space of N dimensional space, points with dot(normal, point) <= offset are inside
+template<typename DataType, size_t N>
+struct HalfSpace {
+    DataType normal_[N];
+    DataType offset_;
+};
+
+/// @brief Convex region as intersection of half-spaces, e.g. camera frustum, oriented box or convex polytope.
+/// The bounding box limits the region and defines cells to enumerate, it has to contain the region.
+/// @tparam DataType - space data type (float, double)
+/// @tparam N - number of dimensions
+template<typename DataType, size_t N>
+class ConvexRegion {
+public:
+    using HalfSpaceType = HalfSpace<DataType, N>;
+
+    /// @brief Empty region
+    ConvexRegion() {
+        std::fill(min_, min_ + N, std::numeric_limits<DataType>::max());
+        std::fill(max_, max_ + N, std::numeric_limits<DataType>::lowest());
+    }
+
+    /// @brief Bounding box region
+    /// @param corner_min - min corner of the bounding box
+    /// @param corner_max - max corner of the bounding box
+    ConvexRegion(const DataType corner_min[N], const DataType corner_max[N]) {
+        std::copy(corner_min, corner_min + N, min_);
+        std::copy(corner_max, corner_max + N, max_);
+    }
+
+    /// @brief Add half-space dot(normal, point) <= offset to the region
+    /// @param normal - outward normal, doesn't have to be normalized
+    /// @param offset - plane offset
+    void AddHalfSpace(const DataType normal[N], DataType offset) {
+        HalfSpaceType half_space;
+        std::copy(normal, normal + N, half_space.normal_);
+        half_space.offset_ = offset;
+        half_spaces_.push_back(half_space);
+    }
+
+    /// @brief Returns true if the point is inside the bounding box and all half-spaces
+    bool IsInside(const DataType point[N]) const {
+        for(size_t i = 0; i < N; ++i) {
+            if (point[i] < min_[i] || max_[i] < point[i]) {
+                return false;
+            }
+        }
+        for(const HalfSpaceType& half_space : half_spaces_) {
+            DataType distance = 0;
+            for(size_t i = 0; i < N; ++i) {
+                distance += half_space.normal_[i] * point[i];
+            }
+            if (distance > half_space.offset_) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const std::vector<HalfSpaceType>& GetHalfSpaces() const {
+        return half_spaces_;
+    }
+
+    /// @brief Returns min corner of the bounding box
+    const DataType* GetMin() const {
+        return min_;
+    }
+
+    /// @brief Returns max corner of the bounding box
+    const DataType* GetMax() const {
+        return max_;
+    }
+
+    /// @brief Oriented box region
+    /// @param center - box center
+    /// @param axes - N orthonormal box axes, row major N x N array
+    /// @param half_sizes - half box sizes along the axes
+    static ConvexRegion OrientedBox(const DataType center[N], const DataType axes[N * N], const DataType half_sizes[N]) {
+        ConvexRegion result;
+        std::copy(center, center + N, result.min_);
+        std::copy(center, center + N, result.max_);
+        for(size_t axis = 0; axis < N; ++axis) {
+            const DataType* normal = axes + N * axis;
+            DataType center_offset = 0;
+            DataType negative[N];
+            for(size_t i = 0; i < N; ++i) {
+                center_offset += normal[i] * center[i];
+                negative[i] = -normal[i];
+                result.min_[i] -= std::abs(normal[i]) * half_sizes[axis];
+                result.max_[i] += std::abs(normal[i]) * half_sizes[axis];
+            }
+            result.AddHalfSpace(normal, center_offset + half_sizes[axis]);
+            result.AddHalfSpace(negative, half_sizes[axis] - center_offset);
+        }
+        return result;
+    }
+
+    /// @brief 3D frustum region defined by near and far rectangle corners, e.g. camera view volume.
+    /// Both rectangles have to list corners in the same rotation order, so near[i] and far[i] are on one edge.
+    /// @param near - 4 near plane corners, 4 x 3 array
+    /// @param far - 4 far plane corners, 4 x 3 array
+    static ConvexRegion Frustum(const DataType near[12], const DataType far[12]) {
+        static_assert(3 == N, "Frustum is defined for 3D space");
+        ConvexRegion result;
+        DataType centroid[3] = {0, 0, 0};
+        for(const DataType* corner : {near, near + 3, near + 6, near + 9, far, far + 3, far + 6, far + 9}) {
+            for(size_t i = 0; i < 3; ++i) {
+                result.min_[i] = std::min(result.min_[i], corner[i]);
+                result.max_[i] = std::max(result.max_[i], corner[i]);
+                centroid[i] += corner[i] / 8;
+            }
+        }
+
+        result.AddPlane(near, near + 3, near + 6, centroid);
+        result.AddPlane(far, far + 3, far + 6, centroid);
+        for(size_t i = 0; i < 4; ++i) {
+            const size_t next = (i + 1) % 4;
+            result.AddPlane(near + 3 * i, near + 3 * next, far + 3 * i, centroid);
+        }
+        return result;
+    }
+
+private:
+    /// @brief Add half-space bounded by the plane through three points, the inner point is inside
+    void AddPlane(const DataType a[3], const DataType b[3], const DataType c[3], const DataType inner[3]) {
+        const DataType u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const DataType v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        DataType normal[3] = {u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0]};
+        if (0 == normal[0] && 0 == normal[1] && 0 == normal[2]) {
+            return;
+        }
+
+        DataType offset = normal[0] * a[0] + normal[1] * a[1] + normal[2] * a[2];
+        if (normal[0] * inner[0] + normal[1] * inner[1] + normal[2] * inner[2] > offset) {
+            for(DataType& value : normal) {
+                value = -value;
+            }
+            offset = -offset;
+        }
+        AddHalfSpace(normal, offset);
+    }
+
+    std::vector<HalfSpaceType> half_spaces_;
+    DataType min_[N];
+    DataType max_[N];
+};
+
+}
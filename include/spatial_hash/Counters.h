@@ -0,0 +1,134 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace libs::spatial_hash {
+
+/// @brief Values of hot path counters at some moment.
+struct CountersSnapshot {
+    /// @brief Number of added references
+    uint64_t adds_ = 0;
+    /// @brief Number of created cells
+    uint64_t cells_created_ = 0;
+    /// @brief Number of hash table rehashes
+    uint64_t rehashes_ = 0;
+    /// @brief Approximate number of bytes allocated by inserts, hash table and cell containers
+    uint64_t allocated_bytes_ = 0;
+    /// @brief Number of range queries (cube / square, shell searches)
+    uint64_t queries_ = 0;
+    /// @brief Number of cells checked, hash lookups and cells iterated by table scans
+    uint64_t probes_ = 0;
+    /// @brief Number of checked cells that were populated and inside the query
+    uint64_t hits_ = 0;
+    /// @brief Number of checked cells that were empty or outside the query
+    uint64_t misses_ = 0;
+    /// @brief Number of references in hit cells
+    uint64_t candidates_ = 0;
+};
+
+/// @brief Counters policy that counts nothing, calls are removed by compiler. Default policy of tables.
+struct NullCounters {
+    static constexpr bool kEnabled = false;
+
+    void OnInsert(uint64_t, uint64_t, uint64_t, uint64_t) const {}
+    void OnQuery() const {}
+    void OnProbes(uint64_t, uint64_t, uint64_t) const {}
+
+    CountersSnapshot Snapshot() const {
+        return CountersSnapshot();
+    }
+
+    void Reset() {}
+};
+
+/// @brief Counters policy with relaxed atomic counters, safe for concurrent const queries.
+/// Counts are accumulated per call, so a query makes a few atomic operations, not one per probe.
+struct AtomicCounters {
+    static constexpr bool kEnabled = true;
+
+    AtomicCounters() = default;
+
+    AtomicCounters(const AtomicCounters& other) {
+        Store(other.Snapshot());
+    }
+
+    AtomicCounters& operator = (const AtomicCounters& other) {
+        Store(other.Snapshot());
+        return *this;
+    }
+
+    /// @brief Count inserts
+    /// @param adds - number of added references
+    /// @param cells_created - number of created cells
+    /// @param rehashes - number of hash table rehashes
+    /// @param allocated_bytes - allocated bytes
+    void OnInsert(uint64_t adds, uint64_t cells_created, uint64_t rehashes, uint64_t allocated_bytes) const {
+        adds_.fetch_add(adds, std::memory_order_relaxed);
+        cells_created_.fetch_add(cells_created, std::memory_order_relaxed);
+        rehashes_.fetch_add(rehashes, std::memory_order_relaxed);
+        allocated_bytes_.fetch_add(allocated_bytes, std::memory_order_relaxed);
+    }
+
+    /// @brief Count one range query
+    void OnQuery() const {
+        queries_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// @brief Count cell probes
+    /// @param probes - number of checked cells
+    /// @param hits - number of populated cells inside the query
+    /// @param candidates - number of references in hit cells
+    void OnProbes(uint64_t probes, uint64_t hits, uint64_t candidates) const {
+        probes_.fetch_add(probes, std::memory_order_relaxed);
+        hits_.fetch_add(hits, std::memory_order_relaxed);
+        candidates_.fetch_add(candidates, std::memory_order_relaxed);
+    }
+
+    /// @brief Returns current counter values
+    CountersSnapshot Snapshot() const {
+        CountersSnapshot result;
+        result.adds_ = adds_.load(std::memory_order_relaxed);
+        result.cells_created_ = cells_created_.load(std::memory_order_relaxed);
+        result.rehashes_ = rehashes_.load(std::memory_order_relaxed);
+        result.allocated_bytes_ = allocated_bytes_.load(std::memory_order_relaxed);
+        result.queries_ = queries_.load(std::memory_order_relaxed);
+        result.probes_ = probes_.load(std::memory_order_relaxed);
+        result.hits_ = hits_.load(std::memory_order_relaxed);
+        result.misses_ = result.probes_ - result.hits_;
+        result.candidates_ = candidates_.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    /// @brief Set all counters to zero
+    void Reset() {
+        Store(CountersSnapshot());
+    }
+
+private:
+    void Store(const CountersSnapshot& values) {
+        adds_.store(values.adds_, std::memory_order_relaxed);
+        cells_created_.store(values.cells_created_, std::memory_order_relaxed);
+        rehashes_.store(values.rehashes_, std::memory_order_relaxed);
+        allocated_bytes_.store(values.allocated_bytes_, std::memory_order_relaxed);
+        queries_.store(values.queries_, std::memory_order_relaxed);
+        probes_.store(values.probes_, std::memory_order_relaxed);
+        hits_.store(values.hits_, std::memory_order_relaxed);
+        candidates_.store(values.candidates_, std::memory_order_relaxed);
+    }
+
+    mutable std::atomic<uint64_t> adds_ {0};
+    mutable std::atomic<uint64_t> cells_created_ {0};
+    mutable std::atomic<uint64_t> rehashes_ {0};
+    mutable std::atomic<uint64_t> allocated_bytes_ {0};
+    mutable std::atomic<uint64_t> queries_ {0};
+    mutable std::atomic<uint64_t> probes_ {0};
+    mutable std::atomic<uint64_t> hits_ {0};
+    mutable std::atomic<uint64_t> candidates_ {0};
+};
+
+}
@@ -0,0 +1,296 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+#include <iterator>
+#include <cstddef>
+#include <cstdint>
+
+namespace libs::spatial_hash {
+
+/// @brief Open addressing hash map with Robin Hood linear probing.
+/// Keys are stored inline next to the values, probe distances are kept in a separate byte array,
+/// so a miss is usually resolved by one or two byte compares without touching the slot.
+/// Subset of std::unordered_map interface used by spatial hash tables.
+/// @tparam KeyType - key type, must be default constructible and equality comparable
+/// @tparam ValueType - value type, must be default constructible
+/// @tparam HashType - key hash function
+template<typename KeyType, typename ValueType, typename HashType>
+class FlatHashMap {
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<KeyType, ValueType>;
+    using size_type = size_t;
+
+    template<bool IsConst>
+    class Iterator {
+    private:
+        using MapPtr = std::conditional_t<IsConst, const FlatHashMap*, FlatHashMap*>;
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = FlatHashMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<IsConst, const value_type&, value_type&>;
+        using pointer = std::conditional_t<IsConst, const value_type*, value_type*>;
+
+        Iterator() : map_(nullptr), pos_(0) {}
+        Iterator(MapPtr map, size_t pos) : map_(map), pos_(pos) { SkipEmpty(); }
+
+        /// @brief Conversion from non const iterator
+        template<bool OtherConst, typename = std::enable_if_t<IsConst && !OtherConst>>
+        Iterator(const Iterator<OtherConst>& other) : map_(other.map_), pos_(other.pos_) {}
+
+        reference operator*() const { return map_->slots_[pos_]; }
+        pointer operator->() const { return &(map_->slots_[pos_]); }
+
+        Iterator& operator++() {
+            ++pos_;
+            SkipEmpty();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator result = *this;
+            ++(*this);
+            return result;
+        }
+
+        friend bool operator == (const Iterator& a, const Iterator& b) {
+            return a.pos_ == b.pos_;
+        }
+
+        friend bool operator != (const Iterator& a, const Iterator& b) {
+            return a.pos_ != b.pos_;
+        }
+    private:
+        friend class FlatHashMap;
+        template<bool> friend class Iterator;
+
+        void SkipEmpty() {
+            const size_t capacity = map_->dists_.size();
+            while (pos_ < capacity && 0 == map_->dists_[pos_]) {
+                ++pos_;
+            }
+        }
+
+        MapPtr map_;
+        size_t pos_;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    FlatHashMap() = default;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, dists_.size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, dists_.size()); }
+
+    /// @brief Returns number of elements
+    size_t size() const { return size_; }
+
+    /// @brief Returns true if map has no elements
+    bool empty() const { return 0 == size_; }
+
+    /// @brief Returns number of slots
+    size_t bucket_count() const { return dists_.size(); }
+
+    /// @brief Returns ratio of elements to slots
+    float load_factor() const {
+        return dists_.empty() ? 0.0f : static_cast<float>(size_) / dists_.size();
+    }
+
+    /// @brief Remove all elements, capacity is kept for reuse
+    void clear() {
+        if (0 == size_) {
+            return;
+        }
+
+        if constexpr (std::is_trivially_destructible<value_type>::value) {
+            // stale values are overwritten on insert
+            std::fill(dists_.begin(), dists_.end(), 0);
+        } else {
+            for(size_t i = 0; i < dists_.size(); ++i) {
+                if (dists_[i]) {
+                    slots_[i] = value_type();
+                    dists_[i] = 0;
+                }
+            }
+        }
+        size_ = 0;
+    }
+
+    /// @brief Reserve space for at least count elements without rehash
+    /// @param count - number of elements
+    void reserve(size_t count) {
+        size_t capacity = kMinCapacity;
+        while (capacity * kMaxLoadNum < count * kMaxLoadDen) {
+            capacity *= 2;
+        }
+
+        if (capacity > dists_.size()) {
+            Rehash(capacity);
+        }
+    }
+
+    iterator find(const KeyType& key) {
+        return iterator(this, FindPos(key));
+    }
+
+    const_iterator find(const KeyType& key) const {
+        return const_iterator(this, FindPos(key));
+    }
+
+    /// @brief Returns number of elements with the key (0 or 1)
+    size_t count(const KeyType& key) const {
+        return FindPos(key) != dists_.size() ? 1 : 0;
+    }
+
+    /// @brief Access or insert element with default value.
+    /// Invalidates iterators and references if element was inserted.
+    ValueType& operator[](const KeyType& key) {
+        size_t pos = FindPos(key);
+        if (pos != dists_.size()) {
+            return slots_[pos].second;
+        }
+
+        InsertNew(value_type(key, ValueType()));
+        return slots_[FindPos(key)].second;
+    }
+
+    /// @brief Erase element by key
+    /// @return number of erased elements (0 or 1)
+    size_t erase(const KeyType& key) {
+        size_t pos = FindPos(key);
+        if (pos == dists_.size()) {
+            return 0;
+        }
+        ErasePos(pos);
+        return 1;
+    }
+
+    /// @brief Erase element by iterator.
+    /// Backward shift deletion moves following elements, so iterators to other elements are invalidated.
+    /// @return iterator to the element that takes place of the erased one
+    iterator erase(const_iterator itr) {
+        size_t pos = itr.pos_;
+        ErasePos(pos);
+        return iterator(this, pos);
+    }
+
+private:
+    static constexpr size_t kMinCapacity = 16;
+    // max load factor 7/8
+    static constexpr size_t kMaxLoadNum = 7;
+    static constexpr size_t kMaxLoadDen = 8;
+    static constexpr uint8_t kMaxDist = 255;
+
+    size_t HomePos(const KeyType& key) const {
+        // Fibonacci hashing spreads packed keys over the high bits
+        return static_cast<size_t>((static_cast<uint64_t>(HashType()(key)) * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+
+    /// @brief Returns slot position of the key or capacity if not found
+    size_t FindPos(const KeyType& key) const {
+        if (0 == size_) {
+            return dists_.size();
+        }
+
+        size_t pos = HomePos(key);
+        for(uint32_t dist = 1; dist <= dists_[pos]; ++dist) {
+            if (dists_[pos] == dist && slots_[pos].first == key) {
+                return pos;
+            }
+            pos = (pos + 1) & mask_;
+        }
+
+        return dists_.size();
+    }
+
+    /// @brief Inserts new element, the key must not exist in map
+    void InsertNew(value_type&& value) {
+        if ((size_ + 1) * kMaxLoadDen > dists_.size() * kMaxLoadNum) {
+            Rehash(dists_.empty() ? kMinCapacity : dists_.size() * 2);
+        }
+
+        size_t pos = HomePos(value.first);
+        uint32_t dist = 1;
+        for(;;) {
+            if (dist > kMaxDist) {
+                // probe sequence is too long, grow and place the element in hand
+                Rehash(dists_.size() * 2);
+                InsertNew(std::move(value));
+                return;
+            }
+
+            if (0 == dists_[pos]) {
+                slots_[pos] = std::move(value);
+                dists_[pos] = static_cast<uint8_t>(dist);
+                ++size_;
+                return;
+            }
+
+            if (dists_[pos] < dist) {
+                // take the place of the richer element and continue with it
+                std::swap(slots_[pos], value);
+                uint32_t tmp = dists_[pos];
+                dists_[pos] = static_cast<uint8_t>(dist);
+                dist = tmp;
+            }
+
+            pos = (pos + 1) & mask_;
+            ++dist;
+        }
+    }
+
+    /// @brief Erase element with backward shift of the following probe sequence
+    void ErasePos(size_t pos) {
+        size_t next = (pos + 1) & mask_;
+        while (dists_[next] > 1) {
+            slots_[pos] = std::move(slots_[next]);
+            dists_[pos] = dists_[next] - 1;
+            pos = next;
+            next = (next + 1) & mask_;
+        }
+
+        slots_[pos] = value_type();
+        dists_[pos] = 0;
+        --size_;
+    }
+
+    void Rehash(size_t capacity) {
+        std::vector<value_type> old_slots(capacity);
+        std::vector<uint8_t> old_dists(capacity, 0);
+        old_slots.swap(slots_);
+        old_dists.swap(dists_);
+
+        mask_ = capacity - 1;
+        shift_ = 64;
+        for(size_t c = capacity; c > 1; c >>= 1) {
+            --shift_;
+        }
+
+        size_ = 0;
+        for(size_t i = 0; i < old_dists.size(); ++i) {
+            if (old_dists[i]) {
+                InsertNew(std::move(old_slots[i]));
+            }
+        }
+    }
+
+    std::vector<value_type> slots_;
+    std::vector<uint8_t> dists_;
+    size_t size_ = 0;
+    size_t mask_ = 0;
+    uint32_t shift_ = 64;
+};
+
+}
@@ -0,0 +1,40 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com 
+
+#pragma once
+
+#include "spatial_hash/FlatHashMap.h"
+#include <unordered_map>
+
+namespace libs::spatial_hash {
+
+/// @brief Hash table backend based on std::unordered_map (node based, default).
+struct StdHashMapBackend {
+    template<typename KeyType, typename ValueType, typename HashType>
+    using Map = std::unordered_map<KeyType, ValueType, HashType>;
+
+    /// @brief Returns approximate memory of the map structure in bytes, without memory owned by values.
+    /// Node is value, next pointer and cached hash.
+    template<typename MapType>
+    static size_t MemoryUsage(const MapType& map) {
+        return map.bucket_count() * sizeof(void*) + 
+            map.size() * (sizeof(typename MapType::value_type) + sizeof(void*) + sizeof(size_t));
+    }
+};
+
+/// @brief Hash table backend based on open addressing FlatHashMap.
+/// Faster lookups, especially for empty cells, but references to cells are invalidated on insert and erase.
+struct FlatHashMapBackend {
+    template<typename KeyType, typename ValueType, typename HashType>
+    using Map = FlatHashMap<KeyType, ValueType, HashType>;
+
+    /// @brief Returns memory of the map structure in bytes, without memory owned by values.
+    /// Slot is value and one byte probe distance.
+    template<typename MapType>
+    static size_t MemoryUsage(const MapType& map) {
+        return map.bucket_count() * (sizeof(typename MapType::value_type) + 1);
+    }
+};
+
+}
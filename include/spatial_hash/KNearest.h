@@ -0,0 +1,72 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com 
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace libs::spatial_hash {
+
+/// @brief Bounded max heap that keeps k nearest candidates.
+/// @tparam DataType - distance type (float, double)
+/// @tparam RefType - associated data type 
+template<typename DataType, typename RefType>
+class KNearestHeap {
+public:
+    using ItemType = std::pair<DataType, RefType>;
+
+    explicit KNearestHeap(size_t k) : k_(k) {
+        items_.reserve(k);
+    }
+
+    /// @brief Add candidate, it is dropped if k closer candidates are already collected
+    /// @param sqr_distance - squared distance to the candidate
+    /// @param ref - candidate reference
+    void Push(DataType sqr_distance, const RefType& ref) {
+        if (items_.size() < k_) {
+            items_.emplace_back(sqr_distance, ref);
+            std::push_heap(items_.begin(), items_.end(), Less);
+        } else if (k_ > 0 && sqr_distance < items_.front().first) {
+            std::pop_heap(items_.begin(), items_.end(), Less);
+            items_.back() = ItemType(sqr_distance, ref);
+            std::push_heap(items_.begin(), items_.end(), Less);
+        }
+    }
+
+    /// @brief Returns true if k candidates are collected 
+    bool Full() const {
+        return items_.size() >= k_;
+    }
+
+    /// @brief Returns squared distance of k-th candidate, or max value if heap is not full
+    DataType WorstSqrDistance() const {
+        return Full() && k_ > 0 ? items_.front().first : std::numeric_limits<DataType>::max();
+    }
+
+    /// @brief Write candidates sorted by distance, nearest first 
+    /// @param refs - output references, overwritten
+    /// @param sqr_distances - output squared distances, overwritten
+    void Extract(std::vector<RefType>& refs, std::vector<DataType>& sqr_distances) {
+        std::sort_heap(items_.begin(), items_.end(), Less);
+        refs.clear();
+        sqr_distances.clear();
+        for(const auto& item : items_) {
+            sqr_distances.push_back(item.first);
+            refs.push_back(item.second);
+        }
+    }
+
+private:
+    static bool Less(const ItemType& a, const ItemType& b) {
+        return a.first < b.first;
+    }
+
+    size_t k_;
+    std::vector<ItemType> items_;
+};
+
+}
@@ -0,0 +1,216 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SPATIAL_HASH_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace libs::spatial_hash {
+
+/// @brief Read only file mapped in memory. Platforms without mmap read the file in a buffer instead.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+
+    ~MappedFile() {
+        Close();
+    }
+
+    /// @brief Map the whole file, previous mapping is closed.
+    /// @param path - file path
+    /// @return true on success
+    bool Open(const std::string& path) {
+        Close();
+#if defined(SPATIAL_HASH_MMAP)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat file_stat;
+        if (0 != ::fstat(fd, &file_stat) || file_stat.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+
+        const size_t size = static_cast<size_t>(file_stat.st_size);
+        void* data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (MAP_FAILED == data) {
+            return false;
+        }
+        data_ = static_cast<const uint8_t*>(data);
+        size_ = size;
+        return true;
+#else
+        std::ifstream stream(path, std::ios::binary | std::ios::ate);
+        if (!stream) {
+            return false;
+        }
+        // uint64_t keeps the buffer 8 byte aligned
+        const size_t size = static_cast<size_t>(stream.tellg());
+        buffer_.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        stream.seekg(0);
+        if (!stream.read(reinterpret_cast<char*>(buffer_.data()), size)) {
+            buffer_.clear();
+            return false;
+        }
+        data_ = reinterpret_cast<const uint8_t*>(buffer_.data());
+        size_ = size;
+        return true;
+#endif
+    }
+
+    /// @brief Unmap the file
+    void Close() {
+#if defined(SPATIAL_HASH_MMAP)
+        if (data_) {
+            ::munmap(const_cast<uint8_t*>(data_), size_);
+        }
+#else
+        buffer_.clear();
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const uint8_t* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#if !defined(SPATIAL_HASH_MMAP)
+    std::vector<uint64_t> buffer_;
+#endif
+};
+
+/// @brief Read only array, either owned vector or view of external memory (mapped file).
+/// @tparam T - trivially copyable element type
+template<typename T>
+class ArrayStorage {
+public:
+    ArrayStorage() = default;
+
+    ArrayStorage(const ArrayStorage& other) {
+        *this = other;
+    }
+
+    ArrayStorage(ArrayStorage&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    ArrayStorage& operator = (const ArrayStorage& other) {
+        if (this != &other) {
+            owned_ = other.owned_;
+            data_ = other.IsView() ? other.data_ : owned_.data();
+            size_ = other.size_;
+        }
+        return *this;
+    }
+
+    ArrayStorage& operator = (ArrayStorage&& other) noexcept {
+        if (this != &other) {
+            const bool is_view = other.IsView();
+            owned_ = std::move(other.owned_);
+            data_ = is_view ? other.data_ : owned_.data();
+            size_ = other.size_;
+            other.Clear();
+        }
+        return *this;
+    }
+
+    /// @brief Take ownership of the vector
+    void Assign(std::vector<T>&& values) {
+        owned_ = std::move(values);
+        data_ = owned_.data();
+        size_ = owned_.size();
+    }
+
+    /// @brief Refer to external memory, the memory has to outlive the storage
+    void SetView(const T* data, size_t size) {
+        owned_ = std::vector<T>();
+        data_ = data;
+        size_ = size;
+    }
+
+    void Clear() {
+        owned_ = std::vector<T>();
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    /// @brief Returns true if the storage refers to external memory
+    bool IsView() const {
+        return data_ != nullptr && data_ != owned_.data();
+    }
+
+    /// @brief Returns owned heap memory in bytes, views own nothing
+    size_t MemoryUsage() const {
+        return owned_.capacity() * sizeof(T);
+    }
+
+    const T* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return 0 == size_;
+    }
+
+    const T* begin() const {
+        return data_;
+    }
+
+    const T* end() const {
+        return data_ + size_;
+    }
+
+    const T& operator[](size_t i) const {
+        return data_[i];
+    }
+
+private:
+    std::vector<T> owned_;
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+namespace detail {
+
+/// @brief Snapshot files are little endian, the data is stored as in memory, so it can be mapped only on little endian hosts
+inline bool IsLittleEndian() {
+    const uint16_t value = 1;
+    uint8_t first_byte = 0;
+    std::memcpy(&first_byte, &value, 1);
+    return 1 == first_byte;
+}
+
+}
+
+}
@@ -0,0 +1,120 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include "spatial_hash/SpatialHash3D.h"
+#include <cstdint>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+namespace libs::spatial_hash {
+
+namespace detail {
+
+/// @brief Bits of x dimension in 3D Morton code
+constexpr uint64_t kMortonMaskX = 0x1249249249249249ull;
+constexpr int64_t kMortonOffset = int64_t(1) << 20;
+
+/// @brief Spreads 21 low bits of the value to every third bit
+inline uint64_t MortonSplit3(uint64_t v) {
+#if defined(__BMI2__)
+    return _pdep_u64(v, kMortonMaskX);
+#else
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+#endif
+}
+
+/// @brief Collects every third bit of the value to 21 low bits
+inline uint64_t MortonCompact3(uint64_t v) {
+#if defined(__BMI2__)
+    return _pext_u64(v, kMortonMaskX);
+#else
+    v &= 0x1249249249249249ull;
+    v = (v ^ (v >> 2)) & 0x10c30c30c30c30c3ull;
+    v = (v ^ (v >> 4)) & 0x100f00f00f00f00full;
+    v = (v ^ (v >> 8)) & 0x1f0000ff0000ffull;
+    v = (v ^ (v >> 16)) & 0x1f00000000ffffull;
+    v = (v ^ (v >> 32)) & 0x1fffff;
+    return v;
+#endif
+}
+
+}
+
+/// @brief Morton (Z-order) code of 3D hash index, 21 bits per dimension.
+/// Supported index range is the same as for SpatalHash3D [-1048576 .. 1048575].
+/// Sorting by the code keeps neighbouring voxels close to each other.
+inline uint64_t MortonEncode3D(const HashIndex3D& index) {
+    return detail::MortonSplit3(static_cast<uint64_t>(index.x_ + detail::kMortonOffset)) |
+        (detail::MortonSplit3(static_cast<uint64_t>(index.y_ + detail::kMortonOffset)) << 1) |
+        (detail::MortonSplit3(static_cast<uint64_t>(index.z_ + detail::kMortonOffset)) << 2);
+}
+
+/// @brief Hash index of 3D Morton code
+inline HashIndex3D MortonDecode3D(uint64_t code) {
+    return HashIndex3D(
+        static_cast<int32_t>(static_cast<int64_t>(detail::MortonCompact3(code)) - detail::kMortonOffset),
+        static_cast<int32_t>(static_cast<int64_t>(detail::MortonCompact3(code >> 1)) - detail::kMortonOffset),
+        static_cast<int32_t>(static_cast<int64_t>(detail::MortonCompact3(code >> 2)) - detail::kMortonOffset));
+}
+
+/// @brief 3D spatial hash function based on Morton code
+struct MortonHash3D {
+    uint64_t operator() (const HashIndex3D& val) const
+    {
+        return MortonEncode3D(val);
+    }
+};
+
+/// @brief Checks if Morton code is inside the box given by Morton codes of its min and max corners
+inline bool MortonInBox3D(uint64_t code, uint64_t code_min, uint64_t code_max) {
+    for(int dim = 0; dim < 3; ++dim) {
+        const uint64_t mask = detail::kMortonMaskX << dim;
+        const uint64_t value = code & mask;
+        if (value < (code_min & mask) || (code_max & mask) < value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// @brief Returns the smallest Morton code greater than "code" that lies inside the box
+/// (BIGMIN of Tropf and Herzog). Code has to be inside [code_min, code_max] range and outside the box.
+/// @param code - Morton code outside the box
+/// @param code_min - Morton code of the box min corner
+/// @param code_max - Morton code of the box max corner
+inline uint64_t MortonNextInBox3D(uint64_t code, uint64_t code_min, uint64_t code_max) {
+    uint64_t big_min = 0;
+    for(int bit = 62; bit >= 0; --bit) {
+        const uint64_t bit_mask = uint64_t(1) << bit;
+        // lower bits of the same dimension
+        const uint64_t dim_mask = (detail::kMortonMaskX << (bit % 3)) & (bit_mask - 1);
+        const bool code_bit = code & bit_mask;
+        const bool min_bit = code_min & bit_mask;
+        const bool max_bit = code_max & bit_mask;
+
+        if (!code_bit && !min_bit && max_bit) {
+            big_min = (code_min & ~dim_mask) | bit_mask;
+            code_max = (code_max & ~bit_mask) | dim_mask;
+        } else if (!code_bit && min_bit && max_bit) {
+            return code_min;
+        } else if (code_bit && !min_bit && !max_bit) {
+            return big_min;
+        } else if (code_bit && !min_bit && max_bit) {
+            code_min = (code_min & ~dim_mask) | bit_mask;
+        }
+    }
+    return big_min;
+}
+
+}
@@ -0,0 +1,169 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+namespace libs::spatial_hash {
+
+/// @brief Returns number of threads to use for "count" items.
+/// @param num_threads - requested number of threads, 0 - hardware concurrency
+/// @param count - number of items
+/// @param min_chunk - minimal number of items per thread
+inline size_t GetThreadCount(size_t num_threads, size_t count, size_t min_chunk = 1) {
+    if (0 == num_threads) {
+        num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    return std::max<size_t>(1, std::min(num_threads, count / std::max<size_t>(1, min_chunk)));
+}
+
+/// @brief Pool of persistent worker threads that process chunks of [0, count) range together with the calling thread.
+/// Workers are started on demand and wait for the next job between calls, so small per frame batches don't pay
+/// for thread start-up. Jobs of concurrent callers are serialized, a job started from a chunk of another job
+/// runs on the calling thread.
+class ThreadPool {
+public:
+    ThreadPool() = default;
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            is_stopped_ = true;
+        }
+        wake_.notify_all();
+        for(auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    /// @brief Returns pool shared by ParallelFor calls, workers live until the program exit
+    static ThreadPool& GetShared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    /// @brief Returns number of started worker threads
+    size_t GetWorkerCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return workers_.size();
+    }
+
+    /// @brief Splits [0, count) range into "num_chunks" contiguous chunks and processes them on the calling thread
+    /// and up to num_chunks - 1 workers. Chunk boundaries depend only on count and num_chunks.
+    /// @param count - number of items
+    /// @param num_chunks - number of chunks, must be positive
+    /// @param fn - callable with (size_t chunk_idx, size_t begin, size_t end) arguments
+    template<typename Fn>
+    void Run(size_t count, size_t num_chunks, Fn&& fn) {
+        using FnType = std::remove_reference_t<Fn>;
+        if (IsInsideJob() || num_chunks <= 1) {
+            for(size_t c = 0; c < num_chunks; ++c) {
+                fn(c, count * c / num_chunks, count * (c + 1) / num_chunks);
+            }
+            return;
+        }
+
+        std::lock_guard<std::mutex> run_lock(run_mutex_);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // workers of the previous job may still be leaving it
+            idle_.wait(lock, [this]() { return 0 == active_; });
+            while (workers_.size() + 1 < num_chunks) {
+                workers_.emplace_back([this]() { WorkerLoop(); });
+            }
+            fn_ = const_cast<void*>(static_cast<const void*>(&fn));
+            invoke_ = [](void* fn_ptr, size_t chunk_idx, size_t begin, size_t end) {
+                (*static_cast<FnType*>(fn_ptr))(chunk_idx, begin, end);
+            };
+            count_ = count;
+            chunk_count_ = num_chunks;
+            next_chunk_.store(0, std::memory_order_relaxed);
+            ++generation_;
+        }
+        wake_.notify_all();
+
+        RunChunks();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this]() { return 0 == active_; });
+    }
+
+private:
+    static bool& IsInsideJob() {
+        thread_local bool is_inside = false;
+        return is_inside;
+    }
+
+    void RunChunks() {
+        IsInsideJob() = true;
+        for(size_t c = next_chunk_.fetch_add(1); c < chunk_count_; c = next_chunk_.fetch_add(1)) {
+            invoke_(fn_, c, count_ * c / chunk_count_, count_ * (c + 1) / chunk_count_);
+        }
+        IsInsideJob() = false;
+    }
+
+    void WorkerLoop() {
+        uint64_t seen_generation = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [&]() { return is_stopped_ || seen_generation != generation_; });
+            if (is_stopped_) {
+                return;
+            }
+            seen_generation = generation_;
+            ++active_;
+            lock.unlock();
+            RunChunks();
+            lock.lock();
+            if (0 == --active_) {
+                idle_.notify_all();
+            }
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::mutex run_mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::vector<std::thread> workers_;
+    bool is_stopped_ = false;
+    uint64_t generation_ = 0;
+    size_t active_ = 0;
+
+    // current job, written under mutex_ while no worker is active
+    void* fn_ = nullptr;
+    void (*invoke_)(void*, size_t, size_t, size_t) = nullptr;
+    size_t count_ = 0;
+    size_t chunk_count_ = 0;
+    std::atomic<size_t> next_chunk_{0};
+};
+
+/// @brief Splits [0, count) range into "num_threads" contiguous chunks and processes them in parallel
+/// on the shared thread pool. Chunk boundaries depend only on count and num_threads, the calling thread
+/// processes chunks too.
+/// @param count - number of items
+/// @param num_threads - number of threads, must be positive
+/// @param fn - callable with (size_t thread_idx, size_t begin, size_t end) arguments, thread_idx - chunk index
+template<typename Fn>
+void ParallelFor(size_t count, size_t num_threads, Fn&& fn) {
+    if (num_threads <= 1) {
+        fn(size_t(0), size_t(0), count);
+        return;
+    }
+    ThreadPool::GetShared().Run(count, num_threads, std::forward<Fn>(fn));
+}
+
+}
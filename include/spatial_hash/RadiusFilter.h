@@ -0,0 +1,100 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com 
+
+#pragma once
+
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SPATIAL_HASH_AVX2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SPATIAL_HASH_NEON
+#endif
+
+namespace libs::spatial_hash::detail {
+
+/// @brief Visit indices of mask set bits 
+template<typename Visitor>
+inline void VisitMask(uint32_t mask, size_t offset, Visitor& visitor) {
+    while (mask) {
+        visitor(offset + __builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+}
+
+/// @brief Distance filter for points in structure of arrays layout. 
+/// Uses AVX2 or NEON if available for the target, scalar code otherwise.
+/// @tparam DataType - 3D spase data type (float, double)
+/// @param x - x coordinates
+/// @param y - y coordinates
+/// @param z - z coordinates
+/// @param count - number of points
+/// @param center - sphere center
+/// @param radius_sqr - squared sphere radius
+/// @param visitor - callable with (size_t index) argument, called for every point strictly inside the sphere
+template<typename DataType, typename Visitor>
+void RadiusFilter(const DataType* x, const DataType* y, const DataType* z, size_t count, 
+    const DataType center[3], DataType radius_sqr, Visitor&& visitor) {
+    size_t i = 0;
+
+#if defined(SPATIAL_HASH_AVX2)
+    if constexpr (std::is_same_v<DataType, float>) {
+        const __m256 cx = _mm256_set1_ps(center[0]);
+        const __m256 cy = _mm256_set1_ps(center[1]);
+        const __m256 cz = _mm256_set1_ps(center[2]);
+        const __m256 r2 = _mm256_set1_ps(radius_sqr);
+        for(; i + 8 <= count; i += 8) {
+            __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), cx);
+            __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), cy);
+            __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + i), cz);
+            __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+            VisitMask(_mm256_movemask_ps(_mm256_cmp_ps(d2, r2, _CMP_LT_OQ)), i, visitor);
+        }
+    } else if constexpr (std::is_same_v<DataType, double>) {
+        const __m256d cx = _mm256_set1_pd(center[0]);
+        const __m256d cy = _mm256_set1_pd(center[1]);
+        const __m256d cz = _mm256_set1_pd(center[2]);
+        const __m256d r2 = _mm256_set1_pd(radius_sqr);
+        for(; i + 4 <= count; i += 4) {
+            __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + i), cx);
+            __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + i), cy);
+            __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + i), cz);
+            __m256d d2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+            VisitMask(_mm256_movemask_pd(_mm256_cmp_pd(d2, r2, _CMP_LT_OQ)), i, visitor);
+        }
+    }
+#elif defined(SPATIAL_HASH_NEON)
+    if constexpr (std::is_same_v<DataType, float>) {
+        const float32x4_t cx = vdupq_n_f32(center[0]);
+        const float32x4_t cy = vdupq_n_f32(center[1]);
+        const float32x4_t cz = vdupq_n_f32(center[2]);
+        const float32x4_t r2 = vdupq_n_f32(radius_sqr);
+        for(; i + 4 <= count; i += 4) {
+            float32x4_t dx = vsubq_f32(vld1q_f32(x + i), cx);
+            float32x4_t dy = vsubq_f32(vld1q_f32(y + i), cy);
+            float32x4_t dz = vsubq_f32(vld1q_f32(z + i), cz);
+            float32x4_t d2 = vaddq_f32(vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy)), vmulq_f32(dz, dz));
+            uint32x4_t lt = vcltq_f32(d2, r2);
+            uint32_t mask = (vgetq_lane_u32(lt, 0) & 1u) | (vgetq_lane_u32(lt, 1) & 2u) | 
+                (vgetq_lane_u32(lt, 2) & 4u) | (vgetq_lane_u32(lt, 3) & 8u);
+            VisitMask(mask, i, visitor);
+        }
+    }
+#endif
+
+    for(; i < count; ++i) {
+        DataType dx = x[i] - center[0];
+        DataType dy = y[i] - center[1];
+        DataType dz = z[i] - center[2];
+        if (dx * dx + dy * dy + dz * dz < radius_sqr) {
+            visitor(i);
+        }
+    }
+}
+
+}
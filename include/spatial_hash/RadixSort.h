@@ -0,0 +1,149 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com 
+
+#pragma once
+
+#include "spatial_hash/Parallel.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace libs::spatial_hash {
+
+/// @brief Stable LSD radix sort of 64 bit keys with attached values. 
+/// Sorts by 16 bit digits, passes where all keys have the same digit are skipped.
+/// @tparam ValueType - attached value type
+/// @param keys - keys to sort
+/// @param values - values, reordered together with keys
+template<typename ValueType>
+void RadixSort(std::vector<uint64_t>& keys, std::vector<ValueType>& values) {
+    constexpr uint32_t kDigitBits = 16;
+    constexpr size_t kBuckets = size_t(1) << kDigitBits;
+    constexpr uint64_t kDigitMask = kBuckets - 1;
+    constexpr uint32_t kPasses = 64 / kDigitBits;
+
+    const size_t size = keys.size();
+    if (size < 2) {
+        return;
+    }
+
+    std::vector<size_t> histograms(kPasses * kBuckets, 0);
+    for(uint64_t key : keys) {
+        for(uint32_t pass = 0; pass < kPasses; ++pass) {
+            ++histograms[pass * kBuckets + ((key >> (pass * kDigitBits)) & kDigitMask)];
+        }
+    }
+
+    std::vector<uint64_t> keys_tmp(size);
+    std::vector<ValueType> values_tmp(size);
+    for(uint32_t pass = 0; pass < kPasses; ++pass) {
+        const uint32_t shift = pass * kDigitBits;
+        size_t* histogram = &histograms[pass * kBuckets];
+        if (histogram[(keys[0] >> shift) & kDigitMask] == size) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for(size_t i = 0; i < kBuckets; ++i) {
+            size_t count = histogram[i];
+            histogram[i] = offset;
+            offset += count;
+        }
+
+        for(size_t i = 0; i < size; ++i) {
+            size_t pos = histogram[(keys[i] >> shift) & kDigitMask]++;
+            keys_tmp[pos] = keys[i];
+            values_tmp[pos] = values[i];
+        }
+
+        keys.swap(keys_tmp);
+        values.swap(values_tmp);
+    }
+}
+
+/// @brief Parallel stable LSD radix sort of 64 bit keys with attached values.
+/// Every thread counts digits of its chunk, chunks are scattered to disjoint ranges, so the order is the same as sequential sort.
+/// @tparam ValueType - attached value type
+/// @param keys - keys to sort
+/// @param values - values, reordered together with keys
+/// @param num_threads - number of threads, 0 - hardware concurrency
+template<typename ValueType>
+void RadixSort(std::vector<uint64_t>& keys, std::vector<ValueType>& values, size_t num_threads) {
+    constexpr uint32_t kDigitBits = 16;
+    constexpr size_t kBuckets = size_t(1) << kDigitBits;
+    constexpr uint64_t kDigitMask = kBuckets - 1;
+    constexpr uint32_t kPasses = 64 / kDigitBits;
+
+    const size_t size = keys.size();
+    num_threads = GetThreadCount(num_threads, size, kBuckets);
+    if (num_threads <= 1) {
+        RadixSort(keys, values);
+        return;
+    }
+
+    std::vector<size_t> histograms(num_threads * kBuckets);
+    std::vector<uint64_t> keys_tmp(size);
+    std::vector<ValueType> values_tmp(size);
+    for(uint32_t pass = 0; pass < kPasses; ++pass) {
+        const uint32_t shift = pass * kDigitBits;
+        ParallelFor(size, num_threads, [&](size_t thread_idx, size_t begin, size_t end) {
+            size_t* histogram = &histograms[thread_idx * kBuckets];
+            std::fill(histogram, histogram + kBuckets, 0);
+            for(size_t i = begin; i < end; ++i) {
+                ++histogram[(keys[i] >> shift) & kDigitMask];
+            }
+        });
+
+        const uint64_t first_digit = (keys[0] >> shift) & kDigitMask;
+        size_t first_digit_count = 0;
+        for(size_t t = 0; t < num_threads; ++t) {
+            first_digit_count += histograms[t * kBuckets + first_digit];
+        }
+        if (first_digit_count == size) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for(size_t i = 0; i < kBuckets; ++i) {
+            for(size_t t = 0; t < num_threads; ++t) {
+                size_t count = histograms[t * kBuckets + i];
+                histograms[t * kBuckets + i] = offset;
+                offset += count;
+            }
+        }
+
+        ParallelFor(size, num_threads, [&](size_t thread_idx, size_t begin, size_t end) {
+            size_t* histogram = &histograms[thread_idx * kBuckets];
+            for(size_t i = begin; i < end; ++i) {
+                size_t pos = histogram[(keys[i] >> shift) & kDigitMask]++;
+                keys_tmp[pos] = keys[i];
+                values_tmp[pos] = values[i];
+            }
+        });
+
+        keys.swap(keys_tmp);
+        values.swap(values_tmp);
+    }
+}
+
+/// @brief Computes keys of points in parallel and sorts point indices by key.
+/// @param count - number of points
+/// @param key_fn - callable with (size_t point_idx) argument, returns uint64_t key
+/// @param num_threads - number of threads, 0 - hardware concurrency
+/// @param keys - output sorted keys
+/// @param order - output point indices in key order, stable for equal keys
+template<typename KeyFn>
+void SortByKey(size_t count, KeyFn&& key_fn, size_t num_threads, std::vector<uint64_t>& keys, std::vector<uint32_t>& order) {
+    keys.resize(count);
+    order.resize(count);
+    ParallelFor(count, GetThreadCount(num_threads, count, 1 << 14), [&](size_t, size_t begin, size_t end) {
+        for(size_t i = begin; i < end; ++i) {
+            keys[i] = key_fn(i);
+            order[i] = static_cast<uint32_t>(i);
+        }
+    });
+    RadixSort(keys, order, num_threads);
+}
+
+}
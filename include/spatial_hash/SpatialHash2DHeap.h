@@ -6,17 +6,22 @@
 
 #include "spatial_hash/SpatialHash2D.h"
 #include "spatial_hash/Containers.h"
+#include <limits>
 
 namespace libs::spatial_hash {
 
 /// @brief 2D spatial hash table with limited priority queue container. 
+/// Every cell keeps "limit" references with the largest keys.
 /// @tparam DataType - 2D spase data type (float, double) 
+/// @tparam KeyT - reference key (score) type
 /// @tparam RefType - associated data type 
-template<typename DataType, typename KeyT, typename RefType>
-class SpatialHashTable2DHeap : public SpatialHashTable2D<DataType, RefType, ContainerHeap<KeyT, RefType>> {
+/// @tparam MapBackend - hash table backend (StdHashMapBackend, FlatHashMapBackend)
+/// @tparam CountersType - hot path counters policy (NullCounters, AtomicCounters)
+template<typename DataType, typename KeyT, typename RefType, typename MapBackend = StdHashMapBackend, typename CountersType = NullCounters>
+class SpatialHashTable2DHeap : public SpatialHashTable2D<DataType, RefType, ContainerTopK<KeyT, RefType>, MapBackend, CountersType> {
 public:
-    using CellType = ContainerHeap<KeyT, RefType>;
-    using BaseClass = SpatialHashTable2D<DataType, RefType, ContainerHeap<KeyT, RefType>>;
+    using CellType = ContainerTopK<KeyT, RefType>;
+    using BaseClass = SpatialHashTable2D<DataType, RefType, ContainerTopK<KeyT, RefType>, MapBackend, CountersType>;
     using HashTableType = typename BaseClass::HashTableType;
 public:
     SpatialHashTable2DHeap() : BaseClass() {} 
@@ -24,17 +29,18 @@ public:
 
     /// @brief Add value to hash table
     /// @param point - continuous 2D space point
+    /// @param key - reference key, cells keep references with the largest keys
     /// @param ref - associated data
     void Add(const DataType point[2], KeyT key, RefType ref) {
         HashIndex2D cell_index = BaseClass::GetCellIndex(point);
-        BaseClass::table_[cell_index].Add(key, ref, limit_);
+        BaseClass::AddToCell(cell_index, key, ref, limit_);
     }
 
     std::vector<RefType> GetAllData() const {
         std::vector<RefType> result;
 
-        for(const auto cell : BaseClass::table_) {
-            for(const auto itr : cell.second) {
+        for(const auto& cell : BaseClass::table_) {
+            for(const auto& itr : cell.second) {
                 result.push_back(itr.second); 
             }    
         }
@@ -46,4 +52,4 @@ private:
     size_t limit_ = std::numeric_limits<size_t>::max();
 };
 
-}
\ No newline at end of file
+}
@@ -6,32 +6,121 @@
 
 #include "spatial_hash/SpatialHash2D.h"
 #include "spatial_hash/Containers.h"
+#include "spatial_hash/KNearest.h"
+#include <utility>
 
 namespace libs::spatial_hash {
 
 /// @brief 2D spatial hash table with vector container. 
 /// @tparam DataType - 2D spase data type (float, double) 
 /// @tparam RefType - associated data type 
-template<typename DataType, typename RefType>
-class SpatialHashTable2DVector : public SpatialHashTable2D<DataType, RefType, ContainerVector<RefType>> {
+/// @tparam MapBackend - hash table backend (StdHashMapBackend, FlatHashMapBackend)
+/// @tparam CountersType - hot path counters policy (NullCounters, AtomicCounters)
+template<typename DataType, typename RefType, typename MapBackend = StdHashMapBackend, typename CountersType = NullCounters>
+class SpatialHashTable2DVector : public SpatialHashTable2D<DataType, RefType, ContainerVector<RefType>, MapBackend, CountersType> {
 public:
     using CellType = ContainerVector<RefType>;
-    using BaseClass = SpatialHashTable2D<DataType, RefType, ContainerVector<RefType>>;
+    using BaseClass = SpatialHashTable2D<DataType, RefType, ContainerVector<RefType>, MapBackend, CountersType>;
     using HashTableType = typename BaseClass::HashTableType;
 public:
     SpatialHashTable2DVector() : BaseClass() {} 
     SpatialHashTable2DVector(DataType cell_size) : BaseClass(cell_size) {} 
 
+    /// @brief Visit all data references in specified square. Square parameters in discrete hash table space.
+    /// @param center_cell - center cell
+    /// @param half_size - half square size 
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInSquare(HashIndex2D center_cell, int32_t half_size, Visitor&& visitor) const {
+        BaseClass::ForEachCellInSquare(center_cell, half_size, [&visitor](const HashIndex2D&, const CellType& cell) {
+            for(const RefType& ref : cell) {
+                visitor(ref);
+            }
+        });
+    }
+
+    /// @brief Visit all data references in specified square. Square parameters in discrete hash table space.
+    /// @param left_top - left top corner 
+    /// @param right_bottom - right bottom corner 
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInSquare(HashIndex2D left_top, HashIndex2D right_bottom, Visitor&& visitor) const {
+        BaseClass::ForEachCellInSquare(left_top, right_bottom, [&visitor](const HashIndex2D&, const CellType& cell) {
+            for(const RefType& ref : cell) {
+                visitor(ref);
+            }
+        });
+    }
+
+    /// @brief Visit all data references in square, that defined by two points
+    /// @param left_top - left top corner 
+    /// @param right_bottom - right bottom corner
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInSquare(const DataType left_top[2], const DataType right_bottom[2], Visitor&& visitor) const {
+        HashIndex2D lt_index = BaseClass::GetCellIndex(left_top);
+        HashIndex2D rb_index = BaseClass::GetCellIndex(right_bottom);
+        ForEachInSquare(lt_index, rb_index, std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Visit all data references in square, that defined in R2 space 
+    /// @param center - square center
+    /// @param half_size - half square size
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInSquare(const DataType center[2], DataType half_size, Visitor&& visitor) const {
+        HashIndex2D center_index = BaseClass::GetCellIndex(center);
+        uint32_t half_size_i = half_size * BaseClass::GetInvVoxelSize();
+        ForEachInSquare(center_index, half_size_i, std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Append all data references in specified square to caller owned buffer. Square parameters in discrete hash table space.
+    /// @param center_cell - center cell
+    /// @param half_size - half square size 
+    /// @param result - output buffer, references are appended
+    void SquareSearch(HashIndex2D center_cell, int32_t half_size, std::vector<RefType>& result) const {
+        BaseClass::ForEachCellInSquare(center_cell, half_size, [&result](const HashIndex2D&, const CellType& cell) {
+            result.insert(result.end(), cell.begin(), cell.end());
+        });
+    }
+
+    /// @brief Append all data references in specified square to caller owned buffer. Square parameters in discrete hash table space.
+    /// @param left_top - left top corner 
+    /// @param right_bottom - right bottom corner 
+    /// @param result - output buffer, references are appended
+    void SquareSearch(HashIndex2D left_top, HashIndex2D right_bottom, std::vector<RefType>& result) const {
+        BaseClass::ForEachCellInSquare(left_top, right_bottom, [&result](const HashIndex2D&, const CellType& cell) {
+            result.insert(result.end(), cell.begin(), cell.end());
+        });
+    }
+
+    /// @brief Append all data references in square, that defined by two points, to caller owned buffer
+    /// @param left_top - left top corner 
+    /// @param right_bottom - right bottom corner
+    /// @param result - output buffer, references are appended
+    void SquareSearch(const DataType left_top[2], const DataType right_bottom[2], std::vector<RefType>& result) const {
+        HashIndex2D lt_index = BaseClass::GetCellIndex(left_top);
+        HashIndex2D rb_index = BaseClass::GetCellIndex(right_bottom);
+        SquareSearch(lt_index, rb_index, result);
+    }
+
+    /// @brief Append all data references in square, that defined in R2 space, to caller owned buffer
+    /// @param center - square center
+    /// @param half_size - half square size
+    /// @param result - output buffer, references are appended
+    void SquareSearch(const DataType center[2], DataType half_size, std::vector<RefType>& result) const {
+        HashIndex2D center_index = BaseClass::GetCellIndex(center);
+        uint32_t half_size_i = half_size * BaseClass::GetInvVoxelSize();
+        SquareSearch(center_index, half_size_i, result);
+    }
+
     /// @brief Search all data references in specified square. Square parameters in discrete hash table space.
     /// @param center_cell - center cell
     /// @param half_size - half square size 
     /// @return all data references in the square  
     std::vector<RefType> SquareSearch(HashIndex2D center_cell, int32_t half_size) const {
         std::vector<RefType> result;
-        std::vector<const CellType*> cells = BaseClass::SquareSearch(center_cell, half_size);
-        for(const CellType* cell : cells) {
-            result.insert(result.end(), cell->begin(), cell->end());
-        }
+        SquareSearch(center_cell, half_size, result);
         return result;
     }
 
@@ -41,10 +130,7 @@ public:
     /// @return all data references in the square
     std::vector<RefType> SquareSearch(HashIndex2D left_top, HashIndex2D right_bottom) const {
         std::vector<RefType> result;
-        std::vector<const CellType*> cells = BaseClass::SquareSearch(left_top, right_bottom);
-        for(const CellType* cell : cells) {
-            result.insert(result.end(), cell->begin(), cell->end());
-        }
+        SquareSearch(left_top, right_bottom, result);
         return result;
     }
 
@@ -53,9 +139,9 @@ public:
     /// @param right_bottom - right bottom corner
     /// @return all data references in the square 
     std::vector<RefType> SquareSearch(const DataType left_top[2], const DataType right_bottom[2]) const {
-        HashIndex2D lt_index = BaseClass::GetCellIndex(left_top);
-        HashIndex2D rb_index = BaseClass::GetCellIndex(right_bottom);
-        return SquareSearch(lt_index, rb_index);
+        std::vector<RefType> result;
+        SquareSearch(left_top, right_bottom, result);
+        return result;
     }
 
     /// @brief Search cells in square, that defined in R2 space 
@@ -63,11 +149,58 @@ public:
     /// @param half_size - half square size
     /// @return all data references in the square
     std::vector<RefType> SquareSearch(const DataType center[2], DataType half_size) const {
-        HashIndex2D center_index = BaseClass::GetCellIndex(center);
-        uint32_t half_size_i = half_size * BaseClass::GetInvVoxelSize();
-        return SquareSearch(center_index, half_size_i);
+        std::vector<RefType> result;
+        SquareSearch(center, half_size, result);
+        return result;
     } 
 
+    /// @brief Visit data references of all cells intersecting the circle. References are not filtered by distance,
+    /// the table doesn't store points.
+    /// @param center - circle center
+    /// @param radius - circle radius
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInCircle(const DataType center[2], DataType radius, Visitor&& visitor) const {
+        BaseClass::ForEachCellInCircle(center, radius, [&visitor](const HashIndex2D&, const CellType& cell) {
+            for(const RefType& ref : cell) {
+                visitor(ref);
+            }
+        });
+    }
+
+    /// @brief Append data references of all cells intersecting the circle to caller owned buffer.
+    /// @param center - circle center
+    /// @param radius - circle radius
+    /// @param result - output buffer, references are appended
+    void CircleSearch(const DataType center[2], DataType radius, std::vector<RefType>& result) const {
+        BaseClass::ForEachCellInCircle(center, radius, [&result](const HashIndex2D&, const CellType& cell) {
+            result.insert(result.end(), cell.begin(), cell.end());
+        });
+    }
+
+    /// @brief Search data references of all cells intersecting the circle.
+    /// @param center - circle center
+    /// @param radius - circle radius
+    /// @return data references of the cells
+    std::vector<RefType> CircleSearch(const DataType center[2], DataType radius) const {
+        std::vector<RefType> result;
+        CircleSearch(center, radius, result);
+        return result;
+    }
+
+    /// @brief Visit data references of all cells that can intersect the convex polygon.
+    /// @param region - convex region given by half-planes
+    /// @param visitor - callable with (const RefType& ref, bool is_inside) arguments,
+    /// is_inside - the cell of the reference is completely inside of the polygon
+    template<typename Visitor>
+    void ForEachInPolygon(const ConvexRegion<DataType, 2>& region, Visitor&& visitor) const {
+        BaseClass::ForEachCellInPolygon(region, [&visitor](const HashIndex2D&, const CellType& cell, bool is_inside) {
+            for(const RefType& ref : cell) {
+                visitor(ref, is_inside);
+            }
+        });
+    }
+
     /// @brief Retrieve data from the cell 
     /// @param cell_index - cell index
     /// @return data references in the cell 
@@ -79,6 +212,87 @@ public:
         }
         return result;
     }
+
+    /// @brief Search k nearest neighbours of the point. Cells are visited shell by shell outward from the point cell 
+    /// until the next shell can't contain closer points.
+    /// @param point - continuous 2D space point
+    /// @param k - number of neighbours
+    /// @param point_accessor - callable with (const RefType&) argument, returns pointer to 2D point of the reference
+    /// @param refs - output references sorted by distance, nearest first, overwritten
+    /// @param sqr_distances - output squared distances, overwritten
+    template<typename PointAccessor>
+    void KNearest(const DataType point[2], size_t k, PointAccessor&& point_accessor, 
+        std::vector<RefType>& refs, std::vector<DataType>& sqr_distances) const {
+        if (0 == k) {
+            refs.clear();
+            sqr_distances.clear();
+            return;
+        }
+        KNearestHeap<DataType, RefType> heap(k);
+        BaseClass::ForEachCellInShells(point, 
+            [&](const HashIndex2D&, const CellType& cell) {
+                for(const RefType& ref : cell) {
+                    const DataType* p = point_accessor(ref);
+                    DataType dx = p[0] - point[0];
+                    DataType dy = p[1] - point[1];
+                    heap.Push(dx * dx + dy * dy, ref);
+                }
+            }, 
+            [&heap](DataType min_distance) {
+                return heap.Full() && min_distance * min_distance >= heap.WorstSqrDistance();
+            });
+        heap.Extract(refs, sqr_distances);
+    }
+
+    /// @brief Search k nearest neighbours of the point.
+    /// @param point - continuous 2D space point
+    /// @param k - number of neighbours
+    /// @param point_accessor - callable with (const RefType&) argument, returns pointer to 2D point of the reference
+    /// @return references sorted by distance, nearest first
+    template<typename PointAccessor>
+    std::vector<RefType> KNearest(const DataType point[2], size_t k, PointAccessor&& point_accessor) const {
+        std::vector<RefType> refs;
+        std::vector<DataType> sqr_distances;
+        KNearest(point, k, std::forward<PointAccessor>(point_accessor), refs, sqr_distances);
+        return refs;
+    }
+
+    /// @brief Visit references of populated cells crossed by the line segment, cells are visited in traversal order.
+    /// Cost is proportional to the segment length in cells.
+    /// @param origin - segment start
+    /// @param direction - segment direction, doesn't have to be normalized
+    /// @param max_range - segment length, can be infinite
+    /// @param visitor - callable with (const RefType& ref, DataType distance) arguments, distance - segment length at the cell entry
+    template<typename Visitor>
+    void Raycast(const DataType origin[2], const DataType direction[2], DataType max_range, Visitor&& visitor) const {
+        BaseClass::ForEachCellOnLine(origin, direction, max_range, 
+            [&visitor](const HashIndex2D&, const CellType& cell, DataType distance) {
+                for(const RefType& ref : cell) {
+                    visitor(ref, distance);
+                }
+                return false;
+            });
+    }
+
+    /// @brief Search the first populated cell crossed by the line segment, traversal stops at it.
+    /// @param origin - segment start
+    /// @param direction - segment direction, doesn't have to be normalized
+    /// @param max_range - segment length, can be infinite
+    /// @param hit_index - output cell index
+    /// @param hit_distance - output segment length at the cell entry, 0 if the origin cell is populated
+    /// @return true if a populated cell was found
+    bool RaycastFirst(const DataType origin[2], const DataType direction[2], DataType max_range, 
+        HashIndex2D& hit_index, DataType& hit_distance) const {
+        bool result = false;
+        BaseClass::ForEachCellOnLine(origin, direction, max_range, 
+            [&](const HashIndex2D& index, const CellType&, DataType distance) {
+                hit_index = index;
+                hit_distance = distance;
+                result = true;
+                return true;
+            });
+        return result;
+    }
 };
 
-}
\ No newline at end of file
+}
@@ -1,187 +1,183 @@
 /// BSD 3-Clause License
 /// Copyright (c) 2023, Sergey Chechkin
-/// Autor: Sergey Chechkin, schechkin@gmail.com 
+/// Autor: Sergey Chechkin, schechkin@gmail.com
 
 #pragma once
 
-#include <unordered_map>
-#include <cmath>
+#include "spatial_hash/SpatialHashND.h"
+#include <vector>
+#include <utility>
 #include <cstdint>
 
 namespace libs::spatial_hash {
 
-/// @brief 3D hash table index type 
-/// supported cells dimention value range [-1048576 .. 1048575]
-struct HashIndex3D {
-    HashIndex3D() :
-        x_(0), y_(0), z_(0) {}
-    HashIndex3D(int32_t x, int32_t y, int32_t z) :
-        x_(x), y_(y), z_(z) {}
-
-    int32_t x_;
-    int32_t y_;
-    int32_t z_;
-
-    friend bool operator == (const HashIndex3D& a, const HashIndex3D& b)
-    {
-        return !(a.x_ != b.x_ || a.y_ != b.y_ || a.z_ != b.z_);
-    }
-
-    friend HashIndex3D operator + (const HashIndex3D& lhs, const HashIndex3D& rhs)
-    {
-        return HashIndex3D(lhs.x_ + rhs.x_, lhs.y_ + rhs.y_, lhs.z_ + rhs.z_);
-    }
-};
-
-struct SpatalHash3D {
-    uint64_t operator() (const HashIndex3D& val) const
-    {
-        static int64_t max_size = std::pow(2, 20);
-        return static_cast<uint64_t>(val.x_ + max_size) + 
-            static_cast<uint64_t>((val.y_ + max_size) << 21u) + 
-            static_cast<uint64_t>((val.z_ + max_size) << 42u);
-    }
-};
-
 /// DataType - float, double
 /// RefType - associated data
 /// ContainerType - voxel container type, must have Add(...) method
 
-/// @brief  Base class for 3D spatal hash table.
+/// @brief  Base class for 3D spatal hash table, voxel named API over SpatialHashTable<3, ...>.
 /// @tparam DataType - 3D spase data type (float, double)
-/// @tparam RefType - point associated data type 
-/// @tparam ContainerType - voxel container type, must have Add(...) method 
-template<typename DataType, typename RefType, typename ContainerType>
-class SpatialHashTable3D {
+/// @tparam RefType - point associated data type
+/// @tparam ContainerType - voxel container type, must have Add(...) method
+/// @tparam MapBackend - hash table backend (StdHashMapBackend, FlatHashMapBackend)
+/// @tparam CountersType - hot path counters policy (NullCounters, AtomicCounters)
+template<typename DataType, typename RefType, typename ContainerType, typename MapBackend = StdHashMapBackend,
+    typename CountersType = NullCounters>
+class SpatialHashTable3D : public SpatialHashTable<3, DataType, RefType, ContainerType, MapBackend, CountersType> {
 protected:
-    using HashTableType = std::unordered_map<HashIndex3D, ContainerType, SpatalHash3D>;
-
-    DataType voxel_size_;
-    DataType inv_voxel_size_;
-    HashTableType table_;
+    using BaseClass = SpatialHashTable<3, DataType, RefType, ContainerType, MapBackend, CountersType>;
+    using HashTableType = typename BaseClass::HashTableType;
 public:
 
-    /// @brief Default constructor. 
-    SpatialHashTable3D() : voxel_size_(0), inv_voxel_size_(0) {}
+    /// @brief Default constructor.
+    SpatialHashTable3D() : BaseClass() {}
 
     /// @brief Constructor with voxel size.
     /// @param voxel_size - voxel size
-    explicit SpatialHashTable3D(DataType voxel_size) : voxel_size_(voxel_size), inv_voxel_size_(1 / voxel_size) {}
+    explicit SpatialHashTable3D(DataType voxel_size) : BaseClass(voxel_size) {}
 
     /// @brief Sets voxel size.
     /// @param voxel_size - voxel size
     void SetVoxelSize(DataType voxel_size) {
-        Clear();
-        voxel_size_ = voxel_size;
-        inv_voxel_size_ = 1 / voxel_size;
-    }
-
-    /// @brief Clear the hash table. 
-    void Clear() {
-        table_.clear();
+        BaseClass::SetCellSize(voxel_size);
     }
 
-    /// @brief Returns voxel size. 
+    /// @brief Returns voxel size.
     /// @return voxel size
     DataType GetVoxelSize() const {
-        return voxel_size_;
-    } 
+        return BaseClass::GetCellSize();
+    }
 
     /// @brief Returns inverse voxel size.
     /// @return - inverse voxel size
     DataType GetInvVoxelSize() const {
-        return inv_voxel_size_;
-    } 
-
-    /// @brief Returns hash table
-    /// @return hash table reference 
-    const HashTableType& GetTable() const {
-        return table_;
-    } 
-    
-    /// @brief Add value to hash table
-    /// @param point - continuous 3D space point
-    /// @param ref - associated data 
-    void Add(const DataType point[3], RefType ref) {
-        HashIndex3D voxel_index = GetVoxelIndex(point);
-        table_[voxel_index].Add(ref);
+        return BaseClass::GetInvCellSize();
     }
 
-    /// @brief Convert continuous 3D space point in discrete hash space index 
+    /// @brief Convert continuous 3D space point in discrete hash space index
     /// @param point - continuous 3D space point
     /// @return hash table index
     HashIndex3D GetVoxelIndex(const DataType point[3]) const {
-        HashIndex3D result;
-        result.x_ = static_cast<int32_t>(std::floor(point[0] * inv_voxel_size_));
-        result.y_ = static_cast<int32_t>(std::floor(point[1] * inv_voxel_size_));
-        result.z_ = static_cast<int32_t>(std::floor(point[2] * inv_voxel_size_));
-        return result;
+        return BaseClass::GetCellIndex(point);
     }
 
 protected:
-    /// @brief Returns voxel container pointer. 
-    /// @param index - voxel index 
-    /// @return voxel container pointer  
+    /// @brief Add value to the voxel container, the voxel is created if it doesn't exist.
+    /// @param index - voxel index
+    /// @param args - container Add(...) arguments
+    template<typename... Args>
+    void AddToVoxel(const HashIndex3D& index, Args&&... args) {
+        BaseClass::AddToCell(index, std::forward<Args>(args)...);
+    }
+
+    /// @brief Remove value from the voxel, empty voxel is erased.
+    /// @param index - voxel index
+    /// @param ref - associated data
+    /// @return true if value was found
+    bool RemoveFromVoxel(HashIndex3D index, const RefType& ref) {
+        return BaseClass::RemoveFromCell(index, ref);
+    }
+
+    /// @brief Returns voxel container pointer.
+    /// @param index - voxel index
+    /// @return voxel container pointer
     const ContainerType* GetVoxel(HashIndex3D index) const {
-        auto itr = table_.find(index);
-        if(table_.end() == itr) {
-            return nullptr;
-        }
+        return BaseClass::GetCell(index);
+    }
 
-        return &(itr->second);
-    } 
+    /// @brief Visit all populated voxels in the box between corner_min and corner_max (inclusive).
+    /// Corners have to be ordered, empty box visits nothing.
+    /// @param corner_min - min corner voxel
+    /// @param corner_max - max corner voxel
+    /// @param visitor - callable with (const HashIndex3D& index, const ContainerType& voxel) arguments
+    template<typename Visitor>
+    void ForEachVoxel(HashIndex3D corner_min, HashIndex3D corner_max, Visitor&& visitor) const {
+        BaseClass::ForEachCell(corner_min, corner_max, std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Visit all populated voxels in (2 * half_size + 1) cube of voxels with "center" voxel in center
+    /// @param center - center voxel
+    /// @param half_size - half size of the search cube
+    /// @param visitor - callable with (const HashIndex3D& index, const ContainerType& voxel) arguments
+    template<typename Visitor>
+    void ForEachVoxelInCube(HashIndex3D center, int32_t half_size, Visitor&& visitor) const {
+        BaseClass::ForEachCellInBox(center, half_size, std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Visit all populated voxels in the cube defined by two diagonal voxels
+    /// @param corner_min - first diagonal voxel
+    /// @param corner_max - second diagonal voxel
+    /// @param visitor - callable with (const HashIndex3D& index, const ContainerType& voxel) arguments
+    template<typename Visitor>
+    void ForEachVoxelInCube(HashIndex3D corner_min, HashIndex3D corner_max, Visitor&& visitor) const {
+        BaseClass::ForEachCellInBox(corner_min, corner_max, std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Visit all populated voxels on the surface of (2 * ring + 1) cube of voxels with "center" voxel in center
+    /// @param center - center voxel
+    /// @param ring - Chebyshev distance from center voxel in voxels
+    /// @param visitor - callable with (const HashIndex3D& index, const ContainerType& voxel) arguments
+    template<typename Visitor>
+    void ForEachVoxelInShell(HashIndex3D center, int32_t ring, Visitor&& visitor) const {
+        BaseClass::ForEachCellInShell(center, ring, std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Visit populated voxels shell by shell outward from the voxel of the point.
+    /// Stops when all populated voxels are visited or when "stop" returns true.
+    /// @param point - continuous 3D space point
+    /// @param visitor - callable with (const HashIndex3D& index, const ContainerType& voxel) arguments
+    /// @param stop - callable with (DataType min_distance) argument, called before each shell,
+    /// min_distance - lower bound of the distance from the point to any voxel not visited yet
+    template<typename Visitor, typename StopPredicate>
+    void ForEachVoxelInShells(const DataType point[3], Visitor&& visitor, StopPredicate&& stop) const {
+        BaseClass::ForEachCellInShells(point, std::forward<Visitor>(visitor), std::forward<StopPredicate>(stop));
+    }
+
+    /// @brief Visit populated voxels intersecting the sphere, voxels of the bounding cube outside the sphere are not probed.
+    /// @param center - sphere center
+    /// @param radius - sphere radius
+    /// @param visitor - callable with (const HashIndex3D& index, const ContainerType& voxel) arguments
+    template<typename Visitor>
+    void ForEachVoxelInSphere(const DataType center[3], DataType radius, Visitor&& visitor) const {
+        BaseClass::ForEachCellInBall(center, radius, std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Visit populated voxels that can intersect the convex region (frustum, oriented box, convex polytope),
+    /// voxels outside of any half-space are not probed.
+    /// @param region - convex region
+    /// @param visitor - callable with (const HashIndex3D& index, const ContainerType& voxel, bool is_inside) arguments,
+    /// is_inside - the voxel is completely inside of the region
+    template<typename Visitor>
+    void ForEachVoxelInRegion(const ConvexRegion<DataType, 3>& region, Visitor&& visitor) const {
+        BaseClass::ForEachCellInRegion(region, std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Visit populated voxels crossed by the ray in traversal order, voxels are stepped one by one (3D DDA).
+    /// @param origin - ray origin
+    /// @param direction - ray direction, doesn't have to be normalized
+    /// @param max_range - ray length, can be infinite
+    /// @param visitor - callable with (const HashIndex3D& index, const ContainerType& voxel, DataType distance) arguments,
+    /// distance - ray length at the voxel entry, returns true to stop traversal
+    template<typename Visitor>
+    void ForEachVoxelOnRay(const DataType origin[3], const DataType direction[3], DataType max_range, Visitor&& visitor) const {
+        BaseClass::ForEachCellOnRay(origin, direction, max_range, std::forward<Visitor>(visitor));
+    }
 
     /// @brief Search all populated cells in (2 * half_size + 1) cube of voxels with "center" voxel in center
     /// @param center - center voxel
     /// @param half_size - half size of the search cube
     /// @return Return all populated cells in the cube
     std::vector<const ContainerType*> CubeSearch(HashIndex3D center, int32_t half_size) const {
-        std::vector<const ContainerType*> result;
-        
-        HashIndex3D grid_point;
-        for(grid_point.x_ = center.x_ - half_size; grid_point.x_ <= center.x_ + half_size; ++grid_point.x_) {
-            for(grid_point.y_ = center.y_ - half_size; grid_point.y_ <= center.y_ + half_size; ++grid_point.y_) {
-                for(grid_point.z_ = center.z_ - half_size; grid_point.z_ <= center.z_ + half_size; ++grid_point.z_) {            
-                    auto itr = table_.find(grid_point);
-                    if(table_.end() == itr) {
-                        continue;
-                    }
-                    result.push_back(&(itr->second));                
-                }
-            }
-        }
-
-        return result;
+        return BaseClass::BoxSearch(center, half_size);
     }
 
+    /// @brief Search all populated cells in the cube defined by two diagonal voxels
+    /// @param corner_min - first diagonal voxel
+    /// @param corner_max - second diagonal voxel
+    /// @return Return all populated cells in the cube
     std::vector<const ContainerType*> CubeSearch(HashIndex3D corner_min, HashIndex3D corner_max) const {
-        std::vector<const ContainerType*> result;
-        
-        if (corner_max.x_ < corner_min.x_) {
-            std::swap(corner_min.x_, corner_max.x_);
-        }        
-        if (corner_max.y_ < corner_min.y_) {
-            std::swap(corner_min.y_, corner_max.y_);
-        }    
-        if (corner_max.z_ < corner_min.z_) {
-            std::swap(corner_min.z_, corner_max.z_);
-        }    
-
-        HashIndex3D grid_point;
-        for(grid_point.x_ = corner_min.x_; grid_point.x_ <= corner_max.x_; ++grid_point.x_) {
-            for(grid_point.y_ = corner_min.y_; grid_point.y_ <= corner_max.y_; ++grid_point.y_) {
-                for(grid_point.z_ = corner_min.z_; grid_point.z_ <= corner_max.z_; ++grid_point.z_) {            
-                    auto itr = table_.find(grid_point);
-                    if(table_.end() == itr) {
-                        continue;
-                    }
-                    result.push_back(&(itr->second));                
-                }
-            }
-        }
-
-        return result;
+        return BaseClass::BoxSearch(corner_min, corner_max);
     }
 };
 
-}
\ No newline at end of file
+}
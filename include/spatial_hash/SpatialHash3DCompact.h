@@ -0,0 +1,644 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include "spatial_hash/SpatialHash3D.h"
+#include "spatial_hash/RadixSort.h"
+#include "spatial_hash/Morton.h"
+#include "spatial_hash/TableStatistics.h"
+#include "spatial_hash/MappedFile.h"
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <utility>
+#include <type_traits>
+#include <cstdint>
+
+namespace libs::spatial_hash {
+
+/// @brief Cell of compacted hash table, maps voxel index to [offset, offset + count) range of references.
+struct CompactCell {
+    HashIndex3D index_;
+    uint32_t count_ = 0;
+    uint64_t offset_ = 0;
+};
+
+static_assert(sizeof(CompactCell) == 24, "CompactCell is stored in snapshot files as is");
+
+/// @brief Header of compacted table snapshot file. File is little endian, sections are 64 byte aligned
+/// and stored as in memory, so a mapped file is queried in place.
+struct CompactSnapshotHeader {
+    static constexpr char kMagic[8] = {'S', 'H', 'A', 'S', 'H', '3', 'D', 'C'};
+    static constexpr uint32_t kVersion = 1;
+
+    char magic_[8];
+    uint32_t version_;
+    uint32_t header_size_;
+    uint32_t data_type_size_;
+    uint32_t ref_type_size_;
+    double voxel_size_;
+    /// @brief number of populated voxels
+    uint64_t cell_count_;
+    /// @brief number of open addressing index slots, power of two
+    uint64_t index_capacity_;
+    uint64_t ref_count_;
+    /// @brief section offsets from the file start
+    uint64_t cells_offset_;
+    uint64_t refs_offset_;
+    uint64_t codes_offset_;
+    uint64_t code_offsets_offset_;
+    uint64_t file_size_;
+};
+
+/// @brief Immutable 3D spatial hash table in compressed sparse row layout.
+/// All references are stored in one contiguous array sorted by voxel Morton (Z-order) code, so spatial neighbours
+/// are close in memory. Cells are kept in an open addressing index with voxel index stored inline for point lookups
+/// and in a sorted code array for box queries, which are decomposed into Z-order intervals.
+/// Table can be saved to a binary snapshot and loaded or memory mapped from it, mapped table is queried in place.
+/// @tparam DataType - 3D spase data type (float, double)
+/// @tparam RefType - associated data type
+template<typename DataType, typename RefType>
+class SpatialHashTable3DCompact {
+public:
+    /// @brief Default constructor.
+    SpatialHashTable3DCompact() : voxel_size_(0), inv_voxel_size_(0) {}
+
+    /// @brief Constructor with voxel size.
+    /// @param voxel_size - voxel size
+    explicit SpatialHashTable3DCompact(DataType voxel_size) : voxel_size_(voxel_size), inv_voxel_size_(1 / voxel_size) {}
+
+    /// @brief Sets voxel size.
+    /// @param voxel_size - voxel size
+    void SetVoxelSize(DataType voxel_size) {
+        Clear();
+        voxel_size_ = voxel_size;
+        inv_voxel_size_ = 1 / voxel_size;
+    }
+
+    /// @brief Clear the hash table.
+    void Clear() {
+        cells_.Clear();
+        refs_.Clear();
+        codes_.Clear();
+        code_offsets_.Clear();
+        mapping_.reset();
+        cell_count_ = 0;
+        mask_ = 0;
+        shift_ = 64;
+    }
+
+    /// @brief Returns voxel size.
+    /// @return voxel size
+    DataType GetVoxelSize() const {
+        return voxel_size_;
+    }
+
+    /// @brief Returns inverse voxel size.
+    /// @return - inverse voxel size
+    DataType GetInvVoxelSize() const {
+        return inv_voxel_size_;
+    }
+
+    /// @brief Returns number of populated voxels
+    size_t GetCellCount() const {
+        return cell_count_;
+    }
+
+    /// @brief Returns all references, grouped by voxel in Morton code order
+    const ArrayStorage<RefType>& GetRefs() const {
+        return refs_;
+    }
+
+    /// @brief Returns occupancy statistics of the table
+    /// @param histogram_size - number of cell size histogram bins
+    /// @return table statistics
+    TableStatistics GetStatistics(size_t histogram_size = 16) const {
+        TableStatistics result;
+        result.histogram_.assign(histogram_size, 0);
+        for(size_t i = 0; i < codes_.size(); ++i) {
+            result.AddCell(code_offsets_[i + 1] - code_offsets_[i]);
+        }
+        result.load_factor_ = cells_.empty() ? 0.0 : static_cast<double>(cell_count_) / cells_.size();
+        result.memory_bytes_ = sizeof(*this) + cells_.MemoryUsage() + refs_.MemoryUsage() + 
+            codes_.MemoryUsage() + code_offsets_.MemoryUsage() + (mapping_ ? mapping_->size() : 0);
+        result.Finalize();
+        return result;
+    }
+
+    /// @brief Convert continuous 3D space point in discrete hash space index
+    /// @param point - continuous 3D space point
+    /// @return hash table index
+    HashIndex3D GetVoxelIndex(const DataType point[3]) const {
+        HashIndex3D result;
+        result.x_ = static_cast<int32_t>(std::floor(point[0] * inv_voxel_size_));
+        result.y_ = static_cast<int32_t>(std::floor(point[1] * inv_voxel_size_));
+        result.z_ = static_cast<int32_t>(std::floor(point[2] * inv_voxel_size_));
+        return result;
+    }
+
+    /// @brief Build the table from point array, point index is used as reference. Previous content is replaced.
+    /// @param points - array of "count" 3D points (x, y, z)
+    /// @param count - number of points
+    /// @param num_threads - number of threads, 0 - hardware concurrency
+    void Build(const DataType* points, size_t count, size_t num_threads = 1) {
+        std::vector<RefType> refs(count);
+        ParallelFor(count, GetThreadCount(num_threads, count, 1 << 14), [&refs](size_t, size_t begin, size_t end) {
+            for(size_t i = begin; i < end; ++i) {
+                refs[i] = static_cast<RefType>(i);
+            }
+        });
+        Build(points, refs.data(), count, num_threads);
+    }
+
+    /// @brief Build the table from point and reference arrays. Previous content is replaced.
+    /// References in a voxel keep input order, as with sequential Add, for any number of threads.
+    /// @param points - array of "count" 3D points (x, y, z)
+    /// @param refs - array of "count" references
+    /// @param count - number of points
+    /// @param num_threads - number of threads, 0 - hardware concurrency
+    void Build(const DataType* points, const RefType* refs, size_t count, size_t num_threads = 1) {
+        Clear();
+
+        std::vector<uint64_t> keys;
+        std::vector<uint32_t> order;
+        SortByKey(count, [this, points](size_t i) { return MortonEncode3D(GetVoxelIndex(points + 3 * i)); }, 
+            num_threads, keys, order);
+
+        std::vector<RefType> sorted_refs(count);
+        ParallelFor(count, GetThreadCount(num_threads, count, 1 << 14), [&](size_t, size_t begin, size_t end) {
+            for(size_t i = begin; i < end; ++i) {
+                sorted_refs[i] = refs[order[i]];
+            }
+        });
+
+        size_t cell_count = 0;
+        for(size_t i = 0; i < count; ++i) {
+            if (0 == i || keys[i] != keys[i - 1]) {
+                ++cell_count;
+            }
+        }
+        std::vector<CompactCell> cells;
+        std::vector<uint64_t> codes;
+        std::vector<uint64_t> code_offsets;
+        InitIndex(cells, cell_count);
+        codes.reserve(cell_count);
+        code_offsets.reserve(cell_count + 1);
+
+        for(size_t begin = 0; begin < count;) {
+            size_t end = begin + 1;
+            while (end < count && keys[end] == keys[begin]) {
+                ++end;
+            }
+
+            CompactCell cell;
+            cell.index_ = MortonDecode3D(keys[begin]);
+            cell.offset_ = begin;
+            cell.count_ = static_cast<uint32_t>(end - begin);
+            InsertCell(cells, cell);
+            codes.push_back(keys[begin]);
+            code_offsets.push_back(begin);
+            begin = end;
+        }
+        code_offsets.push_back(count);
+
+        cells_.Assign(std::move(cells));
+        refs_.Assign(std::move(sorted_refs));
+        codes_.Assign(std::move(codes));
+        code_offsets_.Assign(std::move(code_offsets));
+    }
+
+    /// @brief Save the table to binary snapshot file. RefType has to be trivially copyable.
+    /// @param path - file path
+    /// @return true on success, false on write error or big endian host
+    bool Save(const std::string& path) const {
+        static_assert(std::is_trivially_copyable<RefType>::value, "RefType has to be trivially copyable");
+        if (!detail::IsLittleEndian()) {
+            return false;
+        }
+
+        CompactSnapshotHeader header;
+        std::memcpy(header.magic_, CompactSnapshotHeader::kMagic, sizeof(header.magic_));
+        header.version_ = CompactSnapshotHeader::kVersion;
+        header.header_size_ = sizeof(CompactSnapshotHeader);
+        header.data_type_size_ = sizeof(DataType);
+        header.ref_type_size_ = sizeof(RefType);
+        header.voxel_size_ = voxel_size_;
+        header.cell_count_ = cell_count_;
+        header.index_capacity_ = cells_.size();
+        header.ref_count_ = refs_.size();
+        header.cells_offset_ = AlignOffset(sizeof(CompactSnapshotHeader));
+        header.refs_offset_ = AlignOffset(header.cells_offset_ + cells_.size() * sizeof(CompactCell));
+        header.codes_offset_ = AlignOffset(header.refs_offset_ + refs_.size() * sizeof(RefType));
+        header.code_offsets_offset_ = AlignOffset(header.codes_offset_ + codes_.size() * sizeof(uint64_t));
+        header.file_size_ = header.code_offsets_offset_ + code_offsets_.size() * sizeof(uint64_t);
+
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            return false;
+        }
+        uint64_t position = 0;
+        WriteSection(stream, position, 0, &header, sizeof(header));
+        WriteSection(stream, position, header.cells_offset_, cells_.data(), cells_.size() * sizeof(CompactCell));
+        WriteSection(stream, position, header.refs_offset_, refs_.data(), refs_.size() * sizeof(RefType));
+        WriteSection(stream, position, header.codes_offset_, codes_.data(), codes_.size() * sizeof(uint64_t));
+        WriteSection(stream, position, header.code_offsets_offset_, code_offsets_.data(), code_offsets_.size() * sizeof(uint64_t));
+        stream.flush();
+        return static_cast<bool>(stream);
+    }
+
+    /// @brief Load the table from binary snapshot file, data is copied. Previous content is replaced.
+    /// Cell ranges and code offsets are validated, so corrupt files are rejected.
+    /// @param path - file path
+    /// @return true on success, false if file can't be read, doesn't match the table type or is inconsistent
+    bool Load(const std::string& path) {
+        auto mapping = std::make_shared<MappedFile>();
+        if (!mapping->Open(path) || !SetSnapshotView(mapping)) {
+            return false;
+        }
+        if (!IsSnapshotConsistent()) {
+            Clear();
+            return false;
+        }
+
+        // copy views to owned storage and release the file
+        cells_.Assign(std::vector<CompactCell>(cells_.begin(), cells_.end()));
+        refs_.Assign(std::vector<RefType>(refs_.begin(), refs_.end()));
+        codes_.Assign(std::vector<uint64_t>(codes_.begin(), codes_.end()));
+        code_offsets_.Assign(std::vector<uint64_t>(code_offsets_.begin(), code_offsets_.end()));
+        mapping_.reset();
+        return true;
+    }
+
+    /// @brief Map binary snapshot file in memory and query it in place, without copying and rehashing.
+    /// The file must not be modified while mapped. Previous content is replaced.
+    /// Only the header is validated, so sections aren't read on Map. Mapped files have to be trusted, e.g. written by Save,
+    /// corrupt cell sections cause out of bounds reads. Use Load for untrusted files.
+    /// @param path - file path
+    /// @return true on success, false if file can't be mapped or its header doesn't match the table type
+    bool Map(const std::string& path) {
+        auto mapping = std::make_shared<MappedFile>();
+        return mapping->Open(path) && SetSnapshotView(mapping);
+    }
+
+    /// @brief Returns true if the table refers to mapped snapshot file
+    bool IsMapped() const {
+        return static_cast<bool>(mapping_);
+    }
+
+    /// @brief Returns data for specific voxel index
+    /// @param index - voxel index
+    /// @return voxel references
+    std::vector<RefType> GetVoxelData(HashIndex3D index) const {
+        std::vector<RefType> result;
+        const CompactCell* cell = GetVoxel(index);
+        if (cell) {
+            result.insert(result.end(), refs_.data() + cell->offset_, refs_.data() + cell->offset_ + cell->count_);
+        }
+        return result;
+    }
+
+    /// @brief Visit all data references in specified cube. Cube parameters in discrete hash table space.
+    /// @param center - central voxel
+    /// @param half_size - half cube size
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInCube(HashIndex3D center, int32_t half_size, Visitor&& visitor) const {
+        HashIndex3D corner_min(center.x_ - half_size, center.y_ - half_size, center.z_ - half_size);
+        HashIndex3D corner_max(center.x_ + half_size, center.y_ + half_size, center.z_ + half_size);
+        ForEachVoxel(corner_min, corner_max, [&visitor](const HashIndex3D&, const RefType* begin, const RefType* end) {
+            for(; begin != end; ++begin) {
+                visitor(*begin);
+            }
+        });
+    }
+
+    /// @brief Visit all data references in specified cube. Cube parameters in discrete hash table space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInCube(HashIndex3D corner_min, HashIndex3D corner_max, Visitor&& visitor) const {
+        OrderCorners(corner_min, corner_max);
+        ForEachVoxel(corner_min, corner_max, [&visitor](const HashIndex3D&, const RefType* begin, const RefType* end) {
+            for(; begin != end; ++begin) {
+                visitor(*begin);
+            }
+        });
+    }
+
+    /// @brief Visit all data references in specified cube. Cube parameters in R3 space.
+    /// @param center - central point
+    /// @param half_size - half cube size in R3
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInCube(const DataType center[3], DataType half_size, Visitor&& visitor) const {
+        HashIndex3D center_index = GetVoxelIndex(center);
+        uint32_t half_size_i = half_size * GetInvVoxelSize();
+        ForEachInCube(center_index, half_size_i, std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Visit all data references in specified cube. Cube parameters in R3 space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInCube(const DataType corner_min[3], const DataType corner_max[3], Visitor&& visitor) const {
+        ForEachInCube(GetVoxelIndex(corner_min), GetVoxelIndex(corner_max), std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Append all data references in specified cube to caller owned buffer. Cube parameters in discrete hash table space.
+    /// @param center - central voxel
+    /// @param half_size - half cube size
+    /// @param result - output buffer, references are appended
+    void CubeSearch(HashIndex3D center, int32_t half_size, std::vector<RefType>& result) const {
+        HashIndex3D corner_min(center.x_ - half_size, center.y_ - half_size, center.z_ - half_size);
+        HashIndex3D corner_max(center.x_ + half_size, center.y_ + half_size, center.z_ + half_size);
+        ForEachVoxel(corner_min, corner_max, [&result](const HashIndex3D&, const RefType* begin, const RefType* end) {
+            result.insert(result.end(), begin, end);
+        });
+    }
+
+    /// @brief Append all data references in specified cube to caller owned buffer. Cube parameters in discrete hash table space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point
+    /// @param result - output buffer, references are appended
+    void CubeSearch(HashIndex3D corner_min, HashIndex3D corner_max, std::vector<RefType>& result) const {
+        OrderCorners(corner_min, corner_max);
+        ForEachVoxel(corner_min, corner_max, [&result](const HashIndex3D&, const RefType* begin, const RefType* end) {
+            result.insert(result.end(), begin, end);
+        });
+    }
+
+    /// @brief Append all data references in specified cube to caller owned buffer. Cube parameters in R3 space.
+    /// @param center - central point
+    /// @param half_size - half cube size in R3
+    /// @param result - output buffer, references are appended
+    void CubeSearch(const DataType center[3], DataType half_size, std::vector<RefType>& result) const {
+        HashIndex3D center_index = GetVoxelIndex(center);
+        uint32_t half_size_i = half_size * GetInvVoxelSize();
+        CubeSearch(center_index, half_size_i, result);
+    }
+
+    /// @brief Append all data references in specified cube to caller owned buffer. Cube parameters in R3 space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point
+    /// @param result - output buffer, references are appended
+    void CubeSearch(const DataType corner_min[3], const DataType corner_max[3], std::vector<RefType>& result) const {
+        CubeSearch(GetVoxelIndex(corner_min), GetVoxelIndex(corner_max), result);
+    }
+
+    /// @brief Search all data references in specified cube. Cube parameters in discrete hash table space.
+    /// @param center - central voxel
+    /// @param half_size - half cube size
+    /// @return all data references in cube
+    std::vector<RefType> CubeSearch(HashIndex3D center, int32_t half_size) const {
+        std::vector<RefType> result;
+        CubeSearch(center, half_size, result);
+        return result;
+    }
+
+    /// @brief Search all data references in specified cube. Cube parameters in discrete hash table space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point
+    /// @return all data references in cube
+    std::vector<RefType> CubeSearch(HashIndex3D corner_min, HashIndex3D corner_max) const {
+        std::vector<RefType> result;
+        CubeSearch(corner_min, corner_max, result);
+        return result;
+    }
+
+    /// @brief Search all data references in specified cube. Cube parameters in R3 space.
+    /// @param center - central point
+    /// @param half_size - half cube size in R3
+    /// @return all data references in cube
+    std::vector<RefType> CubeSearch(const DataType center[3], DataType half_size) const {
+        std::vector<RefType> result;
+        CubeSearch(center, half_size, result);
+        return result;
+    }
+
+    /// @brief Search all data references in specified cube. Cube parameters in R3 space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point
+    /// @return all data references in cube
+    std::vector<RefType> CubeSearch(const DataType corner_min[3], const DataType corner_max[3]) const {
+        std::vector<RefType> result;
+        CubeSearch(corner_min, corner_max, result);
+        return result;
+    }
+
+protected:
+    /// @brief Returns voxel cell pointer.
+    /// @param index - voxel index
+    /// @return cell pointer or nullptr for empty voxel
+    const CompactCell* GetVoxel(HashIndex3D index) const {
+        if (0 == cell_count_) {
+            return nullptr;
+        }
+
+        for(size_t pos = HomePos(index); cells_[pos].count_ != 0; pos = (pos + 1) & mask_) {
+            if (cells_[pos].index_ == index) {
+                return &cells_[pos];
+            }
+        }
+        return nullptr;
+    }
+
+    /// @brief Visit all populated voxels in the box between ordered corners (inclusive).
+    /// Small boxes are probed voxel by voxel, larger ones walk the sorted Morton codes and 
+    /// skip the codes outside the box with BIGMIN jumps, visiting voxels in memory order.
+    /// @param visitor - callable with (const HashIndex3D& index, const RefType* begin, const RefType* end) arguments
+    template<typename Visitor>
+    void ForEachVoxel(HashIndex3D corner_min, HashIndex3D corner_max, Visitor&& visitor) const {
+        if (corner_max.x_ < corner_min.x_ || corner_max.y_ < corner_min.y_ || corner_max.z_ < corner_min.z_) {
+            return;
+        }
+
+        const double box_volume = (double(corner_max.x_) - corner_min.x_ + 1) * 
+            (double(corner_max.y_) - corner_min.y_ + 1) * (double(corner_max.z_) - corner_min.z_ + 1);
+        if (box_volume > kMaxProbeVolume) {
+            ForEachVoxelInZOrder(corner_min, corner_max, std::forward<Visitor>(visitor));
+            return;
+        }
+
+        HashIndex3D grid_point;
+        for(grid_point.x_ = corner_min.x_; grid_point.x_ <= corner_max.x_; ++grid_point.x_) {
+            for(grid_point.y_ = corner_min.y_; grid_point.y_ <= corner_max.y_; ++grid_point.y_) {
+                for(grid_point.z_ = corner_min.z_; grid_point.z_ <= corner_max.z_; ++grid_point.z_) {
+                    const CompactCell* cell = GetVoxel(grid_point);
+                    if (nullptr == cell) {
+                        continue;
+                    }
+                    const RefType* begin = refs_.data() + cell->offset_;
+                    visitor(grid_point, begin, begin + cell->count_);
+                }
+            }
+        }
+    }
+
+    /// @brief Visit all populated voxels in the box between ordered corners by Z-order range decomposition.
+    /// @param visitor - callable with (const HashIndex3D& index, const RefType* begin, const RefType* end) arguments
+    template<typename Visitor>
+    void ForEachVoxelInZOrder(HashIndex3D corner_min, HashIndex3D corner_max, Visitor&& visitor) const {
+        const uint64_t code_min = MortonEncode3D(corner_min);
+        const uint64_t code_max = MortonEncode3D(corner_max);
+        auto itr = std::lower_bound(codes_.begin(), codes_.end(), code_min);
+        while (itr != codes_.end() && *itr <= code_max) {
+            const uint64_t code = *itr;
+            if (MortonInBox3D(code, code_min, code_max)) {
+                const size_t i = itr - codes_.begin();
+                const RefType* begin = refs_.data() + code_offsets_[i];
+                visitor(MortonDecode3D(code), begin, refs_.data() + code_offsets_[i + 1]);
+                ++itr;
+            } else {
+                itr = std::lower_bound(itr + 1, codes_.end(), MortonNextInBox3D(code, code_min, code_max));
+            }
+        }
+    }
+
+    static void OrderCorners(HashIndex3D& corner_min, HashIndex3D& corner_max) {
+        if (corner_max.x_ < corner_min.x_) {
+            std::swap(corner_min.x_, corner_max.x_);
+        }
+        if (corner_max.y_ < corner_min.y_) {
+            std::swap(corner_min.y_, corner_max.y_);
+        }
+        if (corner_max.z_ < corner_min.z_) {
+            std::swap(corner_min.z_, corner_max.z_);
+        }
+    }
+
+    size_t HomePos(const HashIndex3D& index) const {
+        return static_cast<size_t>((SpatalHash3D()(index) * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+
+    /// @brief Allocate empty index for cell_count cells with load factor at most 1/2
+    void InitIndex(std::vector<CompactCell>& cells, size_t cell_count) {
+        size_t capacity = 16;
+        while (capacity < 2 * cell_count) {
+            capacity *= 2;
+        }
+        SetIndexCapacity(capacity);
+        cells.assign(capacity, CompactCell());
+        cell_count_ = 0;
+    }
+
+    void SetIndexCapacity(size_t capacity) {
+        mask_ = capacity - 1;
+        shift_ = 64;
+        for(; capacity > 1; capacity /= 2) {
+            --shift_;
+        }
+    }
+
+    void InsertCell(std::vector<CompactCell>& cells, const CompactCell& cell) {
+        size_t pos = HomePos(cell.index_);
+        while (cells[pos].count_ != 0) {
+            pos = (pos + 1) & mask_;
+        }
+        cells[pos] = cell;
+        ++cell_count_;
+    }
+
+    static uint64_t AlignOffset(uint64_t offset) {
+        return (offset + 63) & ~uint64_t(63);
+    }
+
+    static void WriteSection(std::ofstream& stream, uint64_t& position, uint64_t offset, const void* data, size_t size) {
+        static const char padding[64] = {};
+        stream.write(padding, offset - position);
+        stream.write(static_cast<const char*>(data), size);
+        position = offset + size;
+    }
+
+    /// @brief Validate snapshot header and set array views to the mapped file sections.
+    /// @return true if the snapshot matches the table type, the table is cleared otherwise
+    bool SetSnapshotView(const std::shared_ptr<MappedFile>& mapping) {
+        Clear();
+        if (!detail::IsLittleEndian() || mapping->size() < sizeof(CompactSnapshotHeader)) {
+            return false;
+        }
+
+        CompactSnapshotHeader header;
+        std::memcpy(&header, mapping->data(), sizeof(header));
+        const uint64_t capacity = header.index_capacity_;
+        if (0 != std::memcmp(header.magic_, CompactSnapshotHeader::kMagic, sizeof(header.magic_)) ||
+            header.version_ != CompactSnapshotHeader::kVersion || header.header_size_ != sizeof(CompactSnapshotHeader) ||
+            header.data_type_size_ != sizeof(DataType) || header.ref_type_size_ != sizeof(RefType) ||
+            header.file_size_ > mapping->size() || (capacity & (capacity - 1)) != 0 || 2 * header.cell_count_ > capacity ||
+            header.cells_offset_ % 64 || header.refs_offset_ % 64 || header.codes_offset_ % 64 || header.code_offsets_offset_ % 64 ||
+            header.cells_offset_ + capacity * sizeof(CompactCell) > header.refs_offset_ ||
+            header.refs_offset_ + header.ref_count_ * sizeof(RefType) > header.codes_offset_ ||
+            header.codes_offset_ + header.cell_count_ * sizeof(uint64_t) > header.code_offsets_offset_ ||
+            header.code_offsets_offset_ + (capacity ? header.cell_count_ + 1 : 0) * sizeof(uint64_t) > header.file_size_) {
+            return false;
+        }
+
+        const uint8_t* data = mapping->data();
+        voxel_size_ = static_cast<DataType>(header.voxel_size_);
+        inv_voxel_size_ = 1 / voxel_size_;
+        if (capacity != 0) {
+            SetIndexCapacity(capacity);
+            cells_.SetView(reinterpret_cast<const CompactCell*>(data + header.cells_offset_), capacity);
+            refs_.SetView(reinterpret_cast<const RefType*>(data + header.refs_offset_), header.ref_count_);
+            codes_.SetView(reinterpret_cast<const uint64_t*>(data + header.codes_offset_), header.cell_count_);
+            code_offsets_.SetView(reinterpret_cast<const uint64_t*>(data + header.code_offsets_offset_), header.cell_count_ + 1);
+        }
+        cell_count_ = header.cell_count_;
+        mapping_ = mapping;
+        return true;
+    }
+
+    /// @brief Check sections set by SetSnapshotView: every cell refers to a range of references,
+    /// populated cells are as many as codes, codes are increasing and their offsets cover all references in order.
+    bool IsSnapshotConsistent() const {
+        const uint64_t ref_count = refs_.size();
+        size_t populated = 0;
+        for(const CompactCell& cell : cells_) {
+            if (0 == cell.count_) {
+                continue;
+            }
+            if (cell.offset_ > ref_count || cell.count_ > ref_count - cell.offset_) {
+                return false;
+            }
+            ++populated;
+        }
+        if (populated != cell_count_) {
+            return false;
+        }
+        if (0 == cell_count_) {
+            return true;
+        }
+
+        if (code_offsets_[0] != 0 || code_offsets_[cell_count_] != ref_count) {
+            return false;
+        }
+        for(size_t i = 0; i < cell_count_; ++i) {
+            if (code_offsets_[i + 1] < code_offsets_[i] || (i > 0 && codes_[i] <= codes_[i - 1])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief Boxes with more voxels are served by Z-order range decomposition instead of probing
+    static constexpr double kMaxProbeVolume = 64;
+
+    DataType voxel_size_;
+    DataType inv_voxel_size_;
+    ArrayStorage<CompactCell> cells_;
+    ArrayStorage<RefType> refs_;
+    ArrayStorage<uint64_t> codes_;
+    ArrayStorage<uint64_t> code_offsets_;
+    /// @brief mapped snapshot file, shared by copies of the table
+    std::shared_ptr<const MappedFile> mapping_;
+    size_t cell_count_ = 0;
+    size_t mask_ = 0;
+    uint32_t shift_ = 64;
+};
+
+}
@@ -0,0 +1,82 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include "spatial_hash/SpatialHash3D.h"
+#include "spatial_hash/Containers.h"
+#include <limits>
+
+namespace libs::spatial_hash {
+
+/// @brief 3D spatial hash table with limited priority queue container, e.g. best K keypoints per voxel by score.
+/// Every voxel keeps "limit" references with the largest keys.
+/// @tparam DataType - 3D spase data type (float, double)
+/// @tparam KeyT - reference key (score) type
+/// @tparam RefType - associated data type
+/// @tparam MapBackend - hash table backend (StdHashMapBackend, FlatHashMapBackend)
+/// @tparam CountersType - hot path counters policy (NullCounters, AtomicCounters)
+template<typename DataType, typename KeyT, typename RefType, typename MapBackend = StdHashMapBackend, typename CountersType = NullCounters>
+class SpatialHashTable3DHeap : public SpatialHashTable3D<DataType, RefType, ContainerTopK<KeyT, RefType>, MapBackend, CountersType> {
+public:
+    using CellType = ContainerTopK<KeyT, RefType>;
+    using BaseClass = SpatialHashTable3D<DataType, RefType, ContainerTopK<KeyT, RefType>, MapBackend, CountersType>;
+    using HashTableType = typename BaseClass::HashTableType;
+public:
+    SpatialHashTable3DHeap() : BaseClass() {}
+    SpatialHashTable3DHeap(DataType voxel_size, size_t limit) : BaseClass(voxel_size), limit_(limit) {}
+
+    /// @brief Add value to hash table
+    /// @param point - continuous 3D space point
+    /// @param key - reference key, voxels keep references with the largest keys
+    /// @param ref - associated data
+    void Add(const DataType point[3], KeyT key, RefType ref) {
+        BaseClass::AddToVoxel(BaseClass::GetVoxelIndex(point), key, ref, limit_);
+    }
+
+    /// @brief Returns references of specific voxel in ascending key order
+    /// @param index - voxel index
+    /// @return voxel references
+    std::vector<RefType> GetVoxelData(HashIndex3D index) const {
+        std::vector<RefType> result;
+        auto voxel = BaseClass::GetVoxel(index);
+        if (voxel) {
+            for(const auto& itr : *voxel) {
+                result.push_back(itr.second);
+            }
+        }
+        return result;
+    }
+
+    /// @brief Returns references of all voxels
+    std::vector<RefType> GetAllData() const {
+        std::vector<RefType> result;
+        for(const auto& voxel : BaseClass::table_) {
+            for(const auto& itr : voxel.second) {
+                result.push_back(itr.second);
+            }
+        }
+        return result;
+    }
+
+    /// @brief Visit all references in specified cube. Cube parameters in R3 space.
+    /// @param center - central point
+    /// @param half_size - half cube size in R3
+    /// @param visitor - callable with (const KeyT& key, const RefType& ref) arguments
+    template<typename Visitor>
+    void ForEachInCube(const DataType center[3], DataType half_size, Visitor&& visitor) const {
+        HashIndex3D center_index = BaseClass::GetVoxelIndex(center);
+        int32_t half_size_i = half_size * BaseClass::GetInvVoxelSize();
+        BaseClass::ForEachVoxelInCube(center_index, half_size_i, [&visitor](const HashIndex3D&, const CellType& voxel) {
+            for(const auto& itr : voxel) {
+                visitor(itr.first, itr.second);
+            }
+        });
+    }
+
+private:
+    size_t limit_ = std::numeric_limits<size_t>::max();
+};
+
+}
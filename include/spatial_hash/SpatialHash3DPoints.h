@@ -0,0 +1,331 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include "spatial_hash/SpatialHash3D.h"
+#include "spatial_hash/Containers.h"
+#include "spatial_hash/KNearest.h"
+#include "spatial_hash/RadiusFilter.h"
+#include "spatial_hash/Parallel.h"
+#include <utility>
+
+namespace libs::spatial_hash {
+
+/// @brief 3D spatial hash table that stores point coordinates next to references.
+/// Coordinates are kept per voxel in structure of arrays layout, so radius search doesn't need the source point cloud.
+/// @tparam DataType - 3D spase data type (float, double)
+/// @tparam RefType - associated data type
+/// @tparam MapBackend - hash table backend (StdHashMapBackend, FlatHashMapBackend)
+/// @tparam CountersType - hot path counters policy (NullCounters, AtomicCounters)
+template<typename DataType, typename RefType, typename MapBackend = StdHashMapBackend, typename CountersType = NullCounters>
+class SpatialHashTable3DPoints : public SpatialHashTable3D<DataType, RefType, ContainerPoints3D<DataType, RefType>, MapBackend, CountersType> {
+public:
+    using CellType = ContainerPoints3D<DataType, RefType>;
+    using BaseClass = SpatialHashTable3D<DataType, RefType, ContainerPoints3D<DataType, RefType>, MapBackend, CountersType>;
+    using HashTableType = typename BaseClass::HashTableType;
+public:
+    SpatialHashTable3DPoints() : BaseClass() {}
+    SpatialHashTable3DPoints(DataType voxel_size) : BaseClass(voxel_size) {}
+
+    /// @brief Add point to hash table
+    /// @param point - continuous 3D space point
+    /// @param ref - associated data
+    void Add(const DataType point[3], RefType ref) {
+        HashIndex3D voxel_index = BaseClass::GetVoxelIndex(point);
+        BaseClass::AddToVoxel(voxel_index, point, ref);
+    }
+
+    /// @brief Move point to new position. Coordinates are updated in place if the voxel index doesn't change.
+    /// @param old_point - continuous 3D space point the value was added with
+    /// @param new_point - new continuous 3D space point
+    /// @param ref - associated data
+    /// @return true if value was found
+    bool Move(const DataType old_point[3], const DataType new_point[3], const RefType& ref) {
+        HashIndex3D old_index = BaseClass::GetVoxelIndex(old_point);
+        HashIndex3D new_index = BaseClass::GetVoxelIndex(new_point);
+        if (old_index == new_index) {
+            auto itr = BaseClass::table_.find(old_index);
+            if (BaseClass::table_.end() == itr) {
+                return false;
+            }
+
+            CellType& cell = itr->second;
+            size_t i = cell.Find(ref);
+            if (i == cell.size()) {
+                return false;
+            }
+            cell.x_[i] = new_point[0];
+            cell.y_[i] = new_point[1];
+            cell.z_[i] = new_point[2];
+            return true;
+        }
+
+        if (!BaseClass::RemoveFromVoxel(old_index, ref)) {
+            return false;
+        }
+        BaseClass::AddToVoxel(new_index, new_point, ref);
+        return true;
+    }
+
+    /// @brief Returns data for specific voxel index
+    /// @param index - voxel index
+    /// @return voxel references
+    std::vector<RefType> GetVoxelData(HashIndex3D index) const {
+        std::vector<RefType> result;
+        auto cell = BaseClass::GetVoxel(index);
+        if (cell) {
+            result.insert(result.end(), cell->begin(), cell->end());
+        }
+
+        return result;
+    }
+
+    /// @brief Append all data references in specified cube to caller owned buffer. Cube parameters in R3 space.
+    /// @param center - central point
+    /// @param half_size - half cube size in R3
+    /// @param result - output buffer, references are appended
+    void CubeSearch(const DataType center[3], DataType half_size, std::vector<RefType>& result) const {
+        HashIndex3D center_index = BaseClass::GetVoxelIndex(center);
+        uint32_t half_size_i = half_size * BaseClass::GetInvVoxelSize();
+        BaseClass::ForEachVoxelInCube(center_index, half_size_i, [&result](const HashIndex3D&, const CellType& cell) {
+            result.insert(result.end(), cell.begin(), cell.end());
+        });
+    }
+
+    /// @brief Search all data references in specified cube. Cube parameters in R3 space.
+    /// @param center - central point
+    /// @param half_size - half cube size in R3
+    /// @return all data references in cube
+    std::vector<RefType> CubeSearch(const DataType center[3], DataType half_size) const {
+        std::vector<RefType> result;
+        CubeSearch(center, half_size, result);
+        return result;
+    }
+
+    /// @brief Visit all points strictly inside the sphere.
+    /// @param center - sphere center
+    /// @param radius - sphere radius
+    /// @param visitor - callable with (const RefType& ref, const DataType point[3]) arguments
+    template<typename Visitor>
+    void ForEachInRadius(const DataType center[3], DataType radius, Visitor&& visitor) const {
+        const DataType radius_sqr = radius * radius;
+        BaseClass::ForEachVoxelInSphere(center, radius, [&](const HashIndex3D&, const CellType& cell) {
+            detail::RadiusFilter(cell.x_.data(), cell.y_.data(), cell.z_.data(), cell.size(), center, radius_sqr,
+                [&cell, &visitor](size_t i) {
+                    const DataType point[3] = {cell.x_[i], cell.y_[i], cell.z_[i]};
+                    visitor(cell.refs_[i], point);
+                });
+        });
+    }
+
+    /// @brief Append references of all points strictly inside the sphere to caller owned buffer.
+    /// @param center - sphere center
+    /// @param radius - sphere radius
+    /// @param result - output buffer, references are appended
+    void RadiusSearch(const DataType center[3], DataType radius, std::vector<RefType>& result) const {
+        const DataType radius_sqr = radius * radius;
+        BaseClass::ForEachVoxelInSphere(center, radius, [&](const HashIndex3D&, const CellType& cell) {
+            detail::RadiusFilter(cell.x_.data(), cell.y_.data(), cell.z_.data(), cell.size(), center, radius_sqr,
+                [&cell, &result](size_t i) {
+                    result.push_back(cell.refs_[i]);
+                });
+        });
+    }
+
+    /// @brief Search references of all points strictly inside the sphere.
+    /// @param center - sphere center
+    /// @param radius - sphere radius
+    /// @return all data references in sphere
+    std::vector<RefType> RadiusSearch(const DataType center[3], DataType radius) const {
+        std::vector<RefType> result;
+        RadiusSearch(center, radius, result);
+        return result;
+    }
+
+    /// @brief Visit all points inside the convex region (frustum, oriented box, convex polytope).
+    /// Points of voxels completely inside the region are taken without tests, only boundary voxels are tested per point.
+    /// @param region - convex region
+    /// @param visitor - callable with (const RefType& ref, const DataType point[3]) arguments
+    template<typename Visitor>
+    void ForEachInRegion(const ConvexRegion<DataType, 3>& region, Visitor&& visitor) const {
+        BaseClass::ForEachVoxelInRegion(region, [&](const HashIndex3D&, const CellType& cell, bool is_inside) {
+            for(size_t i = 0; i < cell.size(); ++i) {
+                const DataType point[3] = {cell.x_[i], cell.y_[i], cell.z_[i]};
+                if (is_inside || region.IsInside(point)) {
+                    visitor(cell.refs_[i], point);
+                }
+            }
+        });
+    }
+
+    /// @brief Append references of all points inside the convex region to caller owned buffer.
+    /// @param region - convex region
+    /// @param result - output buffer, references are appended
+    void RegionSearch(const ConvexRegion<DataType, 3>& region, std::vector<RefType>& result) const {
+        BaseClass::ForEachVoxelInRegion(region, [&](const HashIndex3D&, const CellType& cell, bool is_inside) {
+            if (is_inside) {
+                result.insert(result.end(), cell.refs_.begin(), cell.refs_.end());
+                return;
+            }
+            for(size_t i = 0; i < cell.size(); ++i) {
+                const DataType point[3] = {cell.x_[i], cell.y_[i], cell.z_[i]};
+                if (region.IsInside(point)) {
+                    result.push_back(cell.refs_[i]);
+                }
+            }
+        });
+    }
+
+    /// @brief Search references of all points inside the convex region.
+    /// @param region - convex region
+    /// @return all data references in the region
+    std::vector<RefType> RegionSearch(const ConvexRegion<DataType, 3>& region) const {
+        std::vector<RefType> result;
+        RegionSearch(region, result);
+        return result;
+    }
+
+    /// @brief Search k nearest neighbours of the point. Voxels are visited shell by shell outward from the point voxel 
+    /// until the next shell can't contain closer points.
+    /// @param point - continuous 3D space point
+    /// @param k - number of neighbours
+    /// @param refs - output references sorted by distance, nearest first, overwritten
+    /// @param sqr_distances - output squared distances, overwritten
+    void KNearest(const DataType point[3], size_t k, std::vector<RefType>& refs, std::vector<DataType>& sqr_distances) const {
+        if (0 == k) {
+            refs.clear();
+            sqr_distances.clear();
+            return;
+        }
+        KNearestHeap<DataType, RefType> heap(k);
+        BaseClass::ForEachVoxelInShells(point, 
+            [&](const HashIndex3D&, const CellType& cell) {
+                for(size_t i = 0; i < cell.size(); ++i) {
+                    DataType dx = cell.x_[i] - point[0];
+                    DataType dy = cell.y_[i] - point[1];
+                    DataType dz = cell.z_[i] - point[2];
+                    heap.Push(dx * dx + dy * dy + dz * dz, cell.refs_[i]);
+                }
+            }, 
+            [&heap](DataType min_distance) {
+                return heap.Full() && min_distance * min_distance >= heap.WorstSqrDistance();
+            });
+        heap.Extract(refs, sqr_distances);
+    }
+
+    /// @brief Search k nearest neighbours of the point.
+    /// @param point - continuous 3D space point
+    /// @param k - number of neighbours
+    /// @return references sorted by distance, nearest first
+    std::vector<RefType> KNearest(const DataType point[3], size_t k) const {
+        std::vector<RefType> refs;
+        std::vector<DataType> sqr_distances;
+        KNearest(point, k, refs, sqr_distances);
+        return refs;
+    }
+
+    /// @brief Visit every pair of points closer than radius once, self pairs are not visited.
+    /// Every voxel is paired with itself and with the forward half of its neighbour stencil only.
+    /// @param radius - pair distance limit
+    /// @param visitor - callable with (const RefType& ref_a, const RefType& ref_b) arguments
+    template<typename Visitor>
+    void ForEachPairInRadius(DataType radius, Visitor&& visitor) const {
+        const std::vector<HashIndex3D> stencil = HalfStencil(radius);
+        const DataType radius_sqr = radius * radius;
+        for(const auto& voxel : BaseClass::table_) {
+            ForEachPairInVoxel(voxel.first, voxel.second, stencil, radius_sqr, visitor);
+        }
+    }
+
+    /// @brief Append every pair of points closer than radius to caller owned buffer, each pair once.
+    /// Voxels are split between threads, pairs are gathered in the same order as ForEachPairInRadius visits them.
+    /// @param radius - pair distance limit
+    /// @param result - output buffer, pairs are appended
+    /// @param num_threads - number of threads, 0 - hardware concurrency
+    void RadiusPairs(DataType radius, std::vector<std::pair<RefType, RefType>>& result, size_t num_threads = 1) const {
+        const std::vector<HashIndex3D> stencil = HalfStencil(radius);
+        const DataType radius_sqr = radius * radius;
+
+        std::vector<std::pair<HashIndex3D, const CellType*>> voxels;
+        voxels.reserve(BaseClass::table_.size());
+        for(const auto& voxel : BaseClass::table_) {
+            voxels.emplace_back(voxel.first, &voxel.second);
+        }
+
+        num_threads = GetThreadCount(num_threads, voxels.size(), 256);
+        std::vector<std::vector<std::pair<RefType, RefType>>> buffers(num_threads - 1);
+        ParallelFor(voxels.size(), num_threads, [&](size_t thread_idx, size_t begin, size_t end) {
+            auto& buffer = 0 == thread_idx ? result : buffers[thread_idx - 1];
+            auto visitor = [&buffer](const RefType& ref_a, const RefType& ref_b) { buffer.emplace_back(ref_a, ref_b); };
+            for(size_t i = begin; i < end; ++i) {
+                ForEachPairInVoxel(voxels[i].first, *voxels[i].second, stencil, radius_sqr, visitor);
+            }
+        });
+
+        for(const auto& buffer : buffers) {
+            result.insert(result.end(), buffer.begin(), buffer.end());
+        }
+    }
+
+    /// @brief Search every pair of points closer than radius, each pair once.
+    /// @param radius - pair distance limit
+    /// @param num_threads - number of threads, 0 - hardware concurrency
+    /// @return point reference pairs
+    std::vector<std::pair<RefType, RefType>> RadiusPairs(DataType radius, size_t num_threads = 1) const {
+        std::vector<std::pair<RefType, RefType>> result;
+        RadiusPairs(radius, result, num_threads);
+        return result;
+    }
+
+private:
+    /// @brief Neighbour voxel offsets lexicographically greater than zero, offsets whose voxels are 
+    /// separated from the central voxel by at least radius are skipped.
+    std::vector<HashIndex3D> HalfStencil(DataType radius) const {
+        const DataType radius_v = radius * BaseClass::GetInvVoxelSize();
+        const int32_t half_size = static_cast<int32_t>(std::ceil(radius_v));
+        auto gap = [](int32_t d) { return static_cast<DataType>(std::max(std::abs(d) - 1, 0)); };
+
+        std::vector<HashIndex3D> result;
+        for(int32_t x = -half_size; x <= half_size; ++x) {
+            for(int32_t y = -half_size; y <= half_size; ++y) {
+                for(int32_t z = -half_size; z <= half_size; ++z) {
+                    if (x < 0 || (0 == x && (y < 0 || (0 == y && z <= 0)))) {
+                        continue;
+                    }
+                    if (gap(x) * gap(x) + gap(y) * gap(y) + gap(z) * gap(z) >= radius_v * radius_v) {
+                        continue;
+                    }
+                    result.emplace_back(x, y, z);
+                }
+            }
+        }
+        return result;
+    }
+
+    /// @brief Visit pairs of the voxel points and pairs with points of the stencil voxels
+    template<typename Visitor>
+    void ForEachPairInVoxel(const HashIndex3D& index, const CellType& cell, const std::vector<HashIndex3D>& stencil, 
+        DataType radius_sqr, Visitor& visitor) const {
+        for(size_t i = 0; i + 1 < cell.size(); ++i) {
+            const DataType point[3] = {cell.x_[i], cell.y_[i], cell.z_[i]};
+            detail::RadiusFilter(cell.x_.data() + i + 1, cell.y_.data() + i + 1, cell.z_.data() + i + 1, cell.size() - i - 1, 
+                point, radius_sqr, [&](size_t j) { visitor(cell.refs_[i], cell.refs_[i + 1 + j]); });
+        }
+
+        for(const HashIndex3D& offset : stencil) {
+            const CellType* other = BaseClass::GetVoxel(index + offset);
+            if (nullptr == other) {
+                continue;
+            }
+            for(size_t i = 0; i < cell.size(); ++i) {
+                const DataType point[3] = {cell.x_[i], cell.y_[i], cell.z_[i]};
+                detail::RadiusFilter(other->x_.data(), other->y_.data(), other->z_.data(), other->size(), 
+                    point, radius_sqr, [&](size_t j) { visitor(cell.refs_[i], other->refs_[j]); });
+            }
+        }
+    }
+};
+
+}
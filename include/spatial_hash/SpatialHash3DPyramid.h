@@ -0,0 +1,491 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include "spatial_hash/SpatialHash3DVector.h"
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cassert>
+
+namespace libs::spatial_hash {
+
+/// @brief Multi-resolution 3D spatial hash table. Level 0 is the vector table of the base voxel size, level l keeps
+/// number of references per voxel of 2^l base voxels size, so voxel index of level l is level 0 index shifted by l bits
+/// and levels nest exactly. Levels are updated on every insert and remove.
+/// Hierarchical queries start at the level where the query spans a few voxels and descend to populated 2 x 2 x 2 children
+/// only, coarse voxels keep children occupancy, so empty blocks are not probed and blocks inside of the query are not tested,
+/// so the cost depends on populated voxels near the query surface rather than on the query volume in base voxels.
+/// Level 0 search API is the same as for SpatialHashTable3DVector.
+/// @tparam DataType - 3D spase data type (float, double)
+/// @tparam RefType - associated data type
+/// @tparam MapBackend - hash table backend (StdHashMapBackend, FlatHashMapBackend)
+/// @tparam CountersType - hot path counters policy (NullCounters, AtomicCounters)
+template<typename DataType, typename RefType, typename MapBackend = StdHashMapBackend, typename CountersType = NullCounters>
+class SpatialHashTable3DPyramid : public SpatialHashTable3DVector<DataType, RefType, MapBackend, CountersType> {
+public:
+    using CellType = ContainerVector<RefType>;
+    using BaseClass = SpatialHashTable3DVector<DataType, RefType, MapBackend, CountersType>;
+    using HashTableType = typename BaseClass::HashTableType;
+    /// @brief Coarse level voxel
+    struct LevelVoxel {
+        /// @brief Number of references in the voxel
+        size_t count_ = 0;
+        /// @brief Bit mask of populated 2 x 2 x 2 children, bit x + 2 * y + 4 * z
+        uint8_t children_ = 0;
+    };
+    using LevelTableType = typename MapBackend::template Map<HashIndex3D, LevelVoxel, SpatalHash3D>;
+public:
+    /// @brief Default number of levels, the top level voxel spans 1024 base voxels, so queries up to three orders 
+    /// of magnitude larger than the base voxel start at a few coarse voxels
+    static constexpr size_t kDefaultLevelCount = 11;
+
+    SpatialHashTable3DPyramid() : BaseClass(), levels_(kDefaultLevelCount - 1) {}
+
+    /// @param voxel_size - level 0 voxel size
+    /// @param levels - number of levels, level l voxel size is voxel_size * 2^l
+    SpatialHashTable3DPyramid(DataType voxel_size, size_t levels = kDefaultLevelCount) : BaseClass(voxel_size),
+        levels_(std::max<size_t>(levels, 1) - 1) {}
+
+    /// @brief Sets level 0 voxel size.
+    /// @param voxel_size - voxel size
+    void SetVoxelSize(DataType voxel_size) {
+        BaseClass::SetVoxelSize(voxel_size);
+        ClearLevels();
+    }
+
+    /// @brief Sets level 0 voxel size, hides the base table method that would keep the coarse levels.
+    /// @param cell_size - voxel size
+    void SetCellSize(DataType cell_size) {
+        SetVoxelSize(cell_size);
+    }
+
+    /// @brief Clear all levels
+    void Clear() {
+        BaseClass::Clear();
+        ClearLevels();
+    }
+
+    /// @brief Returns number of levels including level 0
+    size_t GetLevelCount() const {
+        return levels_.size() + 1;
+    }
+
+    /// @brief Returns voxels of the coarse level, level 0 voxels are returned by GetTable()
+    /// @param level - level in [1, GetLevelCount())
+    const LevelTableType& GetLevelTable(size_t level) const {
+        assert(0 < level && level < GetLevelCount());
+        return levels_[level - 1];
+    }
+
+    /// @brief Add value to hash table
+    /// @param point - continuous 3D space point
+    /// @param ref - associated data
+    void Add(const DataType point[3], RefType ref) {
+        const HashIndex3D index = BaseClass::GetVoxelIndex(point);
+        BaseClass::AddToVoxel(index, ref);
+        AddToLevels(index, 1);
+    }
+
+    /// @brief Build the table from point array, point index is used as reference. Previous content is replaced.
+    /// @param points - array of "count" 3D points (x, y, z)
+    /// @param count - number of points
+    /// @param num_threads - number of threads, 0 - hardware concurrency
+    void Build(const DataType* points, size_t count, size_t num_threads = 1) {
+        BaseClass::Build(points, count, num_threads);
+        BuildLevels();
+    }
+
+    /// @brief Build the table from point and reference arrays. Previous content is replaced.
+    /// @param points - array of "count" 3D points (x, y, z)
+    /// @param refs - array of "count" references
+    /// @param count - number of points
+    /// @param num_threads - number of threads, 0 - hardware concurrency
+    void Build(const DataType* points, const RefType* refs, size_t count, size_t num_threads = 1) {
+        BaseClass::Build(points, refs, count, num_threads);
+        BuildLevels();
+    }
+
+    /// @brief Remove value from hash table. Voxels of all levels are removed when they become empty.
+    /// @param point - continuous 3D space point the value was added with
+    /// @param ref - associated data
+    /// @return true if value was found
+    bool Remove(const DataType point[3], const RefType& ref) {
+        const HashIndex3D index = BaseClass::GetVoxelIndex(point);
+        if (!BaseClass::RemoveFromVoxel(index, ref)) {
+            return false;
+        }
+        RemoveFromLevels(index, BaseClass::table_.end() == BaseClass::table_.find(index));
+        return true;
+    }
+
+    /// @brief Move value to new position. Nothing is done if the voxel index doesn't change.
+    /// @param old_point - continuous 3D space point the value was added with
+    /// @param new_point - new continuous 3D space point
+    /// @param ref - associated data
+    /// @return true if value was found or voxel index didn't change
+    bool Move(const DataType old_point[3], const DataType new_point[3], const RefType& ref) {
+        if (BaseClass::GetVoxelIndex(old_point) == BaseClass::GetVoxelIndex(new_point)) {
+            return true;
+        }
+        if (!Remove(old_point, ref)) {
+            return false;
+        }
+        Add(new_point, ref);
+        return true;
+    }
+
+    /// @brief Visit data references of all level 0 voxels intersecting the sphere, the same references as
+    /// SpatialHashTable3DVector::SphereSearch. Voxels are found by descent from the coarse level.
+    /// @param center - sphere center
+    /// @param radius - sphere radius
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInSphereHierarchical(const DataType center[3], DataType radius, Visitor&& visitor) const {
+        TraverseSphere(center, radius, true,
+            [&visitor](const CellType& cell) {
+                for(const RefType& ref : cell) {
+                    visitor(ref);
+                }
+            },
+            [](size_t) { return false; });
+    }
+
+    /// @brief Append data references of all level 0 voxels intersecting the sphere to caller owned buffer.
+    /// @param center - sphere center
+    /// @param radius - sphere radius
+    /// @param result - output buffer, references are appended
+    void SphereSearchHierarchical(const DataType center[3], DataType radius, std::vector<RefType>& result) const {
+        TraverseSphere(center, radius, true,
+            [&result](const CellType& cell) { result.insert(result.end(), cell.begin(), cell.end()); },
+            [](size_t) { return false; });
+    }
+
+    /// @brief Search data references of all level 0 voxels intersecting the sphere.
+    /// @param center - sphere center
+    /// @param radius - sphere radius
+    /// @return data references of the voxels
+    std::vector<RefType> SphereSearchHierarchical(const DataType center[3], DataType radius) const {
+        std::vector<RefType> result;
+        SphereSearchHierarchical(center, radius, result);
+        return result;
+    }
+
+    /// @brief Number of references of level 0 voxels intersecting the sphere. Counts of coarse voxels inside
+    /// the sphere are taken without descent, so the cost depends on the sphere surface only.
+    /// @param center - sphere center
+    /// @param radius - sphere radius
+    /// @return number of references
+    size_t CountInSphere(const DataType center[3], DataType radius) const {
+        size_t result = 0;
+        TraverseSphere(center, radius, false,
+            [&result](const CellType& cell) { result += cell.size(); },
+            [&result](size_t count) {
+                result += count;
+                return true;
+            });
+        return result;
+    }
+
+    /// @brief Visit data references of all level 0 voxels in the box, the same references as
+    /// SpatialHashTable3DVector::ForEachInCube with diagonal points. Voxels are found by descent from the coarse level.
+    /// @param corner_min - min corner point
+    /// @param corner_max - max corner point
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInBoxHierarchical(const DataType corner_min[3], const DataType corner_max[3], Visitor&& visitor) const {
+        HashIndex3D index_min = BaseClass::GetVoxelIndex(corner_min);
+        HashIndex3D index_max = BaseClass::GetVoxelIndex(corner_max);
+        for(size_t i = 0; i < 3; ++i) {
+            if (index_max[i] < index_min[i]) {
+                std::swap(index_min[i], index_max[i]);
+            }
+        }
+        BoxClassifier classifier{index_min, index_max};
+        Traverse(index_min, index_max, classifier, true,
+            [&visitor](const CellType& cell) {
+                for(const RefType& ref : cell) {
+                    visitor(ref);
+                }
+            },
+            [](size_t) { return false; });
+    }
+
+    /// @brief Returns occupancy statistics of level 0, coarse levels are counted in memory
+    /// @param histogram_size - number of cell size histogram bins
+    /// @return table statistics
+    TableStatistics GetStatistics(size_t histogram_size = 16) const {
+        TableStatistics result = BaseClass::GetStatistics(histogram_size);
+        for(const LevelTableType& level : levels_) {
+            result.memory_bytes_ += MapBackend::MemoryUsage(level);
+        }
+        return result;
+    }
+
+private:
+    enum BlockClass {
+        kOutside,
+        kBoundary,
+        kInside,
+    };
+
+    /// @brief Classifies voxels of any level against the sphere
+    struct SphereClassifier {
+        const DataType* center_;
+        DataType radius_sqr_;
+        DataType voxel_size_;
+
+        BlockClass operator() (size_t level, const HashIndex3D& index) const {
+            const DataType size = voxel_size_ * static_cast<DataType>(int64_t(1) << level);
+            DataType min_distance = 0;
+            DataType max_distance = 0;
+            for(size_t i = 0; i < 3; ++i) {
+                const DataType low = index[i] * size - center_[i];
+                const DataType high = low + size;
+                const DataType nearest = std::max(std::max(low, -high), DataType(0));
+                const DataType farthest = std::max(-low, high);
+                min_distance += nearest * nearest;
+                max_distance += farthest * farthest;
+            }
+            if (min_distance > radius_sqr_) {
+                return kOutside;
+            }
+            return max_distance <= radius_sqr_ ? kInside : kBoundary;
+        }
+    };
+
+    /// @brief Classifies voxels of any level against the box of level 0 voxels
+    struct BoxClassifier {
+        HashIndex3D min_;
+        HashIndex3D max_;
+
+        BlockClass operator() (size_t level, const HashIndex3D& index) const {
+            bool is_inside = true;
+            for(size_t i = 0; i < 3; ++i) {
+                const int64_t low = int64_t(index[i]) * (int64_t(1) << level);
+                const int64_t high = low + (int64_t(1) << level) - 1;
+                if (high < min_[i] || max_[i] < low) {
+                    return kOutside;
+                }
+                is_inside = is_inside && min_[i] <= low && high <= max_[i];
+            }
+            return is_inside ? kInside : kBoundary;
+        }
+    };
+
+    template<typename CellVisitor, typename BlockVisitor>
+    void TraverseSphere(const DataType center[3], DataType radius, bool scan_large, CellVisitor&& cell_visitor,
+        BlockVisitor&& block_visitor) const {
+        if (radius < 0) {
+            BaseClass::counters_.OnQuery();
+            return;
+        }
+        SphereClassifier classifier{center, radius * radius, BaseClass::GetVoxelSize()};
+        const DataType corner_min[3] = {center[0] - radius, center[1] - radius, center[2] - radius};
+        const DataType corner_max[3] = {center[0] + radius, center[1] + radius, center[2] + radius};
+        Traverse(BaseClass::GetVoxelIndex(corner_min), BaseClass::GetVoxelIndex(corner_max), classifier, scan_large,
+            cell_visitor, block_visitor);
+    }
+
+    /// @brief Visit populated level 0 voxels of the query with bounding box of level 0 voxels [corner_min, corner_max].
+    /// The start level is the finest one where the box spans at most kStartSpan voxels per axis, larger boxes
+    /// at the top level are handled by iteration over the top level voxels.
+    /// @param classifier - callable with (size_t level, const HashIndex3D& index) arguments, returns BlockClass
+    /// @param scan_large - iterate level 0 voxels if the box has more level 0 voxels than the table as the vector table does,
+    /// false if block_visitor handles inside voxels without descent
+    /// @param cell_visitor - callable with (const CellType& cell) argument, called for level 0 voxels
+    /// @param block_visitor - callable with (size_t count) argument, called for coarse voxels inside of the query,
+    /// returns true to skip descent into the voxel
+    template<typename Classifier, typename CellVisitor, typename BlockVisitor>
+    void Traverse(const HashIndex3D& corner_min, const HashIndex3D& corner_max, const Classifier& classifier, bool scan_large,
+        CellVisitor&& cell_visitor, BlockVisitor&& block_visitor) const {
+        constexpr int32_t kStartSpan = 4;
+        // descent probes populated voxels only, so the scan is taken for boxes much larger than the table
+        constexpr double kScanRatio = 8;
+        BaseClass::counters_.OnQuery();
+
+        double volume = 1.0;
+        for(size_t i = 0; i < 3; ++i) {
+            volume *= double(corner_max[i]) - corner_min[i] + 1;
+        }
+        if (scan_large && volume > kScanRatio * BaseClass::table_.size()) {
+            size_t hits = 0;
+            size_t candidates = 0;
+            for(const auto& voxel : BaseClass::table_) {
+                if (kOutside != classifier(0, voxel.first)) {
+                    ++hits;
+                    candidates += voxel.second.size();
+                    cell_visitor(voxel.second);
+                }
+            }
+            BaseClass::counters_.OnProbes(BaseClass::table_.size(), hits, candidates);
+            return;
+        }
+
+        size_t level = 0;
+        while (level < levels_.size()) {
+            bool is_small = true;
+            for(size_t i = 0; i < 3; ++i) {
+                is_small = is_small && (corner_max[i] >> level) - (corner_min[i] >> level) < kStartSpan;
+            }
+            if (is_small) {
+                break;
+            }
+            ++level;
+        }
+
+        TraverseStats stats;
+        auto visit_start = [&](const HashIndex3D& index, const LevelVoxel* voxel, const CellType* cell) {
+            const BlockClass block_class = classifier(level, index);
+            if (kOutside == block_class) {
+                return;
+            }
+            if (cell) {
+                ++stats.hits_;
+                stats.candidates_ += cell->size();
+                cell_visitor(*cell);
+                return;
+            }
+            if (kInside == block_class && block_visitor(voxel->count_)) {
+                return;
+            }
+            Descend(level, index, voxel->children_, kInside == block_class, classifier, cell_visitor, block_visitor, stats);
+        };
+
+        double box_volume = 1.0;
+        for(size_t i = 0; i < 3; ++i) {
+            box_volume *= double(corner_max[i] >> level) - (corner_min[i] >> level) + 1;
+        }
+        const size_t level_size = 0 == level ? BaseClass::table_.size() : levels_[level - 1].size();
+        if (box_volume > level_size) {
+            // the box has more voxels than the level, populated voxels are iterated
+            stats.probes_ += level_size;
+            if (0 == level) {
+                for(const auto& voxel : BaseClass::table_) {
+                    visit_start(voxel.first, nullptr, &voxel.second);
+                }
+            } else {
+                for(const auto& voxel : levels_[level - 1]) {
+                    visit_start(voxel.first, &voxel.second, nullptr);
+                }
+            }
+        } else {
+            HashIndex3D index;
+            for(index.x_ = corner_min.x_ >> level; index.x_ <= corner_max.x_ >> level; ++index.x_) {
+                for(index.y_ = corner_min.y_ >> level; index.y_ <= corner_max.y_ >> level; ++index.y_) {
+                    for(index.z_ = corner_min.z_ >> level; index.z_ <= corner_max.z_ >> level; ++index.z_) {
+                        ++stats.probes_;
+                        if (0 == level) {
+                            auto itr = BaseClass::table_.find(index);
+                            if (BaseClass::table_.end() != itr) {
+                                visit_start(index, nullptr, &itr->second);
+                            }
+                        } else {
+                            auto itr = levels_[level - 1].find(index);
+                            if (levels_[level - 1].end() != itr) {
+                                visit_start(index, &itr->second, nullptr);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        BaseClass::counters_.OnProbes(stats.probes_, stats.hits_, stats.candidates_);
+    }
+
+    struct TraverseStats {
+        size_t probes_ = 0;
+        size_t hits_ = 0;
+        size_t candidates_ = 0;
+    };
+
+    /// @brief Visit populated children of the coarse voxel, children outside of the query are skipped
+    /// @param children - children occupancy mask of the voxel
+    /// @param is_inside - the voxel is inside of the query, children are not classified
+    template<typename Classifier, typename CellVisitor, typename BlockVisitor>
+    void Descend(size_t level, const HashIndex3D& index, uint8_t children, bool is_inside, const Classifier& classifier,
+        CellVisitor& cell_visitor, BlockVisitor& block_visitor, TraverseStats& stats) const {
+        const size_t child_level = level - 1;
+        for(int32_t child_idx = 0; child_idx < 8; ++child_idx) {
+            if (0 == (children & (1 << child_idx))) {
+                continue;
+            }
+            const HashIndex3D child(2 * index.x_ + (child_idx & 1), 2 * index.y_ + ((child_idx >> 1) & 1),
+                2 * index.z_ + (child_idx >> 2));
+            BlockClass block_class = kInside;
+            if (!is_inside) {
+                block_class = classifier(child_level, child);
+                if (kOutside == block_class) {
+                    continue;
+                }
+            }
+
+            ++stats.probes_;
+            if (0 == child_level) {
+                const CellType& cell = BaseClass::table_.find(child)->second;
+                ++stats.hits_;
+                stats.candidates_ += cell.size();
+                cell_visitor(cell);
+                continue;
+            }
+
+            const LevelVoxel& voxel = levels_[child_level - 1].find(child)->second;
+            if (kInside == block_class && block_visitor(voxel.count_)) {
+                continue;
+            }
+            Descend(child_level, child, voxel.children_, kInside == block_class, classifier, cell_visitor, block_visitor, stats);
+        }
+    }
+
+    /// @brief Child bit of the voxel in its parent
+    static uint8_t ChildBit(const HashIndex3D& index) {
+        return static_cast<uint8_t>(1 << ((index.x_ & 1) | ((index.y_ & 1) << 1) | ((index.z_ & 1) << 2)));
+    }
+
+    void AddToLevels(HashIndex3D index, size_t count) {
+        for(LevelTableType& level : levels_) {
+            const uint8_t child_bit = ChildBit(index);
+            index = HashIndex3D(index.x_ >> 1, index.y_ >> 1, index.z_ >> 1);
+            LevelVoxel& voxel = level[index];
+            voxel.count_ += count;
+            voxel.children_ |= child_bit;
+        }
+    }
+
+    /// @param is_erased - level 0 voxel became empty
+    void RemoveFromLevels(HashIndex3D index, bool is_erased) {
+        for(LevelTableType& level : levels_) {
+            const uint8_t child_bit = ChildBit(index);
+            index = HashIndex3D(index.x_ >> 1, index.y_ >> 1, index.z_ >> 1);
+            auto itr = level.find(index);
+            if (is_erased) {
+                itr->second.children_ &= static_cast<uint8_t>(~child_bit);
+            }
+            is_erased = 0 == --itr->second.count_;
+            if (is_erased) {
+                level.erase(itr);
+            }
+        }
+    }
+
+    void BuildLevels() {
+        ClearLevels();
+        for(const auto& voxel : BaseClass::table_) {
+            AddToLevels(voxel.first, voxel.second.size());
+        }
+    }
+
+    void ClearLevels() {
+        for(LevelTableType& level : levels_) {
+            level.clear();
+        }
+    }
+
+    /// @brief Voxels of levels 1 .. levels - 1
+    std::vector<LevelTableType> levels_;
+};
+
+}
@@ -0,0 +1,194 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include "spatial_hash/SpatialHash3DVector.h"
+#include "spatial_hash/Containers.h"
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+namespace libs::spatial_hash {
+
+/// @brief 3D spatial hash table for rolling local maps, e.g. the last seconds of LiDAR scans.
+/// Every reference carries its insertion epoch (frame number), old epochs are evicted without rebuilding the table.
+/// Voxels written in an epoch are logged in a ring of per epoch logs, so EvictOlderThan visits only voxels
+/// written in the evicted epochs, and every voxel drops a prefix of its references. Log and voxel storage is reused,
+/// with FlatHashMapBackend (default) memory stays bounded by the largest window. Search API is the same as for
+/// SpatialHashTable3DVector, references are added one by one with their epoch, Build and Move are not available.
+/// @tparam DataType - 3D spase data type (float, double)
+/// @tparam RefType - associated data type
+/// @tparam MapBackend - hash table backend (FlatHashMapBackend, StdHashMapBackend)
+/// @tparam CountersType - hot path counters policy (NullCounters, AtomicCounters)
+template<typename DataType, typename RefType, typename MapBackend = FlatHashMapBackend, typename CountersType = NullCounters>
+class SpatialHashTable3DRolling : public SpatialHashTable3DVector<DataType, RefType, MapBackend, CountersType, ContainerEpochVector<RefType>> {
+public:
+    using CellType = ContainerEpochVector<RefType>;
+    using BaseClass = SpatialHashTable3DVector<DataType, RefType, MapBackend, CountersType, ContainerEpochVector<RefType>>;
+    using HashTableType = typename BaseClass::HashTableType;
+public:
+    SpatialHashTable3DRolling() : BaseClass() {}
+    SpatialHashTable3DRolling(DataType voxel_size) : BaseClass(voxel_size) {}
+
+    /// @brief Sets voxel size.
+    /// @param voxel_size - voxel size
+    void SetVoxelSize(DataType voxel_size) {
+        BaseClass::SetVoxelSize(voxel_size);
+        ClearLogs();
+    }
+
+    /// @brief Sets voxel size, hides the base table method that would keep the epoch logs.
+    /// @param cell_size - voxel size
+    void SetCellSize(DataType cell_size) {
+        SetVoxelSize(cell_size);
+    }
+
+    /// @brief Clear the hash table and epoch logs. Log memory is kept for reuse.
+    void Clear() {
+        BaseClass::Clear();
+        ClearLogs();
+    }
+
+    /// @brief Add value to hash table
+    /// @param point - continuous 3D space point
+    /// @param ref - associated data
+    /// @param epoch - insertion epoch, epochs have to be non-decreasing, older ones are stored as the newest epoch
+    void Add(const DataType point[3], RefType ref, uint32_t epoch) {
+        if (0 == log_count_ || Newest().epoch_ < epoch) {
+            PushLog(epoch);
+        }
+        EpochLog& log = Newest();
+        epoch = log.epoch_;
+
+        const HashIndex3D index = BaseClass::GetVoxelIndex(point);
+        auto itr = BaseClass::table_.find(index);
+        if (BaseClass::table_.end() == itr || itr->second.NewestEpoch() != epoch) {
+            log.voxels_.push_back(index);
+        }
+        BaseClass::AddToVoxel(index, ref, epoch);
+    }
+
+    /// @brief Remove references added before the epoch, voxels become free when all their references are removed.
+    /// Cost is proportional to the number of voxels written in the evicted epochs.
+    /// @param epoch - the oldest epoch to keep
+    /// @return number of removed references
+    size_t EvictOlderThan(uint32_t epoch) {
+        size_t result = 0;
+        while (log_count_ > 0 && logs_[head_].epoch_ < epoch) {
+            EpochLog& log = logs_[head_];
+            for(const HashIndex3D& index : log.voxels_) {
+                // voxel is logged in every epoch it was written, later logs find it evicted or erased
+                auto itr = BaseClass::table_.find(index);
+                if (BaseClass::table_.end() == itr) {
+                    continue;
+                }
+                result += itr->second.EvictOlderThan(epoch);
+                if (itr->second.empty()) {
+                    BaseClass::table_.erase(itr);
+                }
+            }
+            log.voxels_.clear();
+            head_ = (head_ + 1) % logs_.size();
+            --log_count_;
+        }
+        return result;
+    }
+
+    /// @brief Remove whole voxels farther than radius from the point, e.g. from the current sensor pose.
+    /// Every populated voxel is checked once, references aren't tested. Epoch logs are released by EvictOlderThan only.
+    /// @param point - continuous 3D space point
+    /// @param radius - distance from the point to the nearest point of voxels to keep
+    /// @return number of removed references
+    size_t EvictFarFrom(const DataType point[3], DataType radius) {
+        const DataType voxel_size = BaseClass::GetVoxelSize();
+        const DataType radius_sqr = radius * radius;
+        evicted_.clear();
+        for(const auto& voxel : BaseClass::table_) {
+            DataType distance = 0;
+            for(size_t i = 0; i < 3; ++i) {
+                const DataType low = voxel.first[i] * voxel_size;
+                const DataType delta = std::max(std::max(low - point[i], point[i] - low - voxel_size), DataType(0));
+                distance += delta * delta;
+            }
+            if (distance > radius_sqr) {
+                evicted_.push_back(voxel.first);
+            }
+        }
+
+        size_t result = 0;
+        for(const HashIndex3D& index : evicted_) {
+            auto itr = BaseClass::table_.find(index);
+            result += itr->second.size();
+            BaseClass::table_.erase(itr);
+        }
+        return result;
+    }
+
+    /// @brief Returns the oldest epoch with logged voxels, 0 for empty table
+    uint32_t GetOldestEpoch() const {
+        return log_count_ > 0 ? logs_[head_].epoch_ : 0;
+    }
+
+    /// @brief Returns the newest added epoch, 0 for empty table
+    uint32_t GetNewestEpoch() const {
+        return log_count_ > 0 ? Newest().epoch_ : 0;
+    }
+
+    /// @brief Returns occupancy statistics of the table, epoch logs are counted in memory
+    /// @param histogram_size - number of cell size histogram bins
+    /// @return table statistics
+    TableStatistics GetStatistics(size_t histogram_size = 16) const {
+        TableStatistics result = BaseClass::GetStatistics(histogram_size);
+        result.memory_bytes_ += logs_.capacity() * sizeof(EpochLog) + evicted_.capacity() * sizeof(HashIndex3D);
+        for(const EpochLog& log : logs_) {
+            result.memory_bytes_ += log.voxels_.capacity() * sizeof(HashIndex3D);
+        }
+        return result;
+    }
+
+private:
+    /// @brief Voxels written in the epoch
+    struct EpochLog {
+        uint32_t epoch_ = 0;
+        std::vector<HashIndex3D> voxels_;
+    };
+
+    EpochLog& Newest() {
+        return logs_[(head_ + log_count_ - 1) % logs_.size()];
+    }
+
+    const EpochLog& Newest() const {
+        return logs_[(head_ + log_count_ - 1) % logs_.size()];
+    }
+
+    /// @brief Append log of a new epoch, the ring grows twice when full, free logs keep their storage
+    void PushLog(uint32_t epoch) {
+        if (log_count_ == logs_.size()) {
+            std::rotate(logs_.begin(), logs_.begin() + head_, logs_.end());
+            head_ = 0;
+            logs_.resize(std::max<size_t>(2 * logs_.size(), 4));
+        }
+        EpochLog& log = logs_[(head_ + log_count_) % logs_.size()];
+        log.epoch_ = epoch;
+        ++log_count_;
+    }
+
+    void ClearLogs() {
+        for(EpochLog& log : logs_) {
+            log.voxels_.clear();
+        }
+        head_ = 0;
+        log_count_ = 0;
+    }
+
+    /// @brief Ring of epoch logs, logs_[head_] is the oldest one
+    std::vector<EpochLog> logs_;
+    size_t head_ = 0;
+    size_t log_count_ = 0;
+    /// @brief Reusable buffer of voxels evicted by distance
+    std::vector<HashIndex3D> evicted_;
+};
+
+}
@@ -0,0 +1,143 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include "spatial_hash/SpatialHash3DVector.h"
+#include "spatial_hash/Containers.h"
+#include <utility>
+
+namespace libs::spatial_hash {
+
+/// @brief 3D spatial hash table with small buffer container. Voxels with up to N references don't allocate,
+/// larger voxels spill to the table arena. With FlatHashMapBackend (default) Clear() doesn't free memory,
+/// hash table slots and arena blocks are reused by the next frame. Search API is the same as for SpatialHashTable3DVector.
+/// @tparam DataType - 3D spase data type (float, double)
+/// @tparam RefType - trivially copyable associated data type
+/// @tparam N - number of inline references per voxel
+/// @tparam MapBackend - hash table backend (FlatHashMapBackend, StdHashMapBackend)
+/// @tparam CountersType - hot path counters policy (NullCounters, AtomicCounters)
+template<typename DataType, typename RefType, uint32_t N = 4, typename MapBackend = FlatHashMapBackend, typename CountersType = NullCounters>
+class SpatialHashTable3DSmallVector : public SpatialHashTable3DVector<DataType, RefType, MapBackend, CountersType, ContainerSmallVector<RefType, N>> {
+public:
+    using CellType = ContainerSmallVector<RefType, N>;
+    using BaseClass = SpatialHashTable3DVector<DataType, RefType, MapBackend, CountersType, ContainerSmallVector<RefType, N>>;
+    using HashTableType = typename BaseClass::HashTableType;
+public:
+    SpatialHashTable3DSmallVector() : BaseClass() {}
+    SpatialHashTable3DSmallVector(DataType voxel_size) : BaseClass(voxel_size) {}
+
+    // voxels refer to the arena storage, so the table is move only
+    SpatialHashTable3DSmallVector(const SpatialHashTable3DSmallVector&) = delete;
+    SpatialHashTable3DSmallVector& operator = (const SpatialHashTable3DSmallVector&) = delete;
+    SpatialHashTable3DSmallVector(SpatialHashTable3DSmallVector&&) = default;
+    SpatialHashTable3DSmallVector& operator = (SpatialHashTable3DSmallVector&&) = default;
+
+    /// @brief Sets voxel size.
+    /// @param voxel_size - voxel size
+    void SetVoxelSize(DataType voxel_size) {
+        BaseClass::SetVoxelSize(voxel_size);
+        arena_.Reset();
+    }
+
+    /// @brief Sets voxel size, hides the base table method that would keep the arena.
+    /// @param cell_size - voxel size
+    void SetCellSize(DataType cell_size) {
+        SetVoxelSize(cell_size);
+    }
+
+    /// @brief Clear the hash table. Memory is kept for reuse.
+    void Clear() {
+        BaseClass::Clear();
+        arena_.Reset();
+    }
+
+    /// @brief Add value to hash table
+    /// @param point - continuous 3D space point
+    /// @param ref - associated data
+    void Add(const DataType point[3], RefType ref) {
+        BaseClass::AddToVoxel(BaseClass::GetVoxelIndex(point), ref, arena_);
+    }
+
+    /// @brief Build the table from point array, point index is used as reference. Previous content is replaced.
+    /// Keys are sorted in parallel, voxels are filled by the calling thread, the arena isn't thread safe.
+    /// @param points - array of "count" 3D points (x, y, z)
+    /// @param count - number of points
+    /// @param num_threads - number of threads, 0 - hardware concurrency
+    void Build(const DataType* points, size_t count, size_t num_threads = 1) {
+        arena_.Reset();
+        BaseClass::BuildSorted(points, count, num_threads, [this](CellType& voxel, size_t i) {
+            voxel.Add(static_cast<RefType>(i), arena_);
+        }, false);
+    }
+
+    /// @brief Build the table from point and reference arrays. Previous content is replaced.
+    /// @param points - array of "count" 3D points (x, y, z)
+    /// @param refs - array of "count" references
+    /// @param count - number of points
+    /// @param num_threads - number of threads, 0 - hardware concurrency
+    void Build(const DataType* points, const RefType* refs, size_t count, size_t num_threads = 1) {
+        arena_.Reset();
+        BaseClass::BuildSorted(points, count, num_threads, [this, refs](CellType& voxel, size_t i) {
+            voxel.Add(refs[i], arena_);
+        }, false);
+    }
+
+    /// @brief Remove value from hash table. The voxel is removed when it becomes empty, its storage returns to the arena.
+    /// @param point - continuous 3D space point the value was added with
+    /// @param ref - associated data
+    /// @return true if value was found
+    bool Remove(const DataType point[3], const RefType& ref) {
+        return RemoveFromVoxel(BaseClass::GetVoxelIndex(point), ref);
+    }
+
+    /// @brief Move value to new position. Nothing is done if the voxel index doesn't change.
+    /// @param old_point - continuous 3D space point the value was added with
+    /// @param new_point - new continuous 3D space point
+    /// @param ref - associated data
+    /// @return true if value was found or voxel index didn't change
+    bool Move(const DataType old_point[3], const DataType new_point[3], const RefType& ref) {
+        HashIndex3D old_index = BaseClass::GetVoxelIndex(old_point);
+        HashIndex3D new_index = BaseClass::GetVoxelIndex(new_point);
+        if (old_index == new_index) {
+            return true;
+        }
+
+        if (!RemoveFromVoxel(old_index, ref)) {
+            return false;
+        }
+        BaseClass::AddToVoxel(new_index, ref, arena_);
+        return true;
+    }
+
+    /// @brief Returns occupancy statistics of the table, spilled storage is counted by arena blocks
+    /// @param histogram_size - number of cell size histogram bins
+    /// @return table statistics
+    TableStatistics GetStatistics(size_t histogram_size = 16) const {
+        TableStatistics result = BaseClass::GetStatistics(histogram_size);
+        for(const auto& voxel : BaseClass::table_) {
+            result.memory_bytes_ -= voxel.second.MemoryUsage();
+        }
+        result.memory_bytes_ += arena_.MemoryUsage();
+        return result;
+    }
+
+private:
+    bool RemoveFromVoxel(HashIndex3D index, const RefType& ref) {
+        auto itr = BaseClass::table_.find(index);
+        if (BaseClass::table_.end() == itr || !itr->second.Remove(ref)) {
+            return false;
+        }
+
+        if (itr->second.empty()) {
+            itr->second.Release(arena_);
+            BaseClass::table_.erase(itr);
+        }
+        return true;
+    }
+
+    RefArena<RefType> arena_;
+};
+
+}
@@ -6,17 +6,23 @@
 
 #include "spatial_hash/SpatialHash3D.h"
 #include "spatial_hash/Containers.h"
+#include "spatial_hash/KNearest.h"
+#include <utility>
 
 namespace libs::spatial_hash {
 
-/// @brief 
-/// @tparam DataType 
-/// @tparam RefType 
-template<typename DataType, typename RefType>
-class SpatialHashTable3DVector : public SpatialHashTable3D<DataType, RefType, ContainerVector<RefType>> {
+/// @brief 3D spatial hash table with vector container.
+/// @tparam DataType - 3D spase data type (float, double)
+/// @tparam RefType - associated data type
+/// @tparam MapBackend - hash table backend (StdHashMapBackend, FlatHashMapBackend)
+/// @tparam CountersType - hot path counters policy (NullCounters, AtomicCounters)
+/// @tparam ContainerType - voxel container with size(), begin() and end() over references
+template<typename DataType, typename RefType, typename MapBackend = StdHashMapBackend, typename CountersType = NullCounters, 
+    typename ContainerType = ContainerVector<RefType>>
+class SpatialHashTable3DVector : public SpatialHashTable3D<DataType, RefType, ContainerType, MapBackend, CountersType> {
 public:
-    using CellType = ContainerVector<RefType>;
-    using BaseClass = SpatialHashTable3D<DataType, RefType, ContainerVector<RefType>>;
+    using CellType = ContainerType;
+    using BaseClass = SpatialHashTable3D<DataType, RefType, ContainerType, MapBackend, CountersType>;
     using HashTableType = typename BaseClass::HashTableType;
 public:
     SpatialHashTable3DVector() : BaseClass() {} 
@@ -35,16 +41,101 @@ public:
         return result;
     } 
 
+    /// @brief Visit all data references in specified cube. Cube parameters in discrete hash table space.
+    /// @param center - central voxel 
+    /// @param half_size - half cube size
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInCube(HashIndex3D center, int32_t half_size, Visitor&& visitor) const {
+        BaseClass::ForEachVoxelInCube(center, half_size, [&visitor](const HashIndex3D&, const CellType& cell) {
+            for(const RefType& ref : cell) {
+                visitor(ref);
+            }
+        });
+    }
+
+    /// @brief Visit all data references in specified cube. Cube parameters in discrete hash table space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInCube(HashIndex3D corner_min, HashIndex3D corner_max, Visitor&& visitor) const {
+        BaseClass::ForEachVoxelInCube(corner_min, corner_max, [&visitor](const HashIndex3D&, const CellType& cell) {
+            for(const RefType& ref : cell) {
+                visitor(ref);
+            }
+        });
+    }
+
+    /// @brief Visit all data references in specified cube. Cube parameters in R3 space.
+    /// @param center - central point 
+    /// @param half_size - half cube size in R3
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInCube(const DataType center[3], DataType half_size, Visitor&& visitor) const {
+        HashIndex3D center_index = BaseClass::GetVoxelIndex(center);
+        uint32_t half_size_i = half_size * BaseClass::GetInvVoxelSize();
+        ForEachInCube(center_index, half_size_i, std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Visit all data references in specified cube. Cube parameters in R3 space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point 
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInCube(const DataType corner_min[3], const DataType corner_max[3], Visitor&& visitor) const {
+        HashIndex3D corner_min_i = BaseClass::GetVoxelIndex(corner_min);
+        HashIndex3D corner_max_i = BaseClass::GetVoxelIndex(corner_max);
+        ForEachInCube(corner_min_i, corner_max_i, std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Append all data references in specified cube to caller owned buffer. Cube parameters in discrete hash table space.
+    /// @param center - central voxel 
+    /// @param half_size - half cube size
+    /// @param result - output buffer, references are appended
+    void CubeSearch(HashIndex3D center, int32_t half_size, std::vector<RefType>& result) const {
+        BaseClass::ForEachVoxelInCube(center, half_size, [&result](const HashIndex3D&, const CellType& cell) {
+            result.insert(result.end(), cell.begin(), cell.end());
+        });
+    }
+
+    /// @brief Append all data references in specified cube to caller owned buffer. Cube parameters in discrete hash table space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point
+    /// @param result - output buffer, references are appended
+    void CubeSearch(HashIndex3D corner_min, HashIndex3D corner_max, std::vector<RefType>& result) const {
+        BaseClass::ForEachVoxelInCube(corner_min, corner_max, [&result](const HashIndex3D&, const CellType& cell) {
+            result.insert(result.end(), cell.begin(), cell.end());
+        });
+    }
+
+    /// @brief Append all data references in specified cube to caller owned buffer. Cube parameters in R3 space.
+    /// @param center - central point 
+    /// @param half_size - half cube size in R3
+    /// @param result - output buffer, references are appended
+    void CubeSearch(const DataType center[3], DataType half_size, std::vector<RefType>& result) const {
+        HashIndex3D center_index = BaseClass::GetVoxelIndex(center);
+        uint32_t half_size_i = half_size * BaseClass::GetInvVoxelSize();
+        CubeSearch(center_index, half_size_i, result);
+    }
+
+    /// @brief Append all data references in specified cube to caller owned buffer. Cube parameters in R3 space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point 
+    /// @param result - output buffer, references are appended
+    void CubeSearch(const DataType corner_min[3], const DataType corner_max[3], std::vector<RefType>& result) const {
+        HashIndex3D corner_min_i = BaseClass::GetVoxelIndex(corner_min);
+        HashIndex3D corner_max_i = BaseClass::GetVoxelIndex(corner_max);
+        CubeSearch(corner_min_i, corner_max_i, result);
+    }
+
     /// @brief Search all data references in specified cube. Cube parameters in discrete hash table space.
     /// @param center - central voxel 
     /// @param half_size - half cube size
     /// @return all data references in cube
     std::vector<RefType> CubeSearch(HashIndex3D center, int32_t half_size) const {
         std::vector<RefType> result;
-        std::vector<const CellType*> cells = BaseClass::CubeSearch(center, half_size);
-        for(const CellType* cell : cells) {
-            result.insert(result.end(), cell->begin(), cell->end());
-        }
+        CubeSearch(center, half_size, result);
         return result;
     }
 
@@ -54,10 +145,7 @@ public:
     /// @return all data references in cube
     std::vector<RefType> CubeSearch(HashIndex3D corner_min, HashIndex3D corner_max) const {
         std::vector<RefType> result;
-        std::vector<const CellType*> cells = BaseClass::CubeSearch(corner_min, corner_max);
-        for(const CellType* cell : cells) {
-            result.insert(result.end(), cell->begin(), cell->end());
-        }
+        CubeSearch(corner_min, corner_max, result);
         return result;
     }
 
@@ -66,9 +154,9 @@ public:
     /// @param half_size - half cube size in R3
     /// @return all data references in cube
     std::vector<RefType> CubeSearch(const DataType center[3], DataType half_size) const {
-        HashIndex3D center_index = BaseClass::GetVoxelIndex(center);
-        uint32_t half_size_i = half_size * BaseClass::GetInvVoxelSize();
-        return CubeSearch(center_index, half_size_i);
+        std::vector<RefType> result;
+        CubeSearch(center, half_size, result);
+        return result;
     }
 
     /// @brief Search all data references in specified cube. Cube parameters in R3 space.
@@ -76,11 +164,151 @@ public:
     /// @param corner_max - second diagonal point 
     /// @return all data references in cube
     std::vector<RefType> CubeSearch(const DataType corner_min[3], const DataType corner_max[3]) const {
-        HashIndex3D corner_min_i = BaseClass::GetVoxelIndex(corner_min);
-        HashIndex3D corner_max_i = BaseClass::GetVoxelIndex(corner_max);
-        return CubeSearch(corner_min_i, corner_max_i);
+        std::vector<RefType> result;
+        CubeSearch(corner_min, corner_max, result);
+        return result;
+    }
+
+    /// @brief Visit data references of all voxels intersecting the sphere. References are not filtered by distance,
+    /// the table doesn't store points.
+    /// @param center - sphere center
+    /// @param radius - sphere radius
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInSphere(const DataType center[3], DataType radius, Visitor&& visitor) const {
+        BaseClass::ForEachVoxelInSphere(center, radius, [&visitor](const HashIndex3D&, const CellType& cell) {
+            for(const RefType& ref : cell) {
+                visitor(ref);
+            }
+        });
+    }
+
+    /// @brief Append data references of all voxels intersecting the sphere to caller owned buffer.
+    /// @param center - sphere center
+    /// @param radius - sphere radius
+    /// @param result - output buffer, references are appended
+    void SphereSearch(const DataType center[3], DataType radius, std::vector<RefType>& result) const {
+        BaseClass::ForEachVoxelInSphere(center, radius, [&result](const HashIndex3D&, const CellType& cell) {
+            result.insert(result.end(), cell.begin(), cell.end());
+        });
+    }
+
+    /// @brief Search data references of all voxels intersecting the sphere.
+    /// @param center - sphere center
+    /// @param radius - sphere radius
+    /// @return data references of the voxels
+    std::vector<RefType> SphereSearch(const DataType center[3], DataType radius) const {
+        std::vector<RefType> result;
+        SphereSearch(center, radius, result);
+        return result;
+    }
+
+    /// @brief Visit data references of all voxels that can intersect the convex region (frustum, oriented box, convex polytope).
+    /// @param region - convex region
+    /// @param visitor - callable with (const RefType& ref, bool is_inside) arguments,
+    /// is_inside - the voxel of the reference is completely inside of the region
+    template<typename Visitor>
+    void ForEachInRegion(const ConvexRegion<DataType, 3>& region, Visitor&& visitor) const {
+        BaseClass::ForEachVoxelInRegion(region, [&visitor](const HashIndex3D&, const CellType& cell, bool is_inside) {
+            for(const RefType& ref : cell) {
+                visitor(ref, is_inside);
+            }
+        });
+    }
+
+    /// @brief Append data references of voxels intersecting the convex region to caller owned buffers.
+    /// References of voxels completely inside the region don't need per point tests, only boundary ones do.
+    /// @param region - convex region
+    /// @param inside - output buffer for references of voxels inside the region, references are appended
+    /// @param boundary - output buffer for references of voxels crossing the region boundary, references are appended
+    void RegionSearch(const ConvexRegion<DataType, 3>& region, std::vector<RefType>& inside, std::vector<RefType>& boundary) const {
+        BaseClass::ForEachVoxelInRegion(region, [&inside, &boundary](const HashIndex3D&, const CellType& cell, bool is_inside) {
+            std::vector<RefType>& result = is_inside ? inside : boundary;
+            result.insert(result.end(), cell.begin(), cell.end());
+        });
     }
 
+    /// @brief Search k nearest neighbours of the point. Voxels are visited shell by shell outward from the point voxel 
+    /// until the next shell can't contain closer points.
+    /// @param point - continuous 3D space point
+    /// @param k - number of neighbours
+    /// @param point_accessor - callable with (const RefType&) argument, returns pointer to 3D point of the reference
+    /// @param refs - output references sorted by distance, nearest first, overwritten
+    /// @param sqr_distances - output squared distances, overwritten
+    template<typename PointAccessor>
+    void KNearest(const DataType point[3], size_t k, PointAccessor&& point_accessor, 
+        std::vector<RefType>& refs, std::vector<DataType>& sqr_distances) const {
+        if (0 == k) {
+            refs.clear();
+            sqr_distances.clear();
+            return;
+        }
+        KNearestHeap<DataType, RefType> heap(k);
+        BaseClass::ForEachVoxelInShells(point, 
+            [&](const HashIndex3D&, const CellType& cell) {
+                for(const RefType& ref : cell) {
+                    const DataType* p = point_accessor(ref);
+                    DataType dx = p[0] - point[0];
+                    DataType dy = p[1] - point[1];
+                    DataType dz = p[2] - point[2];
+                    heap.Push(dx * dx + dy * dy + dz * dz, ref);
+                }
+            }, 
+            [&heap](DataType min_distance) {
+                return heap.Full() && min_distance * min_distance >= heap.WorstSqrDistance();
+            });
+        heap.Extract(refs, sqr_distances);
+    }
+
+    /// @brief Search k nearest neighbours of the point.
+    /// @param point - continuous 3D space point
+    /// @param k - number of neighbours
+    /// @param point_accessor - callable with (const RefType&) argument, returns pointer to 3D point of the reference
+    /// @return references sorted by distance, nearest first
+    template<typename PointAccessor>
+    std::vector<RefType> KNearest(const DataType point[3], size_t k, PointAccessor&& point_accessor) const {
+        std::vector<RefType> refs;
+        std::vector<DataType> sqr_distances;
+        KNearest(point, k, std::forward<PointAccessor>(point_accessor), refs, sqr_distances);
+        return refs;
+    }
+
+    /// @brief Visit references of populated voxels crossed by the ray, voxels are visited in traversal order.
+    /// Cost is proportional to the ray length in voxels.
+    /// @param origin - ray origin
+    /// @param direction - ray direction, doesn't have to be normalized
+    /// @param max_range - ray length, can be infinite
+    /// @param visitor - callable with (const RefType& ref, DataType distance) arguments, distance - ray length at the voxel entry
+    template<typename Visitor>
+    void Raycast(const DataType origin[3], const DataType direction[3], DataType max_range, Visitor&& visitor) const {
+        BaseClass::ForEachVoxelOnRay(origin, direction, max_range, 
+            [&visitor](const HashIndex3D&, const CellType& cell, DataType distance) {
+                for(const RefType& ref : cell) {
+                    visitor(ref, distance);
+                }
+                return false;
+            });
+    }
+
+    /// @brief Search the first populated voxel crossed by the ray, traversal stops at it.
+    /// @param origin - ray origin
+    /// @param direction - ray direction, doesn't have to be normalized
+    /// @param max_range - ray length, can be infinite
+    /// @param hit_index - output voxel index
+    /// @param hit_distance - output ray length at the voxel entry, 0 if the origin voxel is populated
+    /// @return true if a populated voxel was found
+    bool RaycastFirst(const DataType origin[3], const DataType direction[3], DataType max_range, 
+        HashIndex3D& hit_index, DataType& hit_distance) const {
+        bool result = false;
+        BaseClass::ForEachVoxelOnRay(origin, direction, max_range, 
+            [&](const HashIndex3D& index, const CellType&, DataType distance) {
+                hit_index = index;
+                hit_distance = distance;
+                result = true;
+                return true;
+            });
+        return result;
+    }
 };
 
-}
\ No newline at end of file
+}
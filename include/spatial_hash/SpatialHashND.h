@@ -0,0 +1,1149 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include "spatial_hash/HashMapBackend.h"
+#include "spatial_hash/TableStatistics.h"
+#include "spatial_hash/Counters.h"
+#include "spatial_hash/RadixSort.h"
+#include "spatial_hash/ConvexRegion.h"
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <atomic>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+
+namespace libs::spatial_hash {
+
+/// @brief 2D spatial hash index
+struct HashIndex2D {
+    HashIndex2D() :
+        x_(0), y_(0) {}
+    HashIndex2D(int32_t x, int32_t y) :
+        x_(x), y_(y) {}
+
+    int32_t x_;
+    int32_t y_;
+
+    int32_t& operator[](size_t i) {
+        return 0 == i ? x_ : y_;
+    }
+
+    int32_t operator[](size_t i) const {
+        return 0 == i ? x_ : y_;
+    }
+
+    friend bool operator == (const HashIndex2D& a, const HashIndex2D& b)
+    {
+        return !(a.x_ != b.x_ || a.y_ != b.y_);
+    }
+
+    friend HashIndex2D operator + (const HashIndex2D& a, const HashIndex2D& b)
+    {
+        return HashIndex2D(a.x_ + b.x_, a.y_ + b.y_);
+    }
+};
+
+/// @brief 3D hash table index type
+/// supported cells dimention value range [-1048576 .. 1048575]
+struct HashIndex3D {
+    HashIndex3D() :
+        x_(0), y_(0), z_(0) {}
+    HashIndex3D(int32_t x, int32_t y, int32_t z) :
+        x_(x), y_(y), z_(z) {}
+
+    int32_t x_;
+    int32_t y_;
+    int32_t z_;
+
+    int32_t& operator[](size_t i) {
+        return 0 == i ? x_ : (1 == i ? y_ : z_);
+    }
+
+    int32_t operator[](size_t i) const {
+        return 0 == i ? x_ : (1 == i ? y_ : z_);
+    }
+
+    friend bool operator == (const HashIndex3D& a, const HashIndex3D& b)
+    {
+        return !(a.x_ != b.x_ || a.y_ != b.y_ || a.z_ != b.z_);
+    }
+
+    friend HashIndex3D operator + (const HashIndex3D& lhs, const HashIndex3D& rhs)
+    {
+        return HashIndex3D(lhs.x_ + rhs.x_, lhs.y_ + rhs.y_, lhs.z_ + rhs.z_);
+    }
+};
+
+/// @brief 4D (space-time) hash table index type
+/// supported cells dimention value range [-32768 .. 32767]
+struct HashIndex4D {
+    HashIndex4D() :
+        x_(0), y_(0), z_(0), t_(0) {}
+    HashIndex4D(int32_t x, int32_t y, int32_t z, int32_t t) :
+        x_(x), y_(y), z_(z), t_(t) {}
+
+    int32_t x_;
+    int32_t y_;
+    int32_t z_;
+    int32_t t_;
+
+    int32_t& operator[](size_t i) {
+        return 0 == i ? x_ : (1 == i ? y_ : (2 == i ? z_ : t_));
+    }
+
+    int32_t operator[](size_t i) const {
+        return 0 == i ? x_ : (1 == i ? y_ : (2 == i ? z_ : t_));
+    }
+
+    friend bool operator == (const HashIndex4D& a, const HashIndex4D& b)
+    {
+        return !(a.x_ != b.x_ || a.y_ != b.y_ || a.z_ != b.z_ || a.t_ != b.t_);
+    }
+
+    friend HashIndex4D operator + (const HashIndex4D& lhs, const HashIndex4D& rhs)
+    {
+        return HashIndex4D(lhs.x_ + rhs.x_, lhs.y_ + rhs.y_, lhs.z_ + rhs.z_, lhs.t_ + rhs.t_);
+    }
+};
+
+template<size_t N>
+struct HashIndexSelector;
+
+template<>
+struct HashIndexSelector<2> {
+    using Type = HashIndex2D;
+};
+
+template<>
+struct HashIndexSelector<3> {
+    using Type = HashIndex3D;
+};
+
+template<>
+struct HashIndexSelector<4> {
+    using Type = HashIndex4D;
+};
+
+/// @brief Hash index type of N dimensional table (HashIndex2D, HashIndex3D, HashIndex4D)
+template<size_t N>
+using HashIndex = typename HashIndexSelector<N>::Type;
+
+namespace detail {
+
+template<typename Fn, size_t... I>
+inline void StaticForImpl(Fn& fn, std::index_sequence<I...>) {
+    (fn(std::integral_constant<size_t, I>()), ...);
+}
+
+/// @brief Call fn(std::integral_constant<size_t, i>) for i in [0, N), the loop is unrolled at compile time
+template<size_t N, typename Fn>
+inline void StaticFor(Fn&& fn) {
+    StaticForImpl(fn, std::make_index_sequence<N>());
+}
+
+/// @brief floor(value) as integer without libm call, value has to be in int32_t range
+template<typename DataType>
+inline int32_t FloorToInt(DataType value) {
+    const int32_t result = static_cast<int32_t>(value);
+    return result - (value < static_cast<DataType>(result) ? 1 : 0);
+}
+
+}
+
+/// @brief N dimensional spatial hash function, packs 64 / N bits per axis,
+/// 2D - 32 bits, 3D - 21 bits, 4D - 16 bits. Indices inside of the axis range get unique keys,
+/// indices out of it share keys with other indices, tables keep them apart by index comparison.
+template<size_t N>
+struct SpatialHashKey {
+    static constexpr uint32_t kBits = 64 / N;
+
+    uint64_t operator() (const HashIndex<N>& val) const
+    {
+        constexpr int64_t offset = int64_t(1) << (kBits - 1);
+        constexpr uint64_t mask = (uint64_t(1) << kBits) - 1;
+        uint64_t result = static_cast<uint64_t>(val[N - 1] + offset) << (kBits * (N - 1));
+        detail::StaticFor<N - 1>([&](auto i) {
+            result |= (static_cast<uint64_t>(val[i] + offset) & mask) << (kBits * i);
+        });
+        return result;
+    }
+
+    /// @brief Returns true if the index is inside of the axis range, so its key isn't shared with other indices
+    static bool IsInRange(const HashIndex<N>& val) {
+        constexpr int64_t offset = int64_t(1) << (kBits - 1);
+        bool result = true;
+        detail::StaticFor<N>([&](auto i) {
+            result = result && -offset <= val[i] && val[i] < offset;
+        });
+        return result;
+    }
+};
+
+/// @brief 2D spatial hash function
+using SpatalHash2D = SpatialHashKey<2>;
+/// @brief 3D spatial hash function
+using SpatalHash3D = SpatialHashKey<3>;
+/// @brief 4D spatial hash function
+using SpatalHash4D = SpatialHashKey<4>;
+
+/// @brief Base class for N dimensional spatial hash table, index computation and cell box iteration
+/// are unrolled over dimensions at compile time. 2D and 3D tables extend it with cell / voxel named API.
+/// @tparam N - number of dimensions (2, 3, 4)
+/// @tparam DataType - space data type (float, double)
+/// @tparam RefType - point associated data type
+/// @tparam ContainerType - cell container type, must have Add(...) method
+/// @tparam MapBackend - hash table backend (StdHashMapBackend, FlatHashMapBackend)
+/// @tparam CountersType - hot path counters policy (NullCounters, AtomicCounters)
+template<size_t N, typename DataType, typename RefType, typename ContainerType, typename MapBackend = StdHashMapBackend,
+    typename CountersType = NullCounters>
+class SpatialHashTable {
+public:
+    static constexpr size_t kDimensions = N;
+    using IndexType = HashIndex<N>;
+    using HashType = SpatialHashKey<N>;
+protected:
+    using HashTableType = typename MapBackend::template Map<IndexType, ContainerType, HashType>;
+
+    DataType cell_size_;
+    DataType inv_cell_size_;
+    HashTableType table_;
+    CountersType counters_;
+    /// @brief Bounding box of cells added since the last Clear, removal doesn't shrink it
+    IndexType bounds_min_;
+    IndexType bounds_max_;
+public:
+    /// @brief Default constructor
+    SpatialHashTable() : cell_size_(0), inv_cell_size_(0) {
+        ResetBounds();
+    }
+
+    /// @brief Constructor with cell size
+    /// @param cell_size - size of cell
+    explicit SpatialHashTable(DataType cell_size) : cell_size_(cell_size), inv_cell_size_(1 / cell_size) {
+        ResetBounds();
+    }
+
+    /// @brief Sets cell size
+    /// @param cell_size - size of cell
+    void SetCellSize(DataType cell_size) {
+        Clear();
+        cell_size_ = cell_size;
+        inv_cell_size_ = 1 / cell_size;
+    }
+
+    /// @brief Clear hash table
+    void Clear() {
+        table_.clear();
+        ResetBounds();
+    }
+
+    /// @brief Returns cell size.
+    /// @return - cell size
+    DataType GetCellSize() const {
+        return cell_size_;
+    }
+
+    /// @brief Returns inverse cell size.
+    /// @return - inverse cell size
+    DataType GetInvCellSize() const {
+        return inv_cell_size_;
+    }
+
+    /// @brief Returns hash table
+    /// @return hash table reference
+    const HashTableType& GetTable() const {
+        return table_;
+    }
+
+    /// @brief Returns occupancy statistics of the table
+    /// @param histogram_size - number of cell size histogram bins
+    /// @return table statistics
+    TableStatistics GetStatistics(size_t histogram_size = 16) const {
+        TableStatistics result;
+        result.histogram_.assign(histogram_size, 0);
+        result.memory_bytes_ = sizeof(*this) + MapBackend::MemoryUsage(table_);
+        for(const auto& cell : table_) {
+            result.AddCell(cell.second.size());
+            result.memory_bytes_ += cell.second.MemoryUsage();
+        }
+        result.load_factor_ = table_.load_factor();
+        result.Finalize();
+        return result;
+    }
+
+    /// @brief Returns hot path counters, all zero for NullCounters policy
+    /// @return counters snapshot
+    CountersSnapshot GetCounters() const {
+        return counters_.Snapshot();
+    }
+
+    /// @brief Set hot path counters to zero
+    void ResetCounters() {
+        counters_.Reset();
+    }
+
+    /// @brief Add value to hash table
+    /// @param point - continuous N dimensional space point
+    /// @param ref - associated data
+    void Add(const DataType point[N], RefType ref) {
+        AddToCell(GetCellIndex(point), ref);
+    }
+
+    /// @brief Build the table from point array, point index is used as reference. Previous content is replaced.
+    /// @param points - array of "count" N dimensional points
+    /// @param count - number of points
+    /// @param num_threads - number of threads, 0 - hardware concurrency
+    void Build(const DataType* points, size_t count, size_t num_threads = 1) {
+        BuildSorted(points, count, num_threads, [](ContainerType& cell, size_t i) { cell.Add(static_cast<RefType>(i)); });
+    }
+
+    /// @brief Build the table from point and reference arrays. Previous content is replaced.
+    /// Cell keys are computed and sorted in parallel, cells are filled in parallel and moved into the table once,
+    /// the result is equal to sequential Add in input order for any number of threads.
+    /// @param points - array of "count" N dimensional points
+    /// @param refs - array of "count" references
+    /// @param count - number of points
+    /// @param num_threads - number of threads, 0 - hardware concurrency
+    void Build(const DataType* points, const RefType* refs, size_t count, size_t num_threads = 1) {
+        BuildSorted(points, count, num_threads, [refs](ContainerType& cell, size_t i) { cell.Add(refs[i]); });
+    }
+
+    /// @brief Remove value from hash table. The cell is removed when it becomes empty.
+    /// @param point - continuous N dimensional space point the value was added with
+    /// @param ref - associated data
+    /// @return true if value was found
+    bool Remove(const DataType point[N], const RefType& ref) {
+        return RemoveFromCell(GetCellIndex(point), ref);
+    }
+
+    /// @brief Move value to new position. Nothing is done if the cell index doesn't change.
+    /// @param old_point - continuous N dimensional space point the value was added with
+    /// @param new_point - new continuous N dimensional space point
+    /// @param ref - associated data
+    /// @return true if value was found or cell index didn't change
+    bool Move(const DataType old_point[N], const DataType new_point[N], const RefType& ref) {
+        IndexType old_index = GetCellIndex(old_point);
+        IndexType new_index = GetCellIndex(new_point);
+        if (old_index == new_index) {
+            return true;
+        }
+
+        if (!RemoveFromCell(old_index, ref)) {
+            return false;
+        }
+        AddToCell(new_index, ref);
+        return true;
+    }
+
+    /// @brief Convert continuous N dimensional space point in discrete hash space index
+    /// @param point - continuous N dimensional space point
+    /// @return hash table index
+    IndexType GetCellIndex(const DataType point[N]) const {
+        IndexType result;
+        detail::StaticFor<N>([&](auto i) {
+            result[i] = static_cast<int32_t>(std::floor(point[i] * inv_cell_size_));
+        });
+        return result;
+    }
+
+protected:
+    /// @brief Add value to the cell container, the cell is created if it doesn't exist.
+    /// @param index - cell index
+    /// @param args - container Add(...) arguments
+    template<typename... Args>
+    void AddToCell(const IndexType& index, Args&&... args) {
+        ExpandBounds(index);
+        if constexpr (CountersType::kEnabled) {
+            const size_t cell_count = table_.size();
+            const size_t bucket_count = table_.bucket_count();
+            const size_t table_memory = MapBackend::MemoryUsage(table_);
+            ContainerType& cell = table_[index];
+            const size_t cell_memory = cell.MemoryUsage();
+            cell.Add(std::forward<Args>(args)...);
+
+            const size_t new_table_memory = MapBackend::MemoryUsage(table_);
+            const size_t new_cell_memory = cell.MemoryUsage();
+            counters_.OnInsert(1, table_.size() - cell_count, table_.bucket_count() != bucket_count ? 1 : 0,
+                (new_table_memory > table_memory ? new_table_memory - table_memory : 0) +
+                (new_cell_memory > cell_memory ? new_cell_memory - cell_memory : 0));
+        } else {
+            table_[index].Add(std::forward<Args>(args)...);
+        }
+    }
+
+    /// @brief Replace content with sorted points, every cell is created once and filled in input order.
+    /// With several threads cells are filled by chunks of the sorted points aligned to key groups, then moved into the table.
+    /// Indices out of the key range can share a key, such groups are split by cell index.
+    /// @param add_fn - callable with (ContainerType& cell, size_t point_idx) arguments, adds the point reference
+    /// @param is_fill_parallel - false if add_fn isn't thread safe, e.g. containers share storage of the table
+    template<typename AddFn>
+    void BuildSorted(const DataType* points, size_t count, size_t num_threads, AddFn&& add_fn, bool is_fill_parallel = true) {
+        Clear();
+
+        std::vector<uint64_t> keys;
+        std::vector<uint32_t> order;
+        std::atomic<bool> is_out_of_range(false);
+        SortByKey(count, [this, points, &is_out_of_range](size_t i) {
+                const IndexType index = GetCellIndex(points + N * i);
+                if (!HashType::IsInRange(index)) {
+                    is_out_of_range.store(true, std::memory_order_relaxed);
+                }
+                return HashType()(index);
+            }, num_threads, keys, order);
+        const bool has_shared_keys = is_out_of_range.load();
+
+        auto cell_of = [this, points, &order](size_t i) {
+            return GetCellIndex(points + N * static_cast<size_t>(order[i]));
+        };
+        // first point of the key group containing or following the sorted point
+        auto group_begin = [&keys, count](size_t i) {
+            for(; i > 0 && i < count && keys[i] == keys[i - 1]; ++i) {}
+            return i;
+        };
+        auto count_groups = [&keys](size_t begin, size_t end) {
+            size_t result = 0;
+            for(size_t i = begin; i < end; ++i) {
+                result += (i == begin || keys[i] != keys[i - 1]) ? 1 : 0;
+            }
+            return result;
+        };
+        // fills cells of whole key groups in [begin, end), new_cell(index) returns the container of a new cell
+        auto fill_cells = [&](size_t begin, size_t end, auto&& new_cell) {
+            for(size_t group = begin; group < end;) {
+                size_t group_end = group + 1;
+                for(; group_end < end && keys[group_end] == keys[group]; ++group_end) {}
+
+                IndexType index = cell_of(group);
+                size_t split = group_end;
+                if (has_shared_keys) {
+                    for(split = group + 1; split < group_end && cell_of(split) == index; ++split) {}
+                }
+                if (split == group_end) {
+                    ContainerType& cell = new_cell(index);
+                    for(size_t i = group; i < group_end; ++i) {
+                        add_fn(cell, order[i]);
+                    }
+                    group = group_end;
+                    continue;
+                }
+
+                // stable sort keeps input order inside of every cell
+                std::stable_sort(order.begin() + group, order.begin() + group_end, [this, points](uint32_t a, uint32_t b) {
+                    const IndexType index_a = GetCellIndex(points + N * static_cast<size_t>(a));
+                    const IndexType index_b = GetCellIndex(points + N * static_cast<size_t>(b));
+                    for(size_t i = 0; i < N; ++i) {
+                        if (index_a[i] != index_b[i]) {
+                            return index_a[i] < index_b[i];
+                        }
+                    }
+                    return false;
+                });
+                while (group < group_end) {
+                    index = cell_of(group);
+                    ContainerType& cell = new_cell(index);
+                    for(; group < group_end && cell_of(group) == index; ++group) {
+                        add_fn(cell, order[group]);
+                    }
+                }
+            }
+        };
+
+        const size_t bucket_count = table_.bucket_count();
+        const size_t fill_threads = is_fill_parallel ? GetThreadCount(num_threads, count, 1 << 14) : 1;
+        if (fill_threads <= 1) {
+            table_.reserve(count_groups(0, count));
+            fill_cells(0, count, [this](const IndexType& index) -> ContainerType& {
+                ExpandBounds(index);
+                return table_[index];
+            });
+        } else {
+            std::vector<std::vector<std::pair<IndexType, ContainerType>>> chunk_cells(fill_threads);
+            ParallelFor(count, fill_threads, [&](size_t thread_idx, size_t begin, size_t end) {
+                auto& cells = chunk_cells[thread_idx];
+                begin = group_begin(begin);
+                end = group_begin(end);
+                cells.reserve(count_groups(begin, end));
+                fill_cells(begin, end, [&cells](const IndexType& index) -> ContainerType& {
+                    cells.emplace_back(index, ContainerType());
+                    return cells.back().second;
+                });
+            });
+
+            size_t cell_count = 0;
+            for(const auto& cells : chunk_cells) {
+                cell_count += cells.size();
+            }
+            table_.reserve(cell_count);
+            for(auto& cells : chunk_cells) {
+                for(auto& cell : cells) {
+                    ExpandBounds(cell.first);
+                    table_[cell.first] = std::move(cell.second);
+                }
+                std::vector<std::pair<IndexType, ContainerType>>().swap(cells);
+            }
+        }
+
+        if constexpr (CountersType::kEnabled) {
+            size_t cell_memory = 0;
+            for(const auto& cell : table_) {
+                cell_memory += cell.second.MemoryUsage();
+            }
+            counters_.OnInsert(count, table_.size(), table_.bucket_count() != bucket_count ? 1 : 0,
+                MapBackend::MemoryUsage(table_) + cell_memory);
+        }
+    }
+
+    /// @brief Remove value from the cell, empty cell is erased.
+    /// @param index - cell index
+    /// @param ref - associated data
+    /// @return true if value was found
+    bool RemoveFromCell(IndexType index, const RefType& ref) {
+        auto itr = table_.find(index);
+        if (table_.end() == itr || !itr->second.Remove(ref)) {
+            return false;
+        }
+
+        if (itr->second.empty()) {
+            table_.erase(itr);
+        }
+        return true;
+    }
+
+    /// @brief Search data for specific cell.
+    /// @param index - cell index
+    /// @return cell container pointer, nullptr if the cell is empty
+    const ContainerType* GetCell(IndexType index) const {
+        auto itr = table_.find(index);
+        if(table_.end() == itr) {
+            counters_.OnProbes(1, 0, 0);
+            return nullptr;
+        }
+
+        counters_.OnProbes(1, 1, itr->second.size());
+        return &(itr->second);
+    }
+
+    /// @brief Visit all populated cells in the box between corner_min and corner_max (inclusive).
+    /// Corners have to be ordered, empty box visits nothing. If the box has more cells than the table,
+    /// populated cells are iterated instead of probing every cell of the box, so the cost is O(min(box cells, populated cells)).
+    /// @param corner_min - min corner cell
+    /// @param corner_max - max corner cell
+    /// @param visitor - callable with (const IndexType& index, const ContainerType& cell) arguments
+    template<typename Visitor>
+    void ForEachCell(IndexType corner_min, IndexType corner_max, Visitor&& visitor) const {
+        bool is_empty = false;
+        double box_volume = 1.0;
+        detail::StaticFor<N>([&](auto i) {
+            is_empty |= corner_max[i] < corner_min[i];
+            box_volume *= double(corner_max[i]) - corner_min[i] + 1;
+        });
+        if (is_empty) {
+            return;
+        }
+
+        if (box_volume > table_.size()) {
+            ScanCells(corner_min, corner_max, visitor);
+            return;
+        }
+
+        // local counts are flushed once, for NullCounters they are removed by compiler
+        size_t hits = 0;
+        size_t candidates = 0;
+        IndexType grid_point;
+        ProbeBox<0>(grid_point, corner_min, corner_max, visitor, hits, candidates);
+        counters_.OnProbes(static_cast<uint64_t>(box_volume), hits, candidates);
+    }
+
+    /// @brief Visit all populated cells in (2 * half_size + 1) box of cells with "center" cell in center
+    /// @param center - center cell
+    /// @param half_size - half size of the search box
+    /// @param visitor - callable with (const IndexType& index, const ContainerType& cell) arguments
+    template<typename Visitor>
+    void ForEachCellInBox(const IndexType& center, int32_t half_size, Visitor&& visitor) const {
+        IndexType corner_min;
+        IndexType corner_max;
+        detail::StaticFor<N>([&](auto i) {
+            corner_min[i] = center[i] - half_size;
+            corner_max[i] = center[i] + half_size;
+        });
+        counters_.OnQuery();
+        ForEachCell(corner_min, corner_max, std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Visit all populated cells in the box defined by two diagonal cells
+    /// @param corner_min - first diagonal cell
+    /// @param corner_max - second diagonal cell
+    /// @param visitor - callable with (const IndexType& index, const ContainerType& cell) arguments
+    template<typename Visitor>
+    void ForEachCellInBox(IndexType corner_min, IndexType corner_max, Visitor&& visitor) const {
+        detail::StaticFor<N>([&](auto i) {
+            if (corner_max[i] < corner_min[i]) {
+                std::swap(corner_min[i], corner_max[i]);
+            }
+        });
+        counters_.OnQuery();
+        ForEachCell(corner_min, corner_max, std::forward<Visitor>(visitor));
+    }
+
+    /// @brief Visit all populated cells on the surface of (2 * ring + 1) box of cells with "center" cell in center
+    /// @param center - center cell
+    /// @param ring - Chebyshev distance from center cell in cells
+    /// @param visitor - callable with (const IndexType& index, const ContainerType& cell) arguments
+    template<typename Visitor>
+    void ForEachCellInShell(const IndexType& center, int32_t ring, Visitor&& visitor) const {
+        if (0 == ring) {
+            ForEachCell(center, center, visitor);
+            return;
+        }
+
+        // two faces per axis, axes before the face axis skip cells of already visited faces
+        const int32_t inner = ring - 1;
+        detail::StaticFor<N>([&](auto axis) {
+            IndexType corner_min;
+            IndexType corner_max;
+            detail::StaticFor<N>([&](auto i) {
+                const int32_t extent = i < axis ? inner : ring;
+                corner_min[i] = center[i] - extent;
+                corner_max[i] = center[i] + extent;
+            });
+            for(int32_t face : {center[axis] - ring, center[axis] + ring}) {
+                corner_min[axis] = face;
+                corner_max[axis] = face;
+                ForEachCell(corner_min, corner_max, visitor);
+            }
+        });
+    }
+
+    /// @brief Visit populated cells shell by shell outward from the cell of the point.
+    /// Stops when all populated cells are visited or when "stop" returns true. Shells start at the bounding box of 
+    /// added cells and end at its far corner, once a shell has more cells than the table the remaining cells 
+    /// are visited by one table scan, so queries far from the data or that never stop cost O(table size).
+    /// @param point - continuous N dimensional space point
+    /// @param visitor - callable with (const IndexType& index, const ContainerType& cell) arguments
+    /// @param stop - callable with (DataType min_distance) argument, called before each shell,
+    /// min_distance - lower bound of the distance from the point to any cell not visited yet
+    template<typename Visitor, typename StopPredicate>
+    void ForEachCellInShells(const DataType point[N], Visitor&& visitor, StopPredicate&& stop) const {
+        const IndexType center = GetCellIndex(point);
+        counters_.OnQuery();
+
+        // distance from the point to the nearest side of its cell
+        DataType side_distance = cell_size_;
+        detail::StaticFor<N>([&](auto i) {
+            DataType low = point[i] - center[i] * cell_size_;
+            side_distance = std::min(side_distance, std::max(DataType(0), std::min(low, cell_size_ - low)));
+        });
+
+        // Chebyshev distances in cells from the center to the bounding box of added cells and to its far corner
+        int64_t first_ring = 0;
+        int64_t last_ring = -1;
+        if (!table_.empty()) {
+            detail::StaticFor<N>([&](auto i) {
+                const int64_t to_min = int64_t(bounds_min_[i]) - center[i];
+                const int64_t to_max = int64_t(center[i]) - bounds_max_[i];
+                first_ring = std::max(first_ring, std::max(to_min, to_max));
+                last_ring = std::max(last_ring, std::max(-to_min, -to_max));
+            });
+        }
+
+        size_t visited = 0;
+        auto counting_visitor = [&visited, &visitor](const IndexType& index, const ContainerType& cell) {
+            ++visited;
+            visitor(index, cell);
+        };
+
+        for(int64_t ring = first_ring; ring <= last_ring && visited < table_.size(); ++ring) {
+            if (ring > 0 && stop((ring - 1) * cell_size_ + side_distance)) {
+                break;
+            }
+
+            double shell_cells = 1;
+            double inner_cells = 1;
+            detail::StaticFor<N>([&](auto) {
+                shell_cells *= 2.0 * ring + 1;
+                inner_cells *= 2.0 * ring - 1;
+            });
+            if (ring > 0 && shell_cells - inner_cells > table_.size()) {
+                // cells of this and further shells
+                size_t hits = 0;
+                size_t candidates = 0;
+                for(const auto& cell : table_) {
+                    int64_t distance = 0;
+                    detail::StaticFor<N>([&](auto i) {
+                        distance = std::max(distance, std::abs(int64_t(cell.first[i]) - center[i]));
+                    });
+                    if (distance >= ring) {
+                        ++hits;
+                        candidates += cell.second.size();
+                        visitor(cell.first, cell.second);
+                    }
+                }
+                counters_.OnProbes(table_.size(), hits, candidates);
+                break;
+            }
+            ForEachCellInShell(center, static_cast<int32_t>(ring), counting_visitor);
+        }
+    }
+
+    /// @brief Visit populated cells whose boxes intersect the ball, other cells of the bounding box are not probed.
+    /// Rows of cells along the last axis that can intersect the ball are precomputed per integer radius in cells 
+    /// and cached per thread, the exact cell range of every row is computed from the ball center.
+    /// Balls whose bounding box has more cells than the table scan the table instead.
+    /// @param center - ball center, continuous N dimensional space point
+    /// @param radius - ball radius, can be infinite
+    /// @param visitor - callable with (const IndexType& index, const ContainerType& cell) arguments
+    template<typename Visitor>
+    void ForEachCellInBall(const DataType center[N], DataType radius, Visitor&& visitor) const {
+        counters_.OnQuery();
+        if (!(radius >= 0)) {
+            return;
+        }
+
+        const DataType radius_sqr = radius * radius;
+        // squared distance from the ball center to the cell slab along the axis
+        auto slab_distance = [this, center](size_t axis, int32_t index) {
+            const DataType low = index * cell_size_;
+            const DataType delta = std::max(std::max(low - center[axis], center[axis] - low - cell_size_), DataType(0));
+            return delta * delta;
+        };
+
+        // the bounding box volume decides before rows are built, so a large ball over a small table costs one scan
+        size_t hits = 0;
+        size_t candidates = 0;
+        const double half_extent = std::ceil(static_cast<double>(radius) * inv_cell_size_);
+        double box_cells = 1;
+        detail::StaticFor<N>([&](auto) {
+            box_cells *= 2 * half_extent + 1;
+        });
+        if (box_cells > table_.size()) {
+            for(const auto& cell : table_) {
+                DataType distance = 0;
+                detail::StaticFor<N>([&](auto i) {
+                    distance += slab_distance(i, cell.first[i]);
+                });
+                if (distance <= radius_sqr) {
+                    ++hits;
+                    candidates += cell.second.size();
+                    visitor(cell.first, cell.second);
+                }
+            }
+            counters_.OnProbes(table_.size(), hits, candidates);
+            return;
+        }
+
+        const IndexType center_index = GetCellIndex(center);
+        const int32_t half_size = static_cast<int32_t>(half_extent);
+        std::vector<IndexType> buffer;
+        const std::vector<IndexType>& rows = BallRows(half_size, buffer);
+        constexpr size_t kLast = N - 1;
+        size_t probes = 0;
+        IndexType index;
+        for(const IndexType& row : rows) {
+            DataType row_distance = 0;
+            detail::StaticFor<kLast>([&](auto i) {
+                index[i] = center_index[i] + row[i];
+                row_distance += slab_distance(i, index[i]);
+            });
+            if (row_distance > radius_sqr) {
+                continue;
+            }
+
+            // cells of the row within the ball section
+            const DataType half_chord = std::sqrt(radius_sqr - row_distance);
+            const int32_t begin = std::max(center_index[kLast] - half_size, detail::FloorToInt((center[kLast] - half_chord) * inv_cell_size_));
+            const int32_t end = std::min(center_index[kLast] + half_size, detail::FloorToInt((center[kLast] + half_chord) * inv_cell_size_));
+            for(int32_t i = begin; i <= end; ++i) {
+                index[kLast] = i;
+                auto itr = table_.find(index);
+                if (table_.end() == itr) {
+                    continue;
+                }
+                ++hits;
+                candidates += itr->second.size();
+                visitor(static_cast<const IndexType&>(index), itr->second);
+            }
+            probes += std::max(end - begin + 1, 0);
+        }
+        counters_.OnProbes(probes, hits, candidates);
+    }
+
+    /// @brief Visit populated cells whose boxes can intersect the convex region, cells outside of any half-space are not probed.
+    /// The region bounding box is enumerated row by row along the last axis, every half-space clips the row to
+    /// the range of cells it doesn't exclude and to the range of cells it contains completely, so the cost per row
+    /// is O(half-spaces) and cells of the row are classified without per cell plane tests.
+    /// Cells crossing an edge of the region outside of all half-space planes are visited as boundary cells.
+    /// @param region - convex region, its bounding box limits the enumerated cells
+    /// @param visitor - callable with (const IndexType& index, const ContainerType& cell, bool is_inside) arguments,
+    /// is_inside - the cell box is inside of the bounding box and all half-spaces up to rounding, 
+    /// so its points don't need per point tests
+    template<typename Visitor>
+    void ForEachCellInRegion(const ConvexRegion<DataType, N>& region, Visitor&& visitor) const {
+        counters_.OnQuery();
+        const IndexType corner_min = GetCellIndex(region.GetMin());
+        const IndexType corner_max = GetCellIndex(region.GetMax());
+        bool is_empty = false;
+        double box_volume = 1.0;
+        detail::StaticFor<N>([&](auto i) {
+            is_empty |= corner_max[i] < corner_min[i];
+            box_volume *= double(corner_max[i]) - corner_min[i] + 1;
+        });
+        if (is_empty) {
+            return;
+        }
+
+        const auto& half_spaces = region.GetHalfSpaces();
+        const DataType* region_min = region.GetMin();
+        const DataType* region_max = region.GetMax();
+        size_t hits = 0;
+        size_t candidates = 0;
+        if (box_volume > table_.size()) {
+            for(const auto& cell : table_) {
+                const IndexType& index = cell.first;
+                bool is_in_box = true;
+                bool is_inside = true;
+                detail::StaticFor<N>([&](auto i) {
+                    is_in_box = is_in_box && corner_min[i] <= index[i] && index[i] <= corner_max[i];
+                    is_inside = is_inside && region_min[i] <= index[i] * cell_size_ && (index[i] + 1) * cell_size_ <= region_max[i];
+                });
+                if (!is_in_box) {
+                    continue;
+                }
+
+                bool is_outside = false;
+                for(const auto& half_space : half_spaces) {
+                    DataType min_distance = 0;
+                    DataType max_distance = 0;
+                    detail::StaticFor<N>([&](auto i) {
+                        const DataType low = half_space.normal_[i] * (index[i] * cell_size_);
+                        const DataType high = low + half_space.normal_[i] * cell_size_;
+                        min_distance += std::min(low, high);
+                        max_distance += std::max(low, high);
+                    });
+                    is_outside |= min_distance > half_space.offset_;
+                    is_inside &= max_distance <= half_space.offset_;
+                }
+                if (!is_outside) {
+                    ++hits;
+                    candidates += cell.second.size();
+                    visitor(index, cell.second, is_inside);
+                }
+            }
+            counters_.OnProbes(table_.size(), hits, candidates);
+            return;
+        }
+
+        constexpr size_t kLast = N - 1;
+        size_t probes = 0;
+        IndexType index = corner_min;
+        while (true) {
+            // ranges of the last axis coordinate, [low, high] isn't excluded and [inner_low, inner_high] is contained by all half-spaces
+            // the row is clipped to the bounding box, its cells are inside only if the row is inside along other axes
+            DataType low = region_min[kLast];
+            DataType high = region_max[kLast];
+            DataType inner_low = low;
+            DataType inner_high = high;
+            bool is_row_empty = false;
+            bool has_inner = true;
+            detail::StaticFor<kLast>([&](auto i) {
+                has_inner = has_inner && region_min[i] <= index[i] * cell_size_ && (index[i] + 1) * cell_size_ <= region_max[i];
+            });
+            for(const auto& half_space : half_spaces) {
+                DataType min_distance = 0;
+                DataType max_distance = 0;
+                detail::StaticFor<kLast>([&](auto i) {
+                    const DataType row_low = half_space.normal_[i] * (index[i] * cell_size_);
+                    const DataType row_high = row_low + half_space.normal_[i] * cell_size_;
+                    min_distance += std::min(row_low, row_high);
+                    max_distance += std::max(row_low, row_high);
+                });
+
+                const DataType normal = half_space.normal_[kLast];
+                if (normal > 0) {
+                    high = std::min(high, (half_space.offset_ - min_distance) / normal);
+                    inner_high = std::min(inner_high, (half_space.offset_ - max_distance) / normal);
+                } else if (normal < 0) {
+                    low = std::max(low, (half_space.offset_ - min_distance) / normal);
+                    inner_low = std::max(inner_low, (half_space.offset_ - max_distance) / normal);
+                } else {
+                    is_row_empty |= min_distance > half_space.offset_;
+                    has_inner &= max_distance <= half_space.offset_;
+                }
+            }
+
+            if (!is_row_empty && low <= high) {
+                const int32_t begin = std::max(corner_min[kLast], detail::FloorToInt(low * inv_cell_size_));
+                const int32_t end = std::min(corner_max[kLast], detail::FloorToInt(high * inv_cell_size_));
+                const int32_t inner_begin = -detail::FloorToInt(-inner_low * inv_cell_size_);
+                const int32_t inner_end = has_inner ? detail::FloorToInt(inner_high * inv_cell_size_) - 1 : inner_begin - 1;
+                for(int32_t i = begin; i <= end; ++i) {
+                    index[kLast] = i;
+                    auto itr = table_.find(index);
+                    if (table_.end() == itr) {
+                        continue;
+                    }
+                    ++hits;
+                    candidates += itr->second.size();
+                    visitor(static_cast<const IndexType&>(index), itr->second, inner_begin <= i && i <= inner_end);
+                }
+                probes += std::max(end - begin + 1, 0);
+            }
+
+            size_t axis = kLast;
+            while (axis > 0) {
+                --axis;
+                if (++index[axis] <= corner_max[axis]) {
+                    break;
+                }
+                index[axis] = corner_min[axis];
+            }
+            if (0 == axis && corner_min[0] == index[0]) {
+                break;
+            }
+        }
+        counters_.OnProbes(probes, hits, candidates);
+    }
+
+    /// @brief Visit populated cells crossed by the ray in traversal order (Amanatides-Woo grid traversal).
+    /// Cells are stepped one by one from the cell of the origin, so the cost is proportional to the ray length in cells.
+    /// The ray is clipped to the bounding box of added cells, so infinite range stops where the ray leaves it.
+    /// @param origin - ray origin, continuous N dimensional space point
+    /// @param direction - ray direction, doesn't have to be normalized, zero direction visits the origin cell only
+    /// @param max_range - ray length along normalized direction, can be infinite
+    /// @param visitor - callable with (const IndexType& index, const ContainerType& cell, DataType distance) arguments,
+    /// distance - ray length at the cell entry, returns true to stop traversal
+    template<typename Visitor>
+    void ForEachCellOnRay(const DataType origin[N], const DataType direction[N], DataType max_range, Visitor&& visitor) const {
+        counters_.OnQuery();
+        if (!(max_range >= 0) || table_.empty()) {
+            return;
+        }
+
+        DataType norm = 0;
+        detail::StaticFor<N>([&](auto i) {
+            norm += direction[i] * direction[i];
+        });
+        norm = std::sqrt(norm);
+        DataType unit[N];
+        detail::StaticFor<N>([&](auto i) {
+            unit[i] = norm > 0 ? direction[i] / norm : DataType(0);
+        });
+
+        // ray interval inside of the cell bounds, one cell of slack covers rounding of the traversal
+        IndexType index = GetCellIndex(origin);
+        DataType entry = 0;
+        DataType exit = max_range;
+        detail::StaticFor<N>([&](auto i) {
+            if (0 == unit[i]) {
+                if (index[i] < bounds_min_[i] || bounds_max_[i] < index[i]) {
+                    exit = -1;
+                }
+                return;
+            }
+            const DataType t1 = (bounds_min_[i] * cell_size_ - origin[i]) / unit[i];
+            const DataType t2 = ((bounds_max_[i] + DataType(1)) * cell_size_ - origin[i]) / unit[i];
+            entry = std::max(entry, std::min(t1, t2));
+            exit = std::min(exit, std::max(t1, t2) + cell_size_);
+        });
+        if (exit < entry) {
+            return;
+        }
+        max_range = exit;
+
+        // ray length to the next cell border and between cell borders per axis
+        constexpr DataType kInf = std::numeric_limits<DataType>::infinity();
+        int32_t step[N];
+        DataType next[N];
+        DataType delta[N];
+        detail::StaticFor<N>([&](auto i) {
+            const DataType d = unit[i];
+            step[i] = d > 0 ? 1 : (d < 0 ? -1 : 0);
+            if (0 == step[i]) {
+                next[i] = kInf;
+                delta[i] = kInf;
+                return;
+            }
+            const DataType border = (index[i] + (step[i] > 0 ? 1 : 0)) * cell_size_;
+            next[i] = std::max(DataType(0), (border - origin[i]) / d);
+            delta[i] = cell_size_ / std::abs(d);
+        });
+
+        size_t probes = 0;
+        size_t hits = 0;
+        size_t candidates = 0;
+        DataType distance = 0;
+        while (true) {
+            ++probes;
+            auto itr = table_.find(index);
+            if (table_.end() != itr) {
+                ++hits;
+                candidates += itr->second.size();
+                if (visitor(static_cast<const IndexType&>(index), itr->second, distance)) {
+                    break;
+                }
+            }
+
+            size_t axis = 0;
+            detail::StaticFor<N>([&](auto i) {
+                if (next[i] < next[axis]) {
+                    axis = i;
+                }
+            });
+            // zero direction has no axis to step along and stops after the origin cell
+            if (0 == step[axis] || !(next[axis] <= max_range)) {
+                break;
+            }
+            distance = next[axis];
+            index[axis] += step[axis];
+            next[axis] += delta[axis];
+        }
+        counters_.OnProbes(probes, hits, candidates);
+    }
+
+    /// @brief Search all populated cells in (2 * half_size + 1) box of cells with "center" cell in center
+    /// @param center - center cell
+    /// @param half_size - half size of the search box
+    /// @return Return all populated cells in the box
+    std::vector<const ContainerType*> BoxSearch(const IndexType& center, int32_t half_size) const {
+        std::vector<const ContainerType*> result;
+        ForEachCellInBox(center, half_size, [&result](const IndexType&, const ContainerType& cell) {
+            result.push_back(&cell);
+        });
+        return result;
+    }
+
+    /// @brief Search all populated cells in the box defined by two diagonal cells
+    /// @param corner_min - first diagonal cell
+    /// @param corner_max - second diagonal cell
+    /// @return Return all populated cells in the box
+    std::vector<const ContainerType*> BoxSearch(const IndexType& corner_min, const IndexType& corner_max) const {
+        std::vector<const ContainerType*> result;
+        ForEachCellInBox(corner_min, corner_max, [&result](const IndexType&, const ContainerType& cell) {
+            result.push_back(&cell);
+        });
+        return result;
+    }
+
+private:
+    void ResetBounds() {
+        detail::StaticFor<N>([&](auto i) {
+            bounds_min_[i] = std::numeric_limits<int32_t>::max();
+            bounds_max_[i] = std::numeric_limits<int32_t>::min();
+        });
+    }
+
+    void ExpandBounds(const IndexType& index) {
+        detail::StaticFor<N>([&](auto i) {
+            bounds_min_[i] = std::min(bounds_min_[i], index[i]);
+            bounds_max_[i] = std::max(bounds_max_[i], index[i]);
+        });
+    }
+
+    /// @brief Offsets of the cell rows along the last axis that can intersect a ball of "half_size" cells radius 
+    /// centered anywhere in the central cell, the last axis offset is 0. Rows are in the same order as box probing.
+    /// Small radii are cached per thread, rows of larger ones are built in the buffer.
+    static const std::vector<IndexType>& BallRows(int32_t half_size, std::vector<IndexType>& buffer) {
+        constexpr double kMaxCachedRows = 1 << 12;
+        thread_local std::vector<std::vector<IndexType>> cache;
+        const size_t cache_idx = static_cast<size_t>(half_size);
+        if (cache_idx < cache.size() && !cache[cache_idx].empty()) {
+            return cache[cache_idx];
+        }
+        if (std::pow(2.0 * half_size + 1, N - 1) > kMaxCachedRows) {
+            FillBallRows(half_size, buffer);
+            return buffer;
+        }
+
+        if (cache.size() <= cache_idx) {
+            cache.resize(cache_idx + 1);
+        }
+        FillBallRows(half_size, cache[cache_idx]);
+        return cache[cache_idx];
+    }
+
+    static void FillBallRows(int32_t half_size, std::vector<IndexType>& rows) {
+        constexpr size_t kLast = N - 1;
+        IndexType offset;
+        detail::StaticFor<N>([&](auto i) {
+            offset[i] = i < kLast ? -half_size : 0;
+        });
+        while (true) {
+            // gap between the central cell and the row in cells
+            int64_t gap_sqr = 0;
+            detail::StaticFor<kLast>([&](auto i) {
+                const int64_t gap = std::max(std::abs(offset[i]) - 1, 0);
+                gap_sqr += gap * gap;
+            });
+            if (0 == gap_sqr || gap_sqr < int64_t(half_size) * half_size) {
+                rows.push_back(offset);
+            }
+
+            size_t axis = kLast;
+            while (axis > 0) {
+                --axis;
+                if (++offset[axis] <= half_size) {
+                    break;
+                }
+                offset[axis] = -half_size;
+            }
+            if (0 == axis && -half_size == offset[0]) {
+                break;
+            }
+        }
+    }
+
+    /// @brief Visit populated cells inside the box by iteration over the whole table, used for boxes larger than the table
+    template<typename Visitor>
+    void ScanCells(const IndexType& corner_min, const IndexType& corner_max, Visitor& visitor) const {
+        size_t hits = 0;
+        size_t candidates = 0;
+        for(const auto& cell : table_) {
+            const IndexType& index = cell.first;
+            bool is_inside = true;
+            detail::StaticFor<N>([&](auto i) {
+                is_inside = is_inside && corner_min[i] <= index[i] && index[i] <= corner_max[i];
+            });
+            if (is_inside) {
+                ++hits;
+                candidates += cell.second.size();
+                visitor(index, cell.second);
+            }
+        }
+        counters_.OnProbes(table_.size(), hits, candidates);
+    }
+
+    /// @brief Nested loop over box axes, axis "D" is iterated by the D-th loop, the last axis is innermost
+    template<size_t D, typename Visitor>
+    void ProbeBox(IndexType& grid_point, const IndexType& corner_min, const IndexType& corner_max,
+        Visitor& visitor, size_t& hits, size_t& candidates) const {
+        // bounds are copied, visitors writing references could alias them
+        const int32_t begin = corner_min[D];
+        const int32_t end = corner_max[D];
+        for(int32_t i = begin; i <= end; ++i) {
+            grid_point[D] = i;
+            if constexpr (D + 1 < N) {
+                ProbeBox<D + 1>(grid_point, corner_min, corner_max, visitor, hits, candidates);
+            } else {
+                auto itr = table_.find(grid_point);
+                if(table_.end() == itr) {
+                    continue;
+                }
+                ++hits;
+                candidates += itr->second.size();
+                visitor(static_cast<const IndexType&>(grid_point), itr->second);
+            }
+        }
+    }
+};
+
+/// @brief Base class for 4D (space-time) spatial hash table, all axes share one cell size
+template<typename DataType, typename RefType, typename ContainerType, typename MapBackend = StdHashMapBackend,
+    typename CountersType = NullCounters>
+using SpatialHashTable4D = SpatialHashTable<4, DataType, RefType, ContainerType, MapBackend, CountersType>;
+
+}
@@ -0,0 +1,117 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include "spatial_hash/SpatialHashND.h"
+#include "spatial_hash/Containers.h"
+#include <utility>
+
+namespace libs::spatial_hash {
+
+/// @brief N dimensional spatial hash table with vector container.
+/// @tparam N - number of dimensions (2, 3, 4)
+/// @tparam DataType - space data type (float, double)
+/// @tparam RefType - associated data type
+/// @tparam MapBackend - hash table backend (StdHashMapBackend, FlatHashMapBackend)
+/// @tparam CountersType - hot path counters policy (NullCounters, AtomicCounters)
+template<size_t N, typename DataType, typename RefType, typename MapBackend = StdHashMapBackend, typename CountersType = NullCounters>
+class SpatialHashTableVector : public SpatialHashTable<N, DataType, RefType, ContainerVector<RefType>, MapBackend, CountersType> {
+public:
+    using CellType = ContainerVector<RefType>;
+    using BaseClass = SpatialHashTable<N, DataType, RefType, ContainerVector<RefType>, MapBackend, CountersType>;
+    using IndexType = typename BaseClass::IndexType;
+    using HashTableType = typename BaseClass::HashTableType;
+public:
+    SpatialHashTableVector() : BaseClass() {}
+    SpatialHashTableVector(DataType cell_size) : BaseClass(cell_size) {}
+
+    /// @brief Returns data for specific cell index
+    /// @param index - cell index
+    /// @return cell references
+    std::vector<RefType> GetCellData(const IndexType& index) const {
+        std::vector<RefType> result;
+        auto cell = BaseClass::GetCell(index);
+        if (cell) {
+            result.insert(result.end(), cell->begin(), cell->end());
+        }
+        return result;
+    }
+
+    /// @brief Visit all data references in specified box. Box parameters in discrete hash table space.
+    /// @param center - central cell
+    /// @param half_size - half box size
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInBox(const IndexType& center, int32_t half_size, Visitor&& visitor) const {
+        BaseClass::ForEachCellInBox(center, half_size, [&visitor](const IndexType&, const CellType& cell) {
+            for(const RefType& ref : cell) {
+                visitor(ref);
+            }
+        });
+    }
+
+    /// @brief Visit all data references in specified box. Box parameters in discrete hash table space.
+    /// @param corner_min - first diagonal cell
+    /// @param corner_max - second diagonal cell
+    /// @param visitor - callable with (const RefType&) argument
+    template<typename Visitor>
+    void ForEachInBox(const IndexType& corner_min, const IndexType& corner_max, Visitor&& visitor) const {
+        BaseClass::ForEachCellInBox(corner_min, corner_max, [&visitor](const IndexType&, const CellType& cell) {
+            for(const RefType& ref : cell) {
+                visitor(ref);
+            }
+        });
+    }
+
+    /// @brief Append all data references in specified box to caller owned buffer. Box parameters in R^N space.
+    /// @param center - central point
+    /// @param half_size - half box size
+    /// @param result - output buffer, references are appended
+    void BoxSearch(const DataType center[N], DataType half_size, std::vector<RefType>& result) const {
+        const int32_t half_size_i = half_size * BaseClass::GetInvCellSize();
+        BaseClass::ForEachCellInBox(BaseClass::GetCellIndex(center), half_size_i, [&result](const IndexType&, const CellType& cell) {
+            result.insert(result.end(), cell.begin(), cell.end());
+        });
+    }
+
+    /// @brief Append all data references in specified box to caller owned buffer. Box parameters in R^N space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point
+    /// @param result - output buffer, references are appended
+    void BoxSearch(const DataType corner_min[N], const DataType corner_max[N], std::vector<RefType>& result) const {
+        BaseClass::ForEachCellInBox(BaseClass::GetCellIndex(corner_min), BaseClass::GetCellIndex(corner_max),
+            [&result](const IndexType&, const CellType& cell) {
+                result.insert(result.end(), cell.begin(), cell.end());
+            });
+    }
+
+    /// @brief Search all data references in specified box. Box parameters in R^N space.
+    /// @param center - central point
+    /// @param half_size - half box size
+    /// @return all data references in box
+    std::vector<RefType> BoxSearch(const DataType center[N], DataType half_size) const {
+        std::vector<RefType> result;
+        BoxSearch(center, half_size, result);
+        return result;
+    }
+
+    /// @brief Search all data references in specified box. Box parameters in R^N space.
+    /// @param corner_min - first diagonal point
+    /// @param corner_max - second diagonal point
+    /// @return all data references in box
+    std::vector<RefType> BoxSearch(const DataType corner_min[N], const DataType corner_max[N]) const {
+        std::vector<RefType> result;
+        BoxSearch(corner_min, corner_max, result);
+        return result;
+    }
+};
+
+/// @brief 4D (space-time) spatial hash table with vector container.
+/// All axes share one cell size, time has to be scaled to space units, e.g. t * cell_size / time_step.
+/// Keys have 16 bits per axis, cells out of [-32768, 32767] range share keys and collide in the hash.
+template<typename DataType, typename RefType, typename MapBackend = StdHashMapBackend, typename CountersType = NullCounters>
+using SpatialHashTable4DVector = SpatialHashTableVector<4, DataType, RefType, MapBackend, CountersType>;
+
+}
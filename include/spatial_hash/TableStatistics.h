@@ -0,0 +1,46 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+namespace libs::spatial_hash {
+
+/// @brief Occupancy statistics of spatial hash table.
+struct TableStatistics {
+    /// @brief Number of populated cells
+    size_t cell_count_ = 0;
+    /// @brief Number of stored references
+    size_t ref_count_ = 0;
+    /// @brief Largest number of references in one cell
+    size_t max_cell_size_ = 0;
+    /// @brief Mean number of references per populated cell
+    double mean_cell_size_ = 0;
+    /// @brief histogram_[i] - number of cells with i references, the last bin also counts larger cells
+    std::vector<size_t> histogram_;
+    /// @brief Populated cells per hash table slot
+    double load_factor_ = 0;
+    /// @brief Approximate memory footprint in bytes, hash table and cell containers
+    size_t memory_bytes_ = 0;
+
+    /// @brief Accumulate one populated cell
+    void AddCell(size_t cell_size) {
+        ++cell_count_;
+        ref_count_ += cell_size;
+        max_cell_size_ = std::max(max_cell_size_, cell_size);
+        if (!histogram_.empty()) {
+            ++histogram_[std::min(cell_size, histogram_.size() - 1)];
+        }
+    }
+
+    /// @brief Compute values derived from the accumulated cells
+    void Finalize() {
+        mean_cell_size_ = cell_count_ ? static_cast<double>(ref_count_) / cell_count_ : 0.0;
+    }
+};
+
+}
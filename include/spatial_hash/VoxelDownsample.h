@@ -0,0 +1,253 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include "spatial_hash/SpatialHashND.h"
+#include "spatial_hash/FlatHashMap.h"
+#include "spatial_hash/Parallel.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace libs::spatial_hash {
+
+/// @brief Voxel representative point
+enum class DownsampleMode {
+    kCentroid,        // mean of voxel points
+    kFirst,           // the first voxel point in input order
+    kNearestToCenter, // voxel point nearest to the voxel center, the first one of equally distant points
+};
+
+namespace detail {
+
+/// @brief Voxel accumulator, references are not stored
+template<typename DataType>
+struct DownsampleVoxel {
+    double sum_[3] = {0, 0, 0};
+    uint32_t count_ = 0;
+    /// @brief The first point index, defines output order
+    uint32_t first_ = 0;
+    /// @brief Index of the point nearest to the voxel center
+    uint32_t best_ = 0;
+    DataType best_dist_ = 0;
+};
+
+template<typename DataType>
+using DownsampleMap = FlatHashMap<HashIndex3D, DownsampleVoxel<DataType>, SpatalHash3D>;
+
+/// @brief Voxel index of the point, the same as table GetVoxelIndex
+template<typename DataType>
+inline HashIndex3D DownsampleVoxelIndex(const DataType* point, DataType inv_voxel_size) {
+    return HashIndex3D(static_cast<int32_t>(std::floor(point[0] * inv_voxel_size)),
+        static_cast<int32_t>(std::floor(point[1] * inv_voxel_size)), static_cast<int32_t>(std::floor(point[2] * inv_voxel_size)));
+}
+
+/// @brief Partition of the voxel, keys are mixed differently from the map home position, so voxels of one partition stay spread in its map
+inline size_t DownsamplePartition(const HashIndex3D& index, size_t partition_count) {
+    uint64_t key = SpatalHash3D()(index);
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    return static_cast<size_t>(((key & 0xffffffffull) * partition_count) >> 32);
+}
+
+/// @brief Accumulates points order[begin, end) into the voxel map, point indices have to be increasing
+/// @param order - point indices, nullptr - identity
+template<DownsampleMode Mode, typename DataType>
+void AccumulateVoxels(const DataType* points, const uint32_t* order, size_t begin, size_t end, DataType voxel_size,
+    DownsampleMap<DataType>& voxels) {
+    const DataType inv_voxel_size = DataType(1) / voxel_size;
+    for(size_t j = begin; j < end; ++j) {
+        const size_t i = order ? order[j] : j;
+        const DataType* point = points + 3 * i;
+        const DataType x = std::floor(point[0] * inv_voxel_size);
+        const DataType y = std::floor(point[1] * inv_voxel_size);
+        const DataType z = std::floor(point[2] * inv_voxel_size);
+        DownsampleVoxel<DataType>& voxel = voxels[HashIndex3D(static_cast<int32_t>(x), static_cast<int32_t>(y), static_cast<int32_t>(z))];
+        if (0 == voxel.count_) {
+            voxel.first_ = static_cast<uint32_t>(i);
+        }
+        ++voxel.count_;
+
+        if constexpr (DownsampleMode::kCentroid == Mode) {
+            voxel.sum_[0] += point[0];
+            voxel.sum_[1] += point[1];
+            voxel.sum_[2] += point[2];
+        } else if constexpr (DownsampleMode::kNearestToCenter == Mode) {
+            const DataType dx = point[0] - (x + DataType(0.5)) * voxel_size;
+            const DataType dy = point[1] - (y + DataType(0.5)) * voxel_size;
+            const DataType dz = point[2] - (z + DataType(0.5)) * voxel_size;
+            const DataType dist = dx * dx + dy * dy + dz * dz;
+            if (1 == voxel.count_ || dist < voxel.best_dist_) {
+                voxel.best_ = static_cast<uint32_t>(i);
+                voxel.best_dist_ = dist;
+            }
+        }
+    }
+}
+
+/// @brief Accumulates voxels partitioned by key hash, every thread owns one partition, so partition maps are not merged.
+/// Points are scattered to partitions by a stable counting sort of contiguous chunks, every partition is accumulated
+/// in input order, so results are the same for any number of threads. Voxels are emitted ordered by the first point index,
+/// positions are found by parallel prefix count of the first points, a single partition is sorted instead.
+/// @param on_count - callable with (size_t voxel_count) argument, called once before on_voxel calls
+/// @param on_voxel - callable with (size_t position, const DownsampleVoxel<DataType>& voxel) arguments, called in parallel
+template<typename DataType, typename CountFn, typename VoxelFn>
+void DownsampleVoxels(const DataType* points, size_t count, DataType voxel_size, DownsampleMode mode, size_t num_threads,
+    CountFn&& on_count, VoxelFn&& on_voxel) {
+    num_threads = GetThreadCount(num_threads, count, 1 << 16);
+    const size_t partition_count = num_threads;
+    const DataType inv_voxel_size = DataType(1) / voxel_size;
+
+    // stable scatter of point indices to partitions, partition p is order[partition_begin[p], partition_begin[p + 1])
+    std::vector<uint16_t> partitions;
+    std::vector<uint32_t> order;
+    std::vector<size_t> partition_begin(partition_count + 1, 0);
+    partition_begin[partition_count] = count;
+    if (partition_count > 1) {
+        partitions.resize(count);
+        order.resize(count);
+        std::vector<size_t> offsets(num_threads * partition_count, 0);
+        ParallelFor(count, num_threads, [&](size_t thread_idx, size_t begin, size_t end) {
+            size_t* histogram = &offsets[thread_idx * partition_count];
+            for(size_t i = begin; i < end; ++i) {
+                const size_t partition = DownsamplePartition(DownsampleVoxelIndex(points + 3 * i, inv_voxel_size), partition_count);
+                partitions[i] = static_cast<uint16_t>(partition);
+                ++histogram[partition];
+            }
+        });
+
+        size_t offset = 0;
+        for(size_t p = 0; p < partition_count; ++p) {
+            partition_begin[p] = offset;
+            for(size_t t = 0; t < num_threads; ++t) {
+                const size_t partition_size = offsets[t * partition_count + p];
+                offsets[t * partition_count + p] = offset;
+                offset += partition_size;
+            }
+        }
+
+        ParallelFor(count, num_threads, [&](size_t thread_idx, size_t begin, size_t end) {
+            size_t* position = &offsets[thread_idx * partition_count];
+            for(size_t i = begin; i < end; ++i) {
+                order[position[partitions[i]]++] = static_cast<uint32_t>(i);
+            }
+        });
+    }
+
+    std::vector<DownsampleMap<DataType>> maps(partition_count);
+    std::vector<uint8_t> is_first(partition_count > 1 ? count : 0, 0);
+    ParallelFor(partition_count, partition_count, [&](size_t, size_t p, size_t) {
+        const uint32_t* partition_order = order.empty() ? nullptr : order.data();
+        const size_t begin = partition_begin[p];
+        const size_t end = partition_begin[p + 1];
+        switch (mode) {
+            case DownsampleMode::kCentroid:
+                AccumulateVoxels<DownsampleMode::kCentroid>(points, partition_order, begin, end, voxel_size, maps[p]);
+                break;
+            case DownsampleMode::kFirst:
+                AccumulateVoxels<DownsampleMode::kFirst>(points, partition_order, begin, end, voxel_size, maps[p]);
+                break;
+            case DownsampleMode::kNearestToCenter:
+                AccumulateVoxels<DownsampleMode::kNearestToCenter>(points, partition_order, begin, end, voxel_size, maps[p]);
+                break;
+        }
+        if (partition_count > 1) {
+            for(const auto& voxel : maps[p]) {
+                is_first[voxel.second.first_] = 1;
+            }
+        }
+    });
+
+    if (1 == partition_count) {
+        std::vector<const DownsampleVoxel<DataType>*> voxels;
+        voxels.reserve(maps[0].size());
+        for(const auto& voxel : maps[0]) {
+            voxels.push_back(&voxel.second);
+        }
+        std::sort(voxels.begin(), voxels.end(),
+            [](const DownsampleVoxel<DataType>* a, const DownsampleVoxel<DataType>* b) { return a->first_ < b->first_; });
+        on_count(voxels.size());
+        for(size_t i = 0; i < voxels.size(); ++i) {
+            on_voxel(i, *voxels[i]);
+        }
+        return;
+    }
+
+    // output position of the voxel is the number of first points before its first point
+    std::vector<size_t> chunk_begin(num_threads + 1, 0);
+    ParallelFor(count, num_threads, [&](size_t thread_idx, size_t begin, size_t end) {
+        chunk_begin[thread_idx + 1] = std::count(is_first.begin() + begin, is_first.begin() + end, 1);
+    });
+    for(size_t t = 0; t < num_threads; ++t) {
+        chunk_begin[t + 1] += chunk_begin[t];
+    }
+    on_count(chunk_begin[num_threads]);
+
+    ParallelFor(count, num_threads, [&](size_t thread_idx, size_t begin, size_t end) {
+        size_t position = chunk_begin[thread_idx];
+        for(size_t i = begin; i < end; ++i) {
+            if (!is_first[i]) {
+                continue;
+            }
+            const HashIndex3D index = DownsampleVoxelIndex(points + 3 * i, inv_voxel_size);
+            const DownsampleMap<DataType>& voxels = maps[partitions[i]];
+            on_voxel(position++, voxels.find(index)->second);
+        }
+    });
+}
+
+}
+
+/// @brief Reduces every occupied voxel of the 3D cloud to one point without building a spatial hash table.
+/// Voxels are partitioned by key hash across threads, voxels keep only running sums and indices.
+/// Output points are ordered by the first point of the voxel in input order, the result doesn't depend on number of threads.
+/// @param points - array of "count" 3D points (x, y, z)
+/// @param count - number of points, less than 2^32
+/// @param voxel_size - voxel size
+/// @param mode - voxel representative point
+/// @param num_threads - number of threads, 0 - hardware concurrency
+/// @return array of downsampled 3D points (x, y, z)
+template<typename DataType>
+std::vector<DataType> VoxelDownsample3D(const DataType* points, size_t count, DataType voxel_size,
+    DownsampleMode mode = DownsampleMode::kCentroid, size_t num_threads = 1) {
+    std::vector<DataType> result;
+    detail::DownsampleVoxels(points, count, voxel_size, mode, num_threads,
+        [&result](size_t voxel_count) { result.resize(3 * voxel_count); },
+        [&](size_t position, const detail::DownsampleVoxel<DataType>& voxel) {
+            DataType* point = result.data() + 3 * position;
+            if (DownsampleMode::kCentroid == mode) {
+                point[0] = static_cast<DataType>(voxel.sum_[0] / voxel.count_);
+                point[1] = static_cast<DataType>(voxel.sum_[1] / voxel.count_);
+                point[2] = static_cast<DataType>(voxel.sum_[2] / voxel.count_);
+            } else {
+                const DataType* src = points + 3 * static_cast<size_t>(DownsampleMode::kFirst == mode ? voxel.first_ : voxel.best_);
+                std::copy(src, src + 3, point);
+            }
+        });
+    return result;
+}
+
+/// @brief Returns indices of voxel representative points, the same voxels and order as VoxelDownsample3D.
+/// @param points - array of "count" 3D points (x, y, z)
+/// @param count - number of points, less than 2^32
+/// @param voxel_size - voxel size
+/// @param mode - kFirst or kNearestToCenter, kCentroid returns the first point indices
+/// @param num_threads - number of threads, 0 - hardware concurrency
+/// @return point indices, one per occupied voxel
+template<typename DataType>
+std::vector<uint32_t> VoxelDownsampleIndices3D(const DataType* points, size_t count, DataType voxel_size,
+    DownsampleMode mode = DownsampleMode::kFirst, size_t num_threads = 1) {
+    std::vector<uint32_t> result;
+    detail::DownsampleVoxels(points, count, voxel_size, mode, num_threads,
+        [&result](size_t voxel_count) { result.resize(voxel_count); },
+        [&](size_t position, const detail::DownsampleVoxel<DataType>& voxel) {
+            result[position] = DownsampleMode::kNearestToCenter == mode ? voxel.best_ : voxel.first_;
+        });
+    return result;
+}
+
+}
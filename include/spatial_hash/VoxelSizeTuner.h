@@ -0,0 +1,186 @@
+/// BSD 3-Clause License
+/// Copyright (c) 2023, Sergey Chechkin
+/// Autor: Sergey Chechkin, schechkin@gmail.com
+
+#pragma once
+
+#include "spatial_hash/SpatialHash2DVector.h"
+#include "spatial_hash/SpatialHash3DCompact.h"
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+namespace libs::spatial_hash {
+
+/// @brief Cost model weights and sampling limits of voxel size tuner.
+struct VoxelSizeTunerOptions {
+    /// @brief Relative cost of one cell lookup, populated or empty
+    double probe_cost_ = 1.0;
+    /// @brief Relative cost of one candidate reference check
+    double candidate_cost_ = 0.25;
+    /// @brief Sample cloud is reduced to this number of points
+    size_t max_sample_size_ = 50000;
+    /// @brief Number of query centers taken from the sample
+    size_t query_count_ = 256;
+};
+
+/// @brief Expected query cost for one voxel size.
+template<typename DataType>
+struct VoxelSizeEstimate {
+    DataType voxel_size_ = 0;
+    /// @brief Mean number of probed cells per query
+    double cells_per_query_ = 0;
+    /// @brief Mean number of candidate references per query, scaled to the full cloud
+    double candidates_per_query_ = 0;
+    /// @brief probe_cost * cells + candidate_cost * candidates
+    double cost_ = 0;
+};
+
+/// @brief Default candidate voxel sizes, query_radius / 16 .. 4 * query_radius with sqrt(2) step
+template<typename DataType>
+std::vector<DataType> DefaultVoxelSizeCandidates(DataType query_radius) {
+    std::vector<DataType> result;
+    for(int i = -8; i <= 4; ++i) {
+        result.push_back(static_cast<DataType>(query_radius * std::pow(2.0, 0.5 * i)));
+    }
+    return result;
+}
+
+namespace detail {
+
+/// @brief Every "step" point of the cloud, step keeps the sample below max_sample_size
+template<typename DataType, int Dim>
+std::vector<DataType> SampleCloud(const DataType* points, size_t count, size_t max_sample_size) {
+    const size_t step = max_sample_size ? (count + max_sample_size - 1) / max_sample_size : 1;
+    std::vector<DataType> result;
+    result.reserve(Dim * (count / step + 1));
+    for(size_t i = 0; i < count; i += step) {
+        result.insert(result.end(), points + Dim * i, points + Dim * (i + 1));
+    }
+    return result;
+}
+
+/// @brief Runs the queries of radius search bounding cube footprint, an upper bound of sphere culled search cost,
+/// on each candidate voxel size and measures probed cells and candidates.
+/// @param search_fn - callable with (DataType voxel_size, const std::vector<DataType>& sample, size_t query_step,
+/// int32_t half_size, size_t& candidates), returns number of queries
+template<typename DataType, int Dim, typename SearchFn>
+std::vector<VoxelSizeEstimate<DataType>> EstimateVoxelSizes(const DataType* points, size_t count, DataType query_radius,
+    const std::vector<DataType>& candidates, const VoxelSizeTunerOptions& options, SearchFn&& search_fn) {
+    std::vector<VoxelSizeEstimate<DataType>> result;
+    if (0 == count) {
+        return result;
+    }
+
+    const std::vector<DataType> sample = SampleCloud<DataType, Dim>(points, count, options.max_sample_size_);
+    const size_t sample_size = sample.size() / Dim;
+    const size_t query_step = std::max<size_t>(1, sample_size / std::max<size_t>(1, options.query_count_));
+    const double density_scale = static_cast<double>(count) / sample_size;
+
+    for(DataType voxel_size : candidates) {
+        VoxelSizeEstimate<DataType> estimate;
+        estimate.voxel_size_ = voxel_size;
+        const int32_t half_size = static_cast<int32_t>(std::ceil(query_radius / voxel_size));
+        size_t candidate_count = 0;
+        const size_t query_count = search_fn(voxel_size, sample, query_step, half_size, candidate_count);
+        estimate.cells_per_query_ = std::pow(2.0 * half_size + 1, Dim);
+        estimate.candidates_per_query_ = density_scale * candidate_count / query_count;
+        estimate.cost_ = options.probe_cost_ * estimate.cells_per_query_ + options.candidate_cost_ * estimate.candidates_per_query_;
+        result.push_back(estimate);
+    }
+    return result;
+}
+
+template<typename DataType>
+const VoxelSizeEstimate<DataType>* FindBestEstimate(const std::vector<VoxelSizeEstimate<DataType>>& estimates) {
+    const VoxelSizeEstimate<DataType>* best = nullptr;
+    for(const auto& estimate : estimates) {
+        if (nullptr == best || estimate.cost_ < best->cost_) {
+            best = &estimate;
+        }
+    }
+    return best;
+}
+
+}
+
+/// @brief Estimates expected radius query cost for candidate voxel sizes on a sample 3D cloud.
+/// Query centers are taken from the cloud, so cost reflects populated regions.
+/// @param points - array of "count" 3D points (x, y, z)
+/// @param count - number of points
+/// @param query_radius - expected query radius
+/// @param candidates - candidate voxel sizes
+/// @param options - cost model and sampling options
+/// @return estimates in candidates order
+template<typename DataType>
+std::vector<VoxelSizeEstimate<DataType>> EstimateVoxelSizes3D(const DataType* points, size_t count, DataType query_radius,
+    const std::vector<DataType>& candidates, const VoxelSizeTunerOptions& options = VoxelSizeTunerOptions()) {
+    return detail::EstimateVoxelSizes<DataType, 3>(points, count, query_radius, candidates, options,
+        [](DataType voxel_size, const std::vector<DataType>& sample, size_t query_step, int32_t half_size, size_t& candidate_count) {
+            const size_t sample_size = sample.size() / 3;
+            SpatialHashTable3DCompact<DataType, uint32_t> table(voxel_size);
+            table.Build(sample.data(), sample_size);
+            size_t query_count = 0;
+            for(size_t i = 0; i < sample_size; i += query_step, ++query_count) {
+                table.ForEachInCube(table.GetVoxelIndex(sample.data() + 3 * i), half_size,
+                    [&candidate_count](const uint32_t&) { ++candidate_count; });
+            }
+            return query_count;
+        });
+}
+
+/// @brief Recommends voxel size with minimal expected radius query cost for the 3D cloud.
+/// @param points - array of "count" 3D points (x, y, z)
+/// @param count - number of points
+/// @param query_radius - expected query radius
+/// @param options - cost model and sampling options
+/// @return recommended voxel size, query_radius for empty cloud
+template<typename DataType>
+DataType TuneVoxelSize3D(const DataType* points, size_t count, DataType query_radius,
+    const VoxelSizeTunerOptions& options = VoxelSizeTunerOptions()) {
+    const auto estimates = EstimateVoxelSizes3D(points, count, query_radius, DefaultVoxelSizeCandidates(query_radius), options);
+    const auto* best = detail::FindBestEstimate(estimates);
+    return best ? best->voxel_size_ : query_radius;
+}
+
+/// @brief Estimates expected radius query cost for candidate cell sizes on a sample 2D cloud.
+/// @param points - array of "count" 2D points (x, y)
+/// @param count - number of points
+/// @param query_radius - expected query radius
+/// @param candidates - candidate cell sizes
+/// @param options - cost model and sampling options
+/// @return estimates in candidates order
+template<typename DataType>
+std::vector<VoxelSizeEstimate<DataType>> EstimateCellSizes2D(const DataType* points, size_t count, DataType query_radius,
+    const std::vector<DataType>& candidates, const VoxelSizeTunerOptions& options = VoxelSizeTunerOptions()) {
+    return detail::EstimateVoxelSizes<DataType, 2>(points, count, query_radius, candidates, options,
+        [](DataType cell_size, const std::vector<DataType>& sample, size_t query_step, int32_t half_size, size_t& candidate_count) {
+            const size_t sample_size = sample.size() / 2;
+            SpatialHashTable2DVector<DataType, uint32_t, FlatHashMapBackend> table(cell_size);
+            for(size_t i = 0; i < sample_size; ++i) {
+                table.Add(sample.data() + 2 * i, static_cast<uint32_t>(i));
+            }
+            size_t query_count = 0;
+            for(size_t i = 0; i < sample_size; i += query_step, ++query_count) {
+                table.ForEachInSquare(table.GetCellIndex(sample.data() + 2 * i), half_size,
+                    [&candidate_count](const uint32_t&) { ++candidate_count; });
+            }
+            return query_count;
+        });
+}
+
+/// @brief Recommends cell size with minimal expected radius query cost for the 2D cloud.
+/// @param points - array of "count" 2D points (x, y)
+/// @param count - number of points
+/// @param query_radius - expected query radius
+/// @param options - cost model and sampling options
+/// @return recommended cell size, query_radius for empty cloud
+template<typename DataType>
+DataType TuneCellSize2D(const DataType* points, size_t count, DataType query_radius,
+    const VoxelSizeTunerOptions& options = VoxelSizeTunerOptions()) {
+    const auto estimates = EstimateCellSizes2D(points, count, query_radius, DefaultVoxelSizeCandidates(query_radius), options);
+    const auto* best = detail::FindBestEstimate(estimates);
+    return best ? best->voxel_size_ : query_radius;
+}
+
+}
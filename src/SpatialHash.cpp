@@ -3,4 +3,16 @@
 /// Autor: Sergey Chechkin, schechkin@gmail.com 
 
 #include "spatial_hash/SpatialHash2DVector.h"
-#include "spatial_hash/SpatialHash3DVector.h"
\ No newline at end of file
+#include "spatial_hash/SpatialHash2DHeap.h"
+#include "spatial_hash/SpatialHash3DVector.h"
+#include "spatial_hash/SpatialHash3DPoints.h"
+#include "spatial_hash/SpatialHash3DSmallVector.h"
+#include "spatial_hash/SpatialHash3DHeap.h"
+#include "spatial_hash/SpatialHash3DRolling.h"
+#include "spatial_hash/SpatialHash3DPyramid.h"
+#include "spatial_hash/SpatialHashNDVector.h"
+#include "spatial_hash/SpatialHash3DCompact.h"
+#include "spatial_hash/ConcurrentSpatialHash3D.h"
+#include "spatial_hash/BatchSearch.h"
+#include "spatial_hash/VoxelSizeTuner.h"
+#include "spatial_hash/VoxelDownsample.h"
@@ -3,10 +3,30 @@
 /// Autor: Sergey Chechkin, schechkin@gmail.com 
 
 #include "spatial_hash/SpatialHash2DVector.h"
+#include "spatial_hash/SpatialHash2DHeap.h"
 #include "spatial_hash/SpatialHash3DVector.h"
+#include "spatial_hash/SpatialHash3DPoints.h"
+#include "spatial_hash/SpatialHash3DSmallVector.h"
+#include "spatial_hash/SpatialHash3DHeap.h"
+#include "spatial_hash/SpatialHash3DRolling.h"
+#include "spatial_hash/SpatialHash3DPyramid.h"
+#include "spatial_hash/SpatialHashNDVector.h"
+#include "spatial_hash/SpatialHash3DCompact.h"
+#include "spatial_hash/ConcurrentSpatialHash3D.h"
+#include "spatial_hash/BatchSearch.h"
+#include "spatial_hash/FlatHashMap.h"
+#include "spatial_hash/VoxelSizeTuner.h"
+#include "spatial_hash/VoxelDownsample.h"
 #include <Eigen/Core>
 #include <gtest/gtest.h>
 #include <random>
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <cstdio>
 
 using namespace libs::spatial_hash;
 
@@ -71,6 +91,86 @@ TEST(SpatialHashTable2DVector, RandomCircleTest) {
     ASSERT_EQ(size, result.size());
 }
 
+TEST(SpatialHashTable2DVector, VisitorSearchTest) { 
+    SpatialHashTable2DVector<float, size_t> hash_table(1);
+
+    std::default_random_engine rng;
+    std::uniform_real_distribution urd(-50.0f, 50.0f);
+
+    size_t size = 10000;
+    for(size_t i = 0; i < size; ++i) {
+        float point[2] = {urd(rng), urd(rng)};
+        hash_table.Add(point, i);
+    }
+
+    float center[2] = {5, -5};
+    auto expected = hash_table.SquareSearch(center, 10.0f);
+
+    std::vector<size_t> visited;
+    hash_table.ForEachInSquare(center, 10.0f, [&visited](size_t ref) { visited.push_back(ref); });
+    ASSERT_EQ(expected, visited);
+
+    std::vector<size_t> buffer = {size};
+    hash_table.SquareSearch(center, 10.0f, buffer);
+    ASSERT_EQ(expected.size() + 1, buffer.size());
+    ASSERT_TRUE(std::equal(expected.begin(), expected.end(), buffer.begin() + 1));
+
+    float centers[4] = {5, -5, 20, 20};
+    BatchSearchResult<size_t> batch_result;
+    BatchSquareSearch(hash_table, centers, 2, 10.0f, 2, batch_result);
+    ASSERT_EQ(2, batch_result.Size());
+    ASSERT_EQ(expected, std::vector<size_t>(batch_result.Begin(0), batch_result.End(0)));
+    ASSERT_EQ(hash_table.SquareSearch(centers + 2, 10.0f).size(), batch_result.Count(1));
+}
+
+TEST(SpatialHashTable2DVector, KNearestTest) { 
+    std::vector<Eigen::Vector2f> points;
+    std::default_random_engine rng;
+    std::normal_distribution<float> nd(0.0f, 20.0f);
+    for(int i = 0; i < 5000; ++i) {
+        points.emplace_back(nd(rng), nd(rng));
+    }
+
+    SpatialHashTable2DVector<float, size_t> hash_table(1.0f);
+    for(size_t i = 0; i < points.size(); ++i) {
+        hash_table.Add(points[i].data(), i);
+    }
+
+    auto accessor = [&points](size_t idx) { return points[idx].data(); };
+    for(const Eigen::Vector2f& query : {Eigen::Vector2f(0, 0), Eigen::Vector2f(55.5f, -70.0f)}) {
+        auto result = hash_table.KNearest(query.data(), 7, accessor);
+
+        std::vector<size_t> expected(points.size());
+        std::iota(expected.begin(), expected.end(), 0);
+        std::sort(expected.begin(), expected.end(), [&](size_t a, size_t b) {
+            return (points[a] - query).squaredNorm() < (points[b] - query).squaredNorm();
+        });
+        expected.resize(7);
+        ASSERT_EQ(expected, result);
+    }
+    ASSERT_TRUE(hash_table.KNearest(points[0].data(), 0, accessor).empty());
+    ASSERT_EQ(points.size(), hash_table.KNearest(points[0].data(), points.size() + 1, accessor).size());
+}
+
+TEST(SpatialHashTable2DVector, RemoveMoveTest) { 
+    SpatialHashTable2DVector<float, size_t> hash_table(1.0f);
+    float p1[2] = {0.5f, 0.5f};
+    float p2[2] = {0.7f, 0.2f};
+    float p3[2] = {5.5f, 5.5f};
+    hash_table.Add(p1, 1);
+    hash_table.Add(p1, 2);
+
+    ASSERT_TRUE(hash_table.Move(p1, p2, 1));
+    ASSERT_EQ(2, hash_table.GetCellData(hash_table.GetCellIndex(p1)).size());
+    ASSERT_TRUE(hash_table.Move(p1, p3, 1));
+    ASSERT_EQ(std::vector<size_t>{2}, hash_table.GetCellData(hash_table.GetCellIndex(p1)));
+    ASSERT_EQ(std::vector<size_t>{1}, hash_table.GetCellData(hash_table.GetCellIndex(p3)));
+    ASSERT_FALSE(hash_table.Move(p1, p3, 1));
+
+    ASSERT_TRUE(hash_table.Remove(p1, 2));
+    ASSERT_EQ(1, hash_table.GetTable().size());
+}
+
 TEST(SpatialHashTable3DVector, SingleVoxelTest) { 
     SpatialHashTable3DVector<float, size_t> hash_table(10);
     float point[3] = {0, 0, 0};
@@ -103,6 +203,105 @@ TEST(SpatialHashTable3DVector, RandomCubeTest) {
     ASSERT_EQ(size, result.size());
 }
 
+TEST(FlatHashMap, RandomInsertEraseTest) { 
+    FlatHashMap<HashIndex3D, int, SpatalHash3D> flat_map;
+    std::unordered_map<HashIndex3D, int, SpatalHash3D> std_map;
+
+    std::default_random_engine rng;
+    std::uniform_int_distribution<int32_t> idx_dst(-50, 50);
+    std::uniform_int_distribution<int> op_dst(0, 3);
+
+    for(int i = 0; i < 100000; ++i) {
+        HashIndex3D key(idx_dst(rng), idx_dst(rng), idx_dst(rng));
+        if (0 == op_dst(rng)) {
+            ASSERT_EQ(std_map.erase(key), flat_map.erase(key));
+        } else {
+            std_map[key] += i;
+            flat_map[key] += i;
+        }
+    }
+
+    ASSERT_EQ(std_map.size(), flat_map.size());
+    for(const auto& itr : std_map) {
+        auto flat_itr = flat_map.find(itr.first);
+        ASSERT_TRUE(flat_itr != flat_map.end());
+        ASSERT_EQ(itr.second, flat_itr->second);
+    }
+
+    size_t count = 0;
+    for(const auto& itr : flat_map) {
+        ASSERT_EQ(1, std_map.count(itr.first));
+        ++count;
+    }
+    ASSERT_EQ(std_map.size(), count);
+
+    flat_map.clear();
+    ASSERT_EQ(0, flat_map.size());
+    ASSERT_TRUE(flat_map.begin() == flat_map.end());
+}
+
+TEST(SpatialHashTable3DVector, FlatBackendTest) { 
+    SpatialHashTable3DVector<float, size_t> std_table(10);
+    SpatialHashTable3DVector<float, size_t, FlatHashMapBackend> flat_table(10);
+
+    float cube_size = 1000; 
+    std::default_random_engine rng;
+    std::uniform_real_distribution urd(0.0f, cube_size);
+
+    size_t size = 100000;
+    for(size_t i = 0; i < size; ++i) {
+        float point[3] = {urd(rng), urd(rng), urd(rng)};
+        std_table.Add(point, i);
+        flat_table.Add(point, i);
+    }
+
+    ASSERT_EQ(std_table.GetTable().size(), flat_table.GetTable().size());
+
+    float center[3] = {cube_size / 2, cube_size / 2, cube_size / 2};
+    auto std_result = std_table.CubeSearch(center, 100.0f);
+    auto flat_result = flat_table.CubeSearch(center, 100.0f);
+    std::sort(std_result.begin(), std_result.end());
+    std::sort(flat_result.begin(), flat_result.end());
+    ASSERT_EQ(std_result, flat_result);
+
+    float p1[3] = {0, 0, 0};
+    float p2[3] = {cube_size, cube_size, cube_size};
+    ASSERT_EQ(size, flat_table.CubeSearch(p1, p2).size());
+}
+
+TEST(SpatialHashTable3DVector, VisitorSearchTest) { 
+    SpatialHashTable3DVector<float, size_t> hash_table(1);
+
+    std::default_random_engine rng;
+    std::uniform_real_distribution urd(-20.0f, 20.0f);
+
+    size_t size = 100000;
+    for(size_t i = 0; i < size; ++i) {
+        float point[3] = {urd(rng), urd(rng), urd(rng)};
+        hash_table.Add(point, i);
+    }
+
+    float center[3] = {1, 2, 3};
+    auto expected = hash_table.CubeSearch(center, 3.0f);
+
+    std::vector<size_t> visited;
+    hash_table.ForEachInCube(center, 3.0f, [&visited](size_t ref) { visited.push_back(ref); });
+    ASSERT_EQ(expected, visited);
+
+    std::vector<size_t> buffer;
+    buffer.reserve(expected.size());
+    const size_t* data = buffer.data();
+    hash_table.CubeSearch(center, 3.0f, buffer);
+    ASSERT_EQ(expected, buffer);
+    ASSERT_EQ(data, buffer.data());
+
+    float p1[3] = {-5, -5, -5};
+    float p2[3] = {5, 5, 5};
+    size_t count = 0;
+    hash_table.ForEachInCube(p2, p1, [&count](size_t) { ++count; });
+    ASSERT_EQ(hash_table.CubeSearch(p1, p2).size(), count);
+}
+
 struct UnitSphereDistribution {
     Eigen::Vector3f operator()(std::default_random_engine& rng)
     {
@@ -163,6 +362,1492 @@ TEST(SpatialHashTable3DVector, RadiusSearchTest) {
     ASSERT_EQ(size_1, radius_search_result.size());
 }
 
+TEST(SpatialHashTable3DPoints, RadiusSearchTest) { 
+    std::vector<Eigen::Vector3d> point_cloud;
+
+    std::default_random_engine rng;
+    std::uniform_real_distribution urd(-10.0, 10.0);
+    for(int i = 0; i < 50000; ++i) {
+        point_cloud.emplace_back(urd(rng), urd(rng), urd(rng));
+    }
+
+    SpatialHashTable3DPoints<double, size_t> hash_table(0.5); 
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        hash_table.Add(point_cloud[i].data(), i);
+    }
+
+    for(double radius : {0.3, 1.0, 2.7}) {
+        Eigen::Vector3d center(0.1, -0.2, 0.3);
+        auto result = hash_table.RadiusSearch(center.data(), radius);
+        std::sort(result.begin(), result.end());
+
+        std::vector<size_t> expected;
+        for(size_t i = 0; i < point_cloud.size(); ++i) {
+            if ((point_cloud[i] - center).squaredNorm() < radius * radius) {
+                expected.push_back(i);
+            }
+        }
+        ASSERT_EQ(expected, result);
+
+        size_t count = 0;
+        hash_table.ForEachInRadius(center.data(), radius, [&](size_t idx, const double point[3]) {
+            ASSERT_EQ(point_cloud[idx].x(), point[0]);
+            ++count;
+        });
+        ASSERT_EQ(expected.size(), count);
+    }
+}
+
+TEST(SpatialHashTable3DVector, KNearestTest) { 
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::default_random_engine rng;
+    UnitSphereDistribution sphere;
+    std::uniform_real_distribution r_dst(0.0f, 10.0f);
+    for(int i = 0; i < 20000; ++i) {
+        // density decreases with distance from origin
+        point_cloud.push_back(r_dst(rng) * r_dst(rng) * sphere(rng));
+    }
+
+    SpatialHashTable3DVector<float, size_t> vector_table(0.5f);
+    SpatialHashTable3DPoints<float, size_t> points_table(0.5f);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        vector_table.Add(point_cloud[i].data(), i);
+        points_table.Add(point_cloud[i].data(), i);
+    }
+
+    auto accessor = [&point_cloud](size_t idx) { return point_cloud[idx].data(); };
+    for(const Eigen::Vector3f& query : {Eigen::Vector3f(0, 0, 0), Eigen::Vector3f(30, 40, -50), Eigen::Vector3f(200, 0, 0)}) {
+        std::vector<size_t> expected(point_cloud.size());
+        std::iota(expected.begin(), expected.end(), 0);
+        std::sort(expected.begin(), expected.end(), [&](size_t a, size_t b) {
+            return (point_cloud[a] - query).squaredNorm() < (point_cloud[b] - query).squaredNorm();
+        });
+        expected.resize(10);
+
+        std::vector<size_t> refs;
+        std::vector<float> sqr_distances;
+        vector_table.KNearest(query.data(), 10, accessor, refs, sqr_distances);
+        ASSERT_EQ(expected, refs);
+        ASSERT_TRUE(std::is_sorted(sqr_distances.begin(), sqr_distances.end()));
+        ASSERT_EQ(expected, points_table.KNearest(query.data(), 10));
+    }
+
+    SpatialHashTable3DPoints<float, size_t> small_table(1.0f);
+    float point[3] = {0, 0, 0};
+    small_table.Add(point, 0);
+    point[0] = 5;
+    small_table.Add(point, 1);
+    ASSERT_EQ(2, small_table.KNearest(point, 5).size());
+
+    // k == 0 and k > size return without walking shells up to the far corner of the data
+    for(const Eigen::Vector3f& query : {Eigen::Vector3f(0, 0, 0), Eigen::Vector3f(1.0e4f, 0, 0)}) {
+        ASSERT_TRUE(points_table.KNearest(query.data(), 0).empty());
+        std::vector<size_t> refs;
+        std::vector<float> sqr_distances;
+        vector_table.KNearest(query.data(), 0, accessor, refs, sqr_distances);
+        ASSERT_TRUE(refs.empty() && sqr_distances.empty());
+
+        // far distances have ties, so all points are compared as a set
+        std::vector<size_t> expected(point_cloud.size());
+        std::iota(expected.begin(), expected.end(), 0);
+        vector_table.KNearest(query.data(), point_cloud.size() + 10, accessor, refs, sqr_distances);
+        ASSERT_TRUE(std::is_sorted(sqr_distances.begin(), sqr_distances.end()));
+        std::sort(refs.begin(), refs.end());
+        ASSERT_EQ(expected, refs);
+        refs = points_table.KNearest(query.data(), point_cloud.size() + 10);
+        std::sort(refs.begin(), refs.end());
+        ASSERT_EQ(expected, refs);
+    }
+}
+
+TEST(SpatialHashTable3DCompact, BuildTest) { 
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::default_random_engine rng;
+    std::normal_distribution<float> nd(0.0f, 10.0f);
+    for(int i = 0; i < 100000; ++i) {
+        point_cloud.emplace_back(nd(rng), nd(rng), nd(rng));
+    }
+
+    SpatialHashTable3DVector<float, size_t> vector_table(1.0f);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        vector_table.Add(point_cloud[i].data(), i);
+    }
+
+    SpatialHashTable3DCompact<float, size_t> compact_table(1.0f);
+    float query[3] = {0, 0, 0};
+    ASSERT_TRUE(compact_table.CubeSearch(query, 5.0f).empty());
+    
+    compact_table.Build(point_cloud[0].data(), point_cloud.size());
+    ASSERT_EQ(vector_table.GetTable().size(), compact_table.GetCellCount());
+    ASSERT_EQ(point_cloud.size(), compact_table.GetRefs().size());
+
+    for(const auto& cell : vector_table.GetTable()) {
+        std::vector<size_t> expected(cell.second.begin(), cell.second.end());
+        ASSERT_EQ(expected, compact_table.GetVoxelData(cell.first));
+    }
+
+    for(float half_size : {0.5f, 3.0f, 20.0f}) {
+        auto expected = vector_table.CubeSearch(query, half_size);
+        auto result = compact_table.CubeSearch(query, half_size);
+        std::sort(expected.begin(), expected.end());
+        std::sort(result.begin(), result.end());
+        ASSERT_EQ(expected, result);
+    }
+
+    float p1[3] = {-10, -10, -10};
+    float p2[3] = {10, 10, 10};
+    ASSERT_EQ(vector_table.CubeSearch(p1, p2).size(), compact_table.CubeSearch(p2, p1).size());
+}
+
+TEST(SpatialHashTable3DCompact, MortonOrderTest) { 
+    std::default_random_engine rng;
+    std::uniform_int_distribution<int32_t> uid(-1048576, 1048575);
+    for(int i = 0; i < 1000; ++i) {
+        HashIndex3D index(uid(rng), uid(rng), uid(rng));
+        ASSERT_EQ(index, MortonDecode3D(MortonEncode3D(index)));
+    }
+
+    // BIGMIN jumps to the first code in the box
+    const HashIndex3D box_min(-3, 1, -2);
+    const HashIndex3D box_max(2, 4, 5);
+    const uint64_t code_min = MortonEncode3D(box_min);
+    const uint64_t code_max = MortonEncode3D(box_max);
+    std::vector<uint64_t> box_codes;
+    for(int32_t x = box_min.x_; x <= box_max.x_; ++x) {
+        for(int32_t y = box_min.y_; y <= box_max.y_; ++y) {
+            for(int32_t z = box_min.z_; z <= box_max.z_; ++z) {
+                box_codes.push_back(MortonEncode3D(HashIndex3D(x, y, z)));
+            }
+        }
+    }
+    std::sort(box_codes.begin(), box_codes.end());
+    ASSERT_EQ(code_min, box_codes.front());
+    ASSERT_EQ(code_max, box_codes.back());
+    std::vector<uint64_t> samples;
+    std::uniform_int_distribution<uint64_t> code_rd(code_min, code_max - 1);
+    for(uint64_t code : box_codes) {
+        samples.push_back(code - 1);
+        samples.push_back(code + 1);
+        samples.push_back(code_rd(rng));
+    }
+    for(uint64_t code : samples) {
+        if (code < code_min || code_max <= code) {
+            continue;
+        }
+        auto next = std::upper_bound(box_codes.begin(), box_codes.end(), code);
+        ASSERT_EQ(std::binary_search(box_codes.begin(), box_codes.end(), code), MortonInBox3D(code, code_min, code_max));
+        if (!MortonInBox3D(code, code_min, code_max)) {
+            ASSERT_EQ(*next, MortonNextInBox3D(code, code_min, code_max));
+        }
+    }
+
+    // boxes around origin cross sign of every axis
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::uniform_real_distribution urd(-20.0f, 20.0f);
+    for(int i = 0; i < 50000; ++i) {
+        point_cloud.emplace_back(urd(rng), urd(rng), urd(rng));
+    }
+    SpatialHashTable3DCompact<float, size_t> compact_table(1.0f);
+    compact_table.Build(point_cloud[0].data(), point_cloud.size());
+    std::uniform_real_distribution corner_rd(-25.0f, 25.0f);
+    for(int i = 0; i < 50; ++i) {
+        float p1[3] = {corner_rd(rng), corner_rd(rng), corner_rd(rng)};
+        float p2[3] = {corner_rd(rng), corner_rd(rng), corner_rd(rng)};
+        HashIndex3D i1 = compact_table.GetVoxelIndex(p1);
+        HashIndex3D i2 = compact_table.GetVoxelIndex(p2);
+        std::vector<size_t> expected;
+        for(size_t j = 0; j < point_cloud.size(); ++j) {
+            HashIndex3D index = compact_table.GetVoxelIndex(point_cloud[j].data());
+            if (std::min(i1.x_, i2.x_) <= index.x_ && index.x_ <= std::max(i1.x_, i2.x_) &&
+                std::min(i1.y_, i2.y_) <= index.y_ && index.y_ <= std::max(i1.y_, i2.y_) &&
+                std::min(i1.z_, i2.z_) <= index.z_ && index.z_ <= std::max(i1.z_, i2.z_)) {
+                expected.push_back(j);
+            }
+        }
+        auto result = compact_table.CubeSearch(p1, p2);
+        std::sort(result.begin(), result.end());
+        ASSERT_EQ(expected, result);
+    }
+}
+
+TEST(SpatialHashTable3DCompact, SnapshotTest) { 
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::default_random_engine rng;
+    std::normal_distribution<float> nd(0.0f, 10.0f);
+    for(int i = 0; i < 50000; ++i) {
+        point_cloud.emplace_back(nd(rng), nd(rng), nd(rng));
+    }
+
+    SpatialHashTable3DCompact<float, uint32_t> compact_table(0.5f);
+    compact_table.Build(point_cloud[0].data(), point_cloud.size());
+    const std::string path = ::testing::TempDir() + "spatial_hash_snapshot.bin";
+    ASSERT_TRUE(compact_table.Save(path));
+
+    SpatialHashTable3DCompact<float, uint32_t> loaded_table;
+    ASSERT_TRUE(loaded_table.Load(path));
+    ASSERT_FALSE(loaded_table.IsMapped());
+    SpatialHashTable3DCompact<float, uint32_t> mapped_table;
+    ASSERT_TRUE(mapped_table.Map(path));
+    ASSERT_TRUE(mapped_table.IsMapped());
+    // copy shares the mapping
+    SpatialHashTable3DCompact<float, uint32_t> mapped_copy = mapped_table;
+    mapped_table.Clear();
+
+    for(const auto* table : {&loaded_table, &mapped_copy}) {
+        ASSERT_EQ(compact_table.GetVoxelSize(), table->GetVoxelSize());
+        ASSERT_EQ(compact_table.GetCellCount(), table->GetCellCount());
+        ASSERT_TRUE(std::equal(compact_table.GetRefs().begin(), compact_table.GetRefs().end(), 
+            table->GetRefs().begin(), table->GetRefs().end()));
+        for(size_t i = 0; i < 100; ++i) {
+            const float* point = point_cloud[i].data();
+            ASSERT_EQ(compact_table.GetVoxelData(compact_table.GetVoxelIndex(point)), table->GetVoxelData(table->GetVoxelIndex(point)));
+            for(float half_size : {0.5f, 2.0f, 10.0f}) {
+                ASSERT_EQ(compact_table.CubeSearch(point, half_size), table->CubeSearch(point, half_size));
+            }
+        }
+    }
+
+    // Load rejects cells referring out of the references section
+    const std::string corrupt_path = ::testing::TempDir() + "spatial_hash_corrupt.bin";
+    for(int section = 0; section < 2; ++section) {
+        ASSERT_TRUE(compact_table.Save(corrupt_path));
+        std::fstream corrupt(corrupt_path, std::ios::binary | std::ios::in | std::ios::out);
+        CompactSnapshotHeader header;
+        corrupt.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (0 == section) {
+            CompactCell cell;
+            uint64_t position = header.cells_offset_;
+            for(; cell.count_ == 0; position += sizeof(CompactCell)) {
+                corrupt.seekg(position);
+                corrupt.read(reinterpret_cast<char*>(&cell), sizeof(cell));
+            }
+            cell.offset_ = header.ref_count_;
+            corrupt.seekp(position - sizeof(CompactCell));
+            corrupt.write(reinterpret_cast<const char*>(&cell), sizeof(cell));
+        } else {
+            const uint64_t offset = header.ref_count_ + 1;
+            corrupt.seekp(header.code_offsets_offset_ + header.cell_count_ * sizeof(uint64_t));
+            corrupt.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+        }
+        corrupt.close();
+        ASSERT_FALSE(loaded_table.Load(corrupt_path));
+        ASSERT_EQ(0, loaded_table.GetCellCount());
+    }
+    std::remove(corrupt_path.c_str());
+
+    // type mismatch, missing and truncated files are rejected
+    SpatialHashTable3DCompact<double, uint32_t> double_table;
+    ASSERT_FALSE(double_table.Map(path));
+    ASSERT_FALSE(mapped_table.Map(path + ".missing"));
+    {
+        std::ofstream truncated(path, std::ios::binary | std::ios::trunc);
+        truncated << "SHASH3DC";
+    }
+    ASSERT_FALSE(mapped_table.Load(path));
+    ASSERT_EQ(0, mapped_table.GetCellCount());
+    ASSERT_TRUE(mapped_table.CubeSearch(point_cloud[0].data(), 1.0f).empty());
+
+    // empty table round trip
+    SpatialHashTable3DCompact<float, uint32_t> empty_table(1.0f);
+    ASSERT_TRUE(empty_table.Save(path));
+    ASSERT_TRUE(mapped_table.Map(path));
+    ASSERT_TRUE(mapped_table.CubeSearch(point_cloud[0].data(), 1.0f).empty());
+    std::remove(path.c_str());
+}
+
+TEST(SpatialHashTable3DVector, ParallelBuildTest) { 
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::default_random_engine rng;
+    std::normal_distribution<float> nd(0.0f, 10.0f);
+    for(int i = 0; i < 300000; ++i) {
+        point_cloud.emplace_back(nd(rng), nd(rng), nd(rng));
+    }
+
+    SpatialHashTable3DVector<float, size_t> sequential_table(0.5f);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        sequential_table.Add(point_cloud[i].data(), i);
+    }
+
+    SpatialHashTable3DVector<float, size_t, FlatHashMapBackend> parallel_table(0.5f);
+    parallel_table.Build(point_cloud[0].data(), point_cloud.size(), 4);
+    SpatialHashTable3DCompact<float, size_t> compact_table(0.5f);
+    compact_table.Build(point_cloud[0].data(), point_cloud.size(), 4);
+
+    ASSERT_EQ(sequential_table.GetTable().size(), parallel_table.GetTable().size());
+    ASSERT_EQ(sequential_table.GetTable().size(), compact_table.GetCellCount());
+    for(const auto& cell : sequential_table.GetTable()) {
+        std::vector<size_t> expected(cell.second.begin(), cell.second.end());
+        ASSERT_EQ(expected, parallel_table.GetVoxelData(cell.first));
+        ASSERT_EQ(expected, compact_table.GetVoxelData(cell.first));
+    }
+
+    // voxels out of the key range share keys, Build keeps them apart as Add does
+    const float far_points[4][3] = {{0.25f, 0.25f, 0.25f}, {2097152.5f, 0.25f, 0.25f}, {0.25f, 0.25f, 0.25f}, {2097152.5f, 0.25f, 0.25f}};
+    SpatialHashTable3DVector<float, size_t> far_sequential_table(1.0f);
+    for(size_t i = 0; i < 4; ++i) {
+        far_sequential_table.Add(far_points[i], i);
+    }
+    SpatialHashTable3DVector<float, size_t, FlatHashMapBackend> far_parallel_table(1.0f);
+    far_parallel_table.Build(far_points[0], 4, 4);
+    ASSERT_EQ(2, far_sequential_table.GetTable().size());
+    ASSERT_EQ(2, far_parallel_table.GetTable().size());
+    ASSERT_EQ(std::vector<size_t>({0, 2}), far_parallel_table.GetVoxelData(far_parallel_table.GetVoxelIndex(far_points[0])));
+    ASSERT_EQ(std::vector<size_t>({1, 3}), far_parallel_table.GetVoxelData(far_parallel_table.GetVoxelIndex(far_points[1])));
+}
+
+TEST(ConcurrentSpatialHashTable3D, ConcurrentAddSearchTest) { 
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::default_random_engine rng;
+    std::uniform_real_distribution urd(-20.0f, 20.0f);
+    for(int i = 0; i < 100000; ++i) {
+        point_cloud.emplace_back(urd(rng), urd(rng), urd(rng));
+    }
+
+    ConcurrentSpatialHashTable3D<float, size_t> hash_table(1.0f, 16);
+    std::atomic<bool> done(false);
+    std::thread reader([&]() {
+        std::vector<size_t> buffer;
+        float center[3] = {0, 0, 0};
+        while (!done) {
+            buffer.clear();
+            hash_table.CubeSearch(center, 3.0f, buffer);
+            ASSERT_LE(buffer.size(), point_cloud.size());
+        }
+    });
+
+    const size_t writer_count = 4;
+    std::vector<std::thread> writers;
+    for(size_t t = 0; t < writer_count; ++t) {
+        writers.emplace_back([&, t]() {
+            for(size_t i = t; i < point_cloud.size(); i += writer_count) {
+                hash_table.Add(point_cloud[i].data(), i);
+            }
+        });
+    }
+    for(auto& writer : writers) {
+        writer.join();
+    }
+    done = true;
+    reader.join();
+
+    SpatialHashTable3DVector<float, size_t> sequential_table(1.0f);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        sequential_table.Add(point_cloud[i].data(), i);
+    }
+    ASSERT_EQ(sequential_table.GetTable().size(), hash_table.GetCellCount());
+
+    float center[3] = {1, 2, 3};
+    auto expected = sequential_table.CubeSearch(center, 5.0f);
+    auto result = hash_table.CubeSearch(center, 5.0f);
+    std::sort(expected.begin(), expected.end());
+    std::sort(result.begin(), result.end());
+    ASSERT_EQ(expected, result);
+}
+
+TEST(SpatialHashTable3DVector, BatchCubeSearchTest) { 
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::default_random_engine rng;
+    std::uniform_real_distribution urd(-20.0f, 20.0f);
+    for(int i = 0; i < 20000; ++i) {
+        point_cloud.emplace_back(urd(rng), urd(rng), urd(rng));
+    }
+
+    SpatialHashTable3DVector<float, size_t> hash_table(1.0f);
+    hash_table.Build(point_cloud[0].data(), point_cloud.size());
+
+    std::vector<float> half_sizes(point_cloud.size());
+    for(size_t i = 0; i < half_sizes.size(); ++i) {
+        half_sizes[i] = static_cast<float>(i % 3);
+    }
+
+    BatchSearchResult<size_t> result;
+    BatchCubeSearch(hash_table, point_cloud[0].data(), point_cloud.size(), 1.0f, 4, result);
+    ASSERT_EQ(point_cloud.size(), result.Size());
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        auto expected = hash_table.CubeSearch(point_cloud[i].data(), 1.0f);
+        ASSERT_EQ(expected, std::vector<size_t>(result.Begin(i), result.End(i)));
+    }
+
+    BatchCubeSearch(hash_table, point_cloud[0].data(), half_sizes.data(), point_cloud.size(), 3, result);
+    ASSERT_EQ(point_cloud.size(), result.Size());
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        auto expected = hash_table.CubeSearch(point_cloud[i].data(), half_sizes[i]);
+        ASSERT_EQ(expected, std::vector<size_t>(result.Begin(i), result.End(i)));
+    }
+
+    // small batches reuse pool workers, concurrent batches are serialized
+    const size_t worker_count = ThreadPool::GetShared().GetWorkerCount();
+    ASSERT_LE(3u, worker_count);
+    std::vector<std::thread> callers;
+    std::vector<BatchSearchResult<size_t>> caller_results(3);
+    for(size_t t = 0; t < caller_results.size(); ++t) {
+        callers.emplace_back([&, t]() {
+            for(int frame = 0; frame < 50; ++frame) {
+                BatchCubeSearch(hash_table, point_cloud[t * 256].data(), 256, 1.0f, 4, caller_results[t]);
+            }
+        });
+    }
+    for(auto& caller : callers) {
+        caller.join();
+    }
+    ASSERT_EQ(worker_count, ThreadPool::GetShared().GetWorkerCount());
+    for(size_t t = 0; t < caller_results.size(); ++t) {
+        ASSERT_EQ(256u, caller_results[t].Size());
+        for(size_t i = 0; i < 256; ++i) {
+            auto expected = hash_table.CubeSearch(point_cloud[t * 256 + i].data(), 1.0f);
+            ASSERT_EQ(expected, std::vector<size_t>(caller_results[t].Begin(i), caller_results[t].End(i)));
+        }
+    }
+
+    // nested jobs run on the calling thread
+    std::vector<size_t> sums(4, 0);
+    ParallelFor(4, 4, [&sums](size_t thread_idx, size_t, size_t) {
+        ParallelFor(100, 4, [&sums, thread_idx](size_t, size_t begin, size_t end) {
+            for(size_t i = begin; i < end; ++i) {
+                sums[thread_idx] += i;
+            }
+        });
+    });
+    ASSERT_EQ(std::vector<size_t>(4, 4950), sums);
+}
+
+template<typename TableType>
+void RemoveMoveTest() {
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::default_random_engine rng;
+    std::uniform_real_distribution urd(-10.0f, 10.0f);
+    std::uniform_real_distribution step(-0.3f, 0.3f);
+    for(int i = 0; i < 10000; ++i) {
+        point_cloud.emplace_back(urd(rng), urd(rng), urd(rng));
+    }
+
+    TableType hash_table(1.0f);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        hash_table.Add(point_cloud[i].data(), i);
+    }
+
+    std::vector<bool> removed(point_cloud.size(), false);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        if (i % 7 == 0) {
+            ASSERT_TRUE(hash_table.Remove(point_cloud[i].data(), i));
+            ASSERT_FALSE(hash_table.Remove(point_cloud[i].data(), i));
+            removed[i] = true;
+        } else {
+            Eigen::Vector3f new_point = point_cloud[i] + Eigen::Vector3f(step(rng), step(rng), step(rng));
+            ASSERT_TRUE(hash_table.Move(point_cloud[i].data(), new_point.data(), i));
+            point_cloud[i] = new_point;
+        }
+    }
+
+    TableType expected_table(1.0f);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        if (!removed[i]) {
+            expected_table.Add(point_cloud[i].data(), i);
+        }
+    }
+
+    ASSERT_EQ(expected_table.GetTable().size(), hash_table.GetTable().size());
+    for(const auto& cell : expected_table.GetTable()) {
+        auto expected = expected_table.GetVoxelData(cell.first);
+        auto result = hash_table.GetVoxelData(cell.first);
+        std::sort(expected.begin(), expected.end());
+        std::sort(result.begin(), result.end());
+        ASSERT_EQ(expected, result);
+    }
+}
+
+TEST(SpatialHashTable3DVector, RemoveMoveTest) { 
+    RemoveMoveTest<SpatialHashTable3DVector<float, size_t>>();
+    RemoveMoveTest<SpatialHashTable3DVector<float, size_t, FlatHashMapBackend>>();
+}
+
+TEST(SpatialHashTable3DSmallVector, SmallVectorTest) {
+    RemoveMoveTest<SpatialHashTable3DSmallVector<float, size_t>>();
+    RemoveMoveTest<SpatialHashTable3DSmallVector<float, size_t, 2, StdHashMapBackend>>();
+
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::default_random_engine rng;
+    std::normal_distribution<float> nd(0.0f, 3.0f);
+    for(int i = 0; i < 5000; ++i) {
+        point_cloud.emplace_back(nd(rng), nd(rng), nd(rng));
+    }
+
+    SpatialHashTable3DVector<float, size_t> expected_table(1.0f);
+    SpatialHashTable3DSmallVector<float, size_t> hash_table(1.0f);
+    SpatialHashTable3DSmallVector<float, size_t> build_table(1.0f);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        expected_table.Add(point_cloud[i].data(), i);
+    }
+    build_table.Build(point_cloud[0].data(), point_cloud.size());
+
+    size_t memory_bytes = 0;
+    for(int frame = 0; frame < 32; ++frame) {
+        // setting the voxel size resets the arena like Clear, frames together spill more than one arena block
+        if (frame < 2) {
+            hash_table.Clear();
+        } else {
+            hash_table.SetCellSize(1.0f);
+        }
+        for(size_t i = 0; i < point_cloud.size(); ++i) {
+            hash_table.Add(point_cloud[i].data(), i);
+        }
+        // storage of the first frame is reused
+        if (frame > 0) {
+            ASSERT_EQ(memory_bytes, hash_table.GetStatistics().memory_bytes_);
+        }
+        memory_bytes = hash_table.GetStatistics().memory_bytes_;
+    }
+
+    ASSERT_EQ(expected_table.GetTable().size(), hash_table.GetTable().size());
+    ASSERT_EQ(expected_table.GetTable().size(), build_table.GetTable().size());
+    ASSERT_LT(4, expected_table.GetStatistics().max_cell_size_);
+    for(const auto& cell : expected_table.GetTable()) {
+        auto expected = expected_table.GetVoxelData(cell.first);
+        ASSERT_EQ(expected, hash_table.GetVoxelData(cell.first));
+        ASSERT_EQ(expected, build_table.GetVoxelData(cell.first));
+    }
+
+    float center[3] = {0.5f, -0.5f, 1.0f};
+    auto expected = expected_table.CubeSearch(center, 2.0f);
+    auto result = hash_table.CubeSearch(center, 2.0f);
+    std::sort(expected.begin(), expected.end());
+    std::sort(result.begin(), result.end());
+    ASSERT_EQ(expected, result);
+}
+
+TEST(SpatialHashTable3DPoints, RemoveMoveTest) {
+    RemoveMoveTest<SpatialHashTable3DPoints<float, size_t>>();
+
+    SpatialHashTable3DPoints<float, size_t> hash_table(1.0f);
+    float p1[3] = {0.1f, 0.1f, 0.1f};
+    float p2[3] = {0.9f, 0.9f, 0.9f};
+    hash_table.Add(p1, 0);
+    ASSERT_TRUE(hash_table.Move(p1, p2, 0));
+    ASSERT_TRUE(hash_table.RadiusSearch(p1, 0.5f).empty());
+    ASSERT_EQ(1, hash_table.RadiusSearch(p2, 0.5f).size());
+}
+
+TEST(SpatialHashTable3DVector, StatisticsTest) { 
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::default_random_engine rng;
+    std::normal_distribution<float> nd(0.0f, 5.0f);
+    for(int i = 0; i < 20000; ++i) {
+        point_cloud.emplace_back(nd(rng), nd(rng), nd(rng));
+    }
+
+    SpatialHashTable3DVector<float, size_t, FlatHashMapBackend> hash_table(1.0f);
+    TableStatistics empty_stats = hash_table.GetStatistics();
+    ASSERT_EQ(0, empty_stats.cell_count_);
+    ASSERT_EQ(0.0, empty_stats.mean_cell_size_);
+
+    hash_table.Build(point_cloud[0].data(), point_cloud.size());
+    SpatialHashTable3DCompact<float, size_t> compact_table(1.0f);
+    compact_table.Build(point_cloud[0].data(), point_cloud.size());
+
+    for(const TableStatistics& stats : {hash_table.GetStatistics(8), compact_table.GetStatistics(8)}) {
+        ASSERT_EQ(hash_table.GetTable().size(), stats.cell_count_);
+        ASSERT_EQ(point_cloud.size(), stats.ref_count_);
+        ASSERT_EQ(8, stats.histogram_.size());
+        ASSERT_EQ(0, stats.histogram_[0]);
+        ASSERT_EQ(stats.cell_count_, std::accumulate(stats.histogram_.begin(), stats.histogram_.end(), size_t(0)));
+        ASSERT_DOUBLE_EQ(double(stats.ref_count_) / stats.cell_count_, stats.mean_cell_size_);
+        ASSERT_GT(stats.load_factor_, 0.0);
+        ASSERT_LE(stats.load_factor_, 1.0);
+        ASSERT_GT(stats.memory_bytes_, stats.ref_count_ * sizeof(size_t));
+    }
+
+    size_t max_cell_size = 0;
+    for(const auto& cell : hash_table.GetTable()) {
+        max_cell_size = std::max(max_cell_size, cell.second.size());
+    }
+    ASSERT_EQ(max_cell_size, hash_table.GetStatistics().max_cell_size_);
+}
+
+TEST(VoxelSizeTuner, TuneTest) { 
+    std::default_random_engine rng;
+    std::uniform_real_distribution urd(-2.5f, 2.5f);
+    std::vector<float> dense_cloud;
+    for(int i = 0; i < 3 * 200000; ++i) {
+        dense_cloud.push_back(urd(rng));
+    }
+    std::vector<float> sparse_cloud(dense_cloud.begin(), dense_cloud.begin() + 3 * 200);
+
+    const float radius = 1.0f;
+    const auto candidates = DefaultVoxelSizeCandidates(radius);
+    auto estimates = EstimateVoxelSizes3D(dense_cloud.data(), dense_cloud.size() / 3, radius, candidates);
+    ASSERT_EQ(candidates.size(), estimates.size());
+    for(size_t i = 1; i < estimates.size(); ++i) {
+        // larger voxels probe fewer cells
+        ASSERT_LE(estimates[i].cells_per_query_, estimates[i - 1].cells_per_query_);
+        ASSERT_GT(estimates[i].candidates_per_query_, 0.0);
+    }
+
+    // sampled estimate is scaled to the full cloud density
+    VoxelSizeTunerOptions options;
+    options.max_sample_size_ = 20000;
+    auto sampled = EstimateVoxelSizes3D(dense_cloud.data(), dense_cloud.size() / 3, radius, candidates, options);
+    for(size_t i = 0; i < estimates.size(); ++i) {
+        ASSERT_NEAR(1.0, sampled[i].candidates_per_query_ / estimates[i].candidates_per_query_, 0.2);
+    }
+
+    const float dense_size = TuneVoxelSize3D(dense_cloud.data(), dense_cloud.size() / 3, radius);
+    const float sparse_size = TuneVoxelSize3D(sparse_cloud.data(), sparse_cloud.size() / 3, radius);
+    ASSERT_LT(dense_size, sparse_size);
+    ASSERT_EQ(radius, TuneVoxelSize3D<float>(nullptr, 0, radius));
+
+    const float dense_size_2d = TuneCellSize2D(dense_cloud.data(), dense_cloud.size() / 2, radius);
+    const float sparse_size_2d = TuneCellSize2D(sparse_cloud.data(), sparse_cloud.size() / 2, radius);
+    ASSERT_LT(dense_size_2d, sparse_size_2d);
+}
+
+TEST(SpatialHashTable3DVector, CountersTest) { 
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::default_random_engine rng;
+    std::uniform_real_distribution urd(-10.0f, 10.0f);
+    for(int i = 0; i < 10000; ++i) {
+        point_cloud.emplace_back(urd(rng), urd(rng), urd(rng));
+    }
+
+    SpatialHashTable3DVector<float, size_t, FlatHashMapBackend, AtomicCounters> hash_table(1.0f);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        hash_table.Add(point_cloud[i].data(), i);
+    }
+
+    CountersSnapshot counters = hash_table.GetCounters();
+    ASSERT_EQ(point_cloud.size(), counters.adds_);
+    ASSERT_EQ(hash_table.GetTable().size(), counters.cells_created_);
+    ASSERT_GT(counters.rehashes_, 0);
+    ASSERT_GT(counters.allocated_bytes_, point_cloud.size() * sizeof(size_t));
+    ASSERT_EQ(0, counters.queries_);
+
+    hash_table.ResetCounters();
+    float center[3] = {0, 0, 0};
+    auto result = hash_table.CubeSearch(center, 1.0f);
+    auto cells = hash_table.GetVoxelData(HashIndex3D(100, 100, 100));
+    counters = hash_table.GetCounters();
+    ASSERT_EQ(0, counters.adds_);
+    ASSERT_EQ(1, counters.queries_);
+    size_t populated = 0;
+    for(int x = -1; x <= 1; ++x) {
+        for(int y = -1; y <= 1; ++y) {
+            for(int z = -1; z <= 1; ++z) {
+                populated += hash_table.GetTable().count(HashIndex3D(x, y, z));
+            }
+        }
+    }
+    ASSERT_EQ(27 + 1, counters.probes_);
+    ASSERT_EQ(populated, counters.hits_);
+    ASSERT_EQ(28 - populated, counters.misses_);
+    ASSERT_EQ(result.size(), counters.candidates_);
+
+    // counters are not active by default
+    SpatialHashTable3DVector<float, size_t> default_table(1.0f);
+    default_table.Add(center, 0);
+    default_table.CubeSearch(center, 1.0f);
+    ASSERT_EQ(0, default_table.GetCounters().adds_);
+    ASSERT_EQ(0, default_table.GetCounters().probes_);
+
+    SpatialHashTable2DVector<float, size_t, StdHashMapBackend, AtomicCounters> table_2d(1.0f);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        table_2d.Add(point_cloud[i].data(), i);
+    }
+    result = table_2d.SquareSearch(center, 2.0f);
+    counters = table_2d.GetCounters();
+    ASSERT_EQ(point_cloud.size(), counters.adds_);
+    ASSERT_EQ(table_2d.GetTable().size(), counters.cells_created_);
+    ASSERT_EQ(1, counters.queries_);
+    ASSERT_EQ(25, counters.probes_);
+    ASSERT_EQ(result.size(), counters.candidates_);
+}
+
+TEST(SpatialHashTableVector, SpaceTimeTest) {
+    // 21 bits per axis for 3D, 16 bits for 4D
+    ASSERT_EQ((uint64_t(1) << 20) + (uint64_t(1) << 41) + (uint64_t(1) << 62), SpatalHash3D()(HashIndex3D(0, 0, 0)));
+    ASSERT_EQ(0, SpatalHash4D()(HashIndex4D(-32768, -32768, -32768, -32768)));
+    ASSERT_EQ(~uint64_t(0), SpatalHash4D()(HashIndex4D(32767, 32767, 32767, 32767)));
+
+    std::vector<Eigen::Vector4f> points;
+    std::default_random_engine rng;
+    std::uniform_real_distribution<float> urd(-10.0f, 10.0f);
+    for(int i = 0; i < 20000; ++i) {
+        points.emplace_back(urd(rng), urd(rng), urd(rng), urd(rng));
+    }
+
+    SpatialHashTable4DVector<float, size_t> hash_table(1.0f);
+    SpatialHashTable4DVector<float, size_t, FlatHashMapBackend> build_table(1.0f);
+    for(size_t i = 0; i < points.size(); ++i) {
+        hash_table.Add(points[i].data(), i);
+    }
+    build_table.Build(points[0].data(), points.size());
+    ASSERT_EQ(hash_table.GetTable().size(), build_table.GetTable().size());
+
+    for(const Eigen::Vector4f& center : {Eigen::Vector4f(0.5f, 0.5f, -2.5f, 3.0f), Eigen::Vector4f(-9.0f, 9.0f, 0.0f, -5.0f)}) {
+        const HashIndex4D center_index = hash_table.GetCellIndex(center.data());
+        std::vector<size_t> expected;
+        for(size_t i = 0; i < points.size(); ++i) {
+            const HashIndex4D index = hash_table.GetCellIndex(points[i].data());
+            if (std::abs(index.x_ - center_index.x_) <= 2 && std::abs(index.y_ - center_index.y_) <= 2 &&
+                std::abs(index.z_ - center_index.z_) <= 2 && std::abs(index.t_ - center_index.t_) <= 2) {
+                expected.push_back(i);
+            }
+        }
+
+        auto result = hash_table.BoxSearch(center.data(), 2.0f);
+        auto build_result = build_table.BoxSearch(center.data(), 2.0f);
+        std::sort(result.begin(), result.end());
+        std::sort(build_result.begin(), build_result.end());
+        ASSERT_FALSE(expected.empty());
+        ASSERT_EQ(expected, result);
+        ASSERT_EQ(expected, build_result);
+    }
+
+    ASSERT_TRUE(hash_table.Remove(points[0].data(), 0));
+    ASSERT_FALSE(hash_table.Remove(points[0].data(), 0));
+
+    // cells 65536 cells apart share the key, Build keeps them apart as Add does
+    const float far_points[2][4] = {{0.5f, 0.5f, 0.5f, 0.5f}, {65536.5f, 0.5f, 0.5f, 0.5f}};
+    SpatialHashTable4DVector<float, size_t> far_table(1.0f);
+    SpatialHashTable4DVector<float, size_t, FlatHashMapBackend> far_build_table(1.0f);
+    ASSERT_EQ(SpatalHash4D()(far_table.GetCellIndex(far_points[0])), SpatalHash4D()(far_table.GetCellIndex(far_points[1])));
+    far_table.Add(far_points[0], 0);
+    far_table.Add(far_points[1], 1);
+    far_build_table.Build(far_points[0], 2);
+    ASSERT_EQ(2, far_table.GetTable().size());
+    ASSERT_EQ(2, far_build_table.GetTable().size());
+    ASSERT_EQ(std::vector<size_t>({1}), far_table.BoxSearch(far_points[1], 0.0f));
+    ASSERT_EQ(std::vector<size_t>({1}), far_build_table.BoxSearch(far_points[1], 0.0f));
+}
+
+TEST(SpatialHashTable3DHeap, TopKTest) {
+    auto is_equal = [](const ContainerHeap<int, size_t>& expected, const ContainerTopK<int, size_t>& result) {
+        return std::equal(expected.begin(), expected.end(), result.begin(), result.end(), 
+            [](const auto& a, const auto& b) { return a.first == b.first && a.second == b.second; });
+    };
+
+    std::default_random_engine rng;
+    std::uniform_int_distribution<int> key_dst(0, 50);
+    for(size_t limit : {1, 3, 8}) {
+        ContainerHeap<int, size_t> expected;
+        ContainerTopK<int, size_t> result;
+        for(size_t i = 0; i < 200; ++i) {
+            const int key = key_dst(rng);
+            expected.Add(key, i, limit);
+            result.Add(key, i, limit);
+            ASSERT_TRUE(is_equal(expected, result));
+        }
+        if (!expected.empty()) {
+            const size_t ref = expected.begin()->second;
+            ASSERT_TRUE(expected.Remove(ref));
+            ASSERT_TRUE(result.Remove(ref));
+            ASSERT_TRUE(is_equal(expected, result));
+        }
+    }
+    ContainerTopK<int, size_t> empty;
+    empty.Add(1, 1, 0);
+    ASSERT_TRUE(empty.empty());
+
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::vector<float> scores;
+    std::uniform_real_distribution<float> urd(-5.0f, 5.0f);
+    for(int i = 0; i < 10000; ++i) {
+        point_cloud.emplace_back(urd(rng), urd(rng), urd(rng));
+        scores.push_back(urd(rng));
+    }
+
+    const size_t limit = 4;
+    SpatialHashTable3DHeap<float, float, size_t, FlatHashMapBackend> hash_table(1.0f, limit);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        hash_table.Add(point_cloud[i].data(), scores[i], i);
+    }
+
+    // best "limit" points of every voxel by score
+    std::unordered_map<HashIndex3D, std::vector<size_t>, SpatalHash3D> voxels;
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        voxels[hash_table.GetVoxelIndex(point_cloud[i].data())].push_back(i);
+    }
+    ASSERT_EQ(voxels.size(), hash_table.GetTable().size());
+    for(auto& voxel : voxels) {
+        auto& expected = voxel.second;
+        std::sort(expected.begin(), expected.end(), [&scores](size_t a, size_t b) { return scores[a] < scores[b]; });
+        expected.erase(expected.begin(), expected.end() - std::min(limit, expected.size()));
+        ASSERT_EQ(expected, hash_table.GetVoxelData(voxel.first));
+    }
+    ASSERT_EQ(hash_table.GetAllData().size(), hash_table.GetStatistics().ref_count_);
+
+    SpatialHashTable2DHeap<float, float, size_t> table_2d(1.0f, limit);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        table_2d.Add(point_cloud[i].data(), scores[i], i);
+    }
+    ASSERT_EQ(limit * table_2d.GetTable().size(), table_2d.GetAllData().size());
+}
+
+TEST(VoxelDownsample, DownsampleTest) {
+    std::vector<float> points;
+    std::default_random_engine rng;
+    std::uniform_real_distribution<float> urd(-5.0f, 5.0f);
+    const size_t count = 200000;
+    for(size_t i = 0; i < 3 * count; ++i) {
+        points.push_back(urd(rng));
+    }
+
+    // reference: voxel refs in the table, voxels ordered by the first point
+    const float voxel_size = 0.7f;
+    SpatialHashTable3DVector<float, uint32_t> hash_table(voxel_size);
+    hash_table.Build(points.data(), count);
+    std::vector<std::vector<uint32_t>> voxels;
+    for(const auto& voxel : hash_table.GetTable()) {
+        voxels.push_back(voxel.second);
+    }
+    std::sort(voxels.begin(), voxels.end(), [](const auto& a, const auto& b) { return a[0] < b[0]; });
+
+    std::vector<uint32_t> first;
+    std::vector<uint32_t> nearest;
+    std::vector<float> centroids;
+    for(const auto& voxel : voxels) {
+        first.push_back(voxel[0]);
+        const HashIndex3D index = hash_table.GetVoxelIndex(points.data() + 3 * voxel[0]);
+        const Eigen::Vector3f center = (Eigen::Vector3f(index.x_, index.y_, index.z_) + Eigen::Vector3f::Constant(0.5f)) * voxel_size;
+        uint32_t best = voxel[0];
+        Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+        for(uint32_t idx : voxel) {
+            Eigen::Map<const Eigen::Vector3f> point(points.data() + 3 * idx);
+            if ((point - center).squaredNorm() < (Eigen::Map<const Eigen::Vector3f>(points.data() + 3 * best) - center).squaredNorm()) {
+                best = idx;
+            }
+            sum += point.cast<double>();
+        }
+        nearest.push_back(best);
+        for(int i = 0; i < 3; ++i) {
+            centroids.push_back(static_cast<float>(sum[i] / voxel.size()));
+        }
+    }
+
+    const auto single_thread_centroids = VoxelDownsample3D(points.data(), count, voxel_size, DownsampleMode::kCentroid, 1);
+    for(size_t num_threads : {1, 3}) {
+        // partitions are accumulated in input order, so centroids don't depend on number of threads
+        ASSERT_EQ(single_thread_centroids, VoxelDownsample3D(points.data(), count, voxel_size, DownsampleMode::kCentroid, num_threads));
+        ASSERT_EQ(first, VoxelDownsampleIndices3D(points.data(), count, voxel_size, DownsampleMode::kFirst, num_threads));
+        ASSERT_EQ(nearest, VoxelDownsampleIndices3D(points.data(), count, voxel_size, DownsampleMode::kNearestToCenter, num_threads));
+
+        auto result = VoxelDownsample3D(points.data(), count, voxel_size, DownsampleMode::kCentroid, num_threads);
+        ASSERT_EQ(centroids.size(), result.size());
+        for(size_t i = 0; i < result.size(); ++i) {
+            ASSERT_NEAR(centroids[i], result[i], 1e-5f);
+        }
+
+        result = VoxelDownsample3D(points.data(), count, voxel_size, DownsampleMode::kNearestToCenter, num_threads);
+        ASSERT_EQ(3 * nearest.size(), result.size());
+        ASSERT_TRUE(std::equal(points.begin() + 3 * nearest.back(), points.begin() + 3 * nearest.back() + 3, result.end() - 3));
+    }
+    ASSERT_TRUE(VoxelDownsample3D(points.data(), 0, voxel_size).empty());
+}
+
+TEST(SpatialHashTable3DPoints, RadiusPairsTest) {
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::default_random_engine rng;
+    std::uniform_real_distribution<float> urd(-3.0f, 3.0f);
+    for(int i = 0; i < 2000; ++i) {
+        point_cloud.emplace_back(urd(rng), urd(rng), urd(rng));
+    }
+
+    SpatialHashTable3DPoints<float, uint32_t, FlatHashMapBackend> hash_table(0.3f);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        hash_table.Add(point_cloud[i].data(), static_cast<uint32_t>(i));
+    }
+
+    for(float radius : {0.2f, 0.3f, 0.75f}) {
+        std::vector<std::pair<uint32_t, uint32_t>> expected;
+        for(uint32_t i = 0; i < point_cloud.size(); ++i) {
+            for(uint32_t j = i + 1; j < point_cloud.size(); ++j) {
+                if ((point_cloud[i] - point_cloud[j]).squaredNorm() < radius * radius) {
+                    expected.emplace_back(i, j);
+                }
+            }
+        }
+
+        std::vector<std::pair<uint32_t, uint32_t>> visited;
+        hash_table.ForEachPairInRadius(radius, [&visited](uint32_t a, uint32_t b) { visited.emplace_back(a, b); });
+        ASSERT_EQ(visited, hash_table.RadiusPairs(radius, 3));
+
+        for(auto& pair : visited) {
+            if (pair.second < pair.first) {
+                std::swap(pair.first, pair.second);
+            }
+        }
+        std::sort(visited.begin(), visited.end());
+        ASSERT_EQ(expected, visited);
+    }
+}
+
+TEST(SpatialHashTable3DVector, RaycastTest) {
+    // ray segment parameter interval inside the cell box, empty interval if enter > exit
+    auto clip = [](const float* origin, const float* direction, const int32_t* index, int dim, float cell_size, float& enter, float& exit) {
+        for(int i = 0; i < dim; ++i) {
+            const float low = index[i] * cell_size;
+            const float high = low + cell_size;
+            if (0 == direction[i]) {
+                if (origin[i] < low || origin[i] >= high) {
+                    enter = 1;
+                    exit = 0;
+                }
+                continue;
+            }
+            const float t1 = (low - origin[i]) / direction[i];
+            const float t2 = (high - origin[i]) / direction[i];
+            enter = std::max(enter, std::min(t1, t2));
+            exit = std::min(exit, std::max(t1, t2));
+        }
+    };
+
+    std::default_random_engine rng;
+    std::uniform_int_distribution<int32_t> idx_dst(-20, 20);
+    std::uniform_real_distribution<float> urd(-25.0f, 25.0f);
+    std::normal_distribution<float> nd(0.0f, 1.0f);
+    const float voxel_size = 0.5f;
+    const float max_range = 30.0f;
+
+    std::vector<HashIndex3D> voxels;
+    std::unordered_map<HashIndex3D, size_t, SpatalHash3D> voxel_set;
+    SpatialHashTable3DVector<float, size_t, FlatHashMapBackend> hash_table(voxel_size);
+    while (voxels.size() < 3000) {
+        HashIndex3D index(idx_dst(rng), idx_dst(rng), idx_dst(rng));
+        if (voxel_set.emplace(index, voxels.size()).second) {
+            const float center[3] = {(index.x_ + 0.5f) * voxel_size, (index.y_ + 0.5f) * voxel_size, (index.z_ + 0.5f) * voxel_size};
+            hash_table.Add(center, voxels.size());
+            voxels.push_back(index);
+        }
+    }
+
+    for(int ray = 0; ray < 200; ++ray) {
+        const float origin[3] = {urd(rng) / 2, urd(rng) / 2, urd(rng) / 2};
+        float direction[3] = {nd(rng), nd(rng), ray % 10 ? nd(rng) : 0.0f};
+        const float norm = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+        float unit[3] = {direction[0] / norm, direction[1] / norm, direction[2] / norm};
+
+        std::vector<size_t> visited;
+        float last_distance = 0;
+        hash_table.Raycast(origin, direction, max_range, [&](size_t ref, float distance) {
+            ASSERT_LE(last_distance, distance);
+            last_distance = distance;
+            visited.push_back(ref);
+        });
+
+        // every crossed voxel is visited, visited voxels are crossed up to rounding
+        for(size_t i = 0; i < voxels.size(); ++i) {
+            const int32_t index[3] = {voxels[i].x_, voxels[i].y_, voxels[i].z_};
+            float enter = 0;
+            float exit = max_range;
+            clip(origin, unit, index, 3, voxel_size, enter, exit);
+            const bool is_visited = visited.end() != std::find(visited.begin(), visited.end(), i);
+            if (exit - enter > 1e-3f) {
+                ASSERT_TRUE(is_visited);
+            } else if (is_visited) {
+                ASSERT_GT(exit - enter, -1e-3f);
+            }
+        }
+
+        HashIndex3D hit_index;
+        float hit_distance = 0;
+        ASSERT_EQ(!visited.empty(), hash_table.RaycastFirst(origin, direction, max_range, hit_index, hit_distance));
+        if (!visited.empty()) {
+            ASSERT_EQ(voxels[visited.front()], hit_index);
+        }
+    }
+
+    // 2D segment crossing a row of cells
+    SpatialHashTable2DVector<float, size_t> table_2d(1.0f);
+    for(size_t i = 0; i < 10; ++i) {
+        const float point[2] = {i + 0.5f, 0.5f};
+        table_2d.Add(point, i);
+    }
+    const float origin[2] = {-2.5f, 0.5f};
+    const float direction[2] = {2.0f, 0.0f};
+    std::vector<size_t> visited;
+    table_2d.Raycast(origin, direction, 7.0f, [&visited](size_t ref, float) { visited.push_back(ref); });
+    ASSERT_EQ((std::vector<size_t>{0, 1, 2, 3, 4}), visited);
+
+    HashIndex2D hit_index;
+    float hit_distance = 0;
+    ASSERT_TRUE(table_2d.RaycastFirst(origin, direction, 7.0f, hit_index, hit_distance));
+    ASSERT_EQ(HashIndex2D(0, 0), hit_index);
+    ASSERT_FLOAT_EQ(2.5f, hit_distance);
+    ASSERT_FALSE(table_2d.RaycastFirst(origin, direction, 2.0f, hit_index, hit_distance));
+
+    // infinite range stops at the bounds of added cells
+    constexpr float kInf = std::numeric_limits<float>::infinity();
+    visited.clear();
+    table_2d.Raycast(origin, direction, kInf, [&visited](size_t ref, float) { visited.push_back(ref); });
+    ASSERT_EQ((std::vector<size_t>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}), visited);
+    const float miss_direction[2] = {0.0f, 1.0f};
+    ASSERT_FALSE(table_2d.RaycastFirst(origin, miss_direction, kInf, hit_index, hit_distance));
+    const float back_direction[2] = {-1.0f, 0.0f};
+    ASSERT_FALSE(table_2d.RaycastFirst(origin, back_direction, kInf, hit_index, hit_distance));
+    ASSERT_FALSE(table_2d.RaycastFirst(origin, direction, std::numeric_limits<float>::quiet_NaN(), hit_index, hit_distance));
+
+    // zero direction visits the origin cell only, also with infinite range
+    const float zero_direction[2] = {0.0f, 0.0f};
+    const float inside_origin[2] = {3.5f, 0.5f};
+    visited.clear();
+    table_2d.Raycast(inside_origin, zero_direction, kInf, [&visited](size_t ref, float) { visited.push_back(ref); });
+    ASSERT_EQ((std::vector<size_t>{3}), visited);
+    ASSERT_FALSE(table_2d.RaycastFirst(origin, zero_direction, kInf, hit_index, hit_distance));
+
+    SpatialHashTable3DVector<float, size_t> table_3d(1.0f);
+    const float point_3d[3] = {5.5f, 5.5f, 5.5f};
+    table_3d.Add(point_3d, 0);
+    const float origin_3d[3] = {0.5f, 0.5f, 0.5f};
+    const float hit_direction[3] = {1.0f, 1.0f, 1.0f};
+    const float miss_direction_3d[3] = {1.0f, -1.0f, 1.0f};
+    HashIndex3D hit_index_3d;
+    ASSERT_TRUE(table_3d.RaycastFirst(origin_3d, hit_direction, kInf, hit_index_3d, hit_distance));
+    ASSERT_EQ(HashIndex3D(5, 5, 5), hit_index_3d);
+    ASSERT_FALSE(table_3d.RaycastFirst(origin_3d, miss_direction_3d, kInf, hit_index_3d, hit_distance));
+    const float zero_direction_3d[3] = {0.0f, 0.0f, 0.0f};
+    ASSERT_TRUE(table_3d.RaycastFirst(point_3d, zero_direction_3d, kInf, hit_index_3d, hit_distance));
+    ASSERT_EQ(HashIndex3D(5, 5, 5), hit_index_3d);
+    ASSERT_FALSE(table_3d.RaycastFirst(origin_3d, zero_direction_3d, kInf, hit_index_3d, hit_distance));
+    table_3d.Clear();
+    ASSERT_FALSE(table_3d.RaycastFirst(origin_3d, hit_direction, kInf, hit_index_3d, hit_distance));
+}
+
+TEST(SpatialHashTable3DVector, SphereSearchTest) {
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::default_random_engine rng;
+    std::uniform_real_distribution<float> urd(-10.0f, 10.0f);
+    for(int i = 0; i < 20000; ++i) {
+        point_cloud.emplace_back(urd(rng), urd(rng), urd(rng));
+    }
+
+    const float voxel_size = 0.5f;
+    SpatialHashTable3DVector<float, size_t, FlatHashMapBackend, AtomicCounters> hash_table(voxel_size);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        hash_table.Add(point_cloud[i].data(), i);
+    }
+
+    // references of voxels whose box is within radius from the center
+    auto expected_refs = [&](const Eigen::Vector3f& center, float radius) {
+        std::vector<size_t> result;
+        for(size_t i = 0; i < point_cloud.size(); ++i) {
+            const HashIndex3D index = hash_table.GetVoxelIndex(point_cloud[i].data());
+            const Eigen::Vector3f low = Eigen::Vector3f(index.x_, index.y_, index.z_) * voxel_size;
+            const Eigen::Vector3f delta = (low - center).cwiseMax(center - low - Eigen::Vector3f::Constant(voxel_size)).cwiseMax(0.0f);
+            if (delta.squaredNorm() <= radius * radius) {
+                result.push_back(i);
+            }
+        }
+        return result;
+    };
+
+    for(float radius : {0.0f, 0.3f, 1.0f, 2.2f, 40.0f}) {
+        for(int q = 0; q < 10; ++q) {
+            const Eigen::Vector3f center(urd(rng), urd(rng), urd(rng));
+            auto result = hash_table.SphereSearch(center.data(), radius);
+            std::sort(result.begin(), result.end());
+            ASSERT_EQ(expected_refs(center, radius), result);
+        }
+    }
+
+    // sphere culling probes about half of the bounding cube voxels
+    const Eigen::Vector3f center(0.1f, 0.2f, 0.3f);
+    const float radius = 3.0f;
+    hash_table.ResetCounters();
+    hash_table.SphereSearch(center.data(), radius);
+    const uint64_t sphere_probes = hash_table.GetCounters().probes_;
+    hash_table.ResetCounters();
+    hash_table.CubeSearch(hash_table.GetVoxelIndex(center.data()), static_cast<int32_t>(std::ceil(radius / voxel_size)));
+    ASSERT_LT(sphere_probes, 0.7 * hash_table.GetCounters().probes_);
+
+    std::vector<Eigen::Vector2f> points_2d;
+    SpatialHashTable2DVector<float, size_t> table_2d(voxel_size);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        points_2d.emplace_back(point_cloud[i].x(), point_cloud[i].y());
+        table_2d.Add(points_2d[i].data(), i);
+    }
+    const Eigen::Vector2f center_2d(1.5f, -2.5f);
+    auto result = table_2d.CircleSearch(center_2d.data(), 2.0f);
+    size_t visited = 0;
+    table_2d.ForEachInCircle(center_2d.data(), 2.0f, [&visited](size_t) { ++visited; });
+    ASSERT_EQ(result.size(), visited);
+    for(size_t i = 0; i < points_2d.size(); ++i) {
+        if ((points_2d[i] - center_2d).norm() < 2.0f) {
+            ASSERT_TRUE(result.end() != std::find(result.begin(), result.end(), i));
+        }
+    }
+    ASSERT_LT(result.size(), table_2d.SquareSearch(center_2d.data(), 2.0f).size());
+
+    // a ball much larger than a small table scans it without building rows
+    SpatialHashTable3DVector<float, size_t, FlatHashMapBackend, AtomicCounters> small_table(voxel_size);
+    for(size_t i = 0; i < 1000; ++i) {
+        small_table.Add(point_cloud[i].data(), i);
+    }
+    for(float small_radius : {1000.0f, 1.0e6f, std::numeric_limits<float>::infinity()}) {
+        small_table.ResetCounters();
+        ASSERT_EQ(1000u, small_table.SphereSearch(center.data(), small_radius).size());
+        ASSERT_EQ(small_table.GetTable().size(), small_table.GetCounters().probes_);
+    }
+    ASSERT_TRUE(small_table.SphereSearch(center.data(), std::numeric_limits<float>::quiet_NaN()).empty());
+}
+
+TEST(SpatialHashTable3DPoints, RegionSearchTest) {
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::default_random_engine rng;
+    std::uniform_real_distribution<float> urd(-10.0f, 10.0f);
+    for(int i = 0; i < 20000; ++i) {
+        point_cloud.emplace_back(urd(rng), urd(rng), urd(rng));
+    }
+
+    const float voxel_size = 0.5f;
+    SpatialHashTable3DPoints<float, size_t> points_table(voxel_size);
+    SpatialHashTable3DVector<float, size_t, FlatHashMapBackend, AtomicCounters> vector_table(voxel_size);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        points_table.Add(point_cloud[i].data(), i);
+        vector_table.Add(point_cloud[i].data(), i);
+    }
+
+    // camera frustum along x axis and box rotated around z axis
+    const float near[12] = {0.5f, -0.25f, -0.2f,  0.5f, 0.25f, -0.2f,  0.5f, 0.25f, 0.2f,  0.5f, -0.25f, 0.2f};
+    const float far[12] = {8.0f, -4.0f, -3.0f,  8.0f, 4.0f, -3.0f,  8.0f, 4.0f, 3.0f,  8.0f, -4.0f, 3.0f};
+    const float center[3] = {-2.0f, 1.0f, 0.5f};
+    const float c = std::cos(0.5f);
+    const float s = std::sin(0.5f);
+    const float axes[9] = {c, s, 0.0f,  -s, c, 0.0f,  0.0f, 0.0f, 1.0f};
+    const float half_sizes[3] = {5.0f, 1.0f, 2.0f};
+    const float box_min[3] = {-20.0f, -20.0f, -20.0f};
+    const float box_max[3] = {20.0f, 20.0f, 20.0f};
+    ConvexRegion<float, 3> slab(box_min, box_max);
+    const float normal[3] = {1.0f, 1.0f, 1.0f};
+    slab.AddHalfSpace(normal, 1.0f);
+    // bounding box not aligned to voxels, alone and with a half-space that doesn't clip it
+    const float unaligned_min[3] = {-2.3f, -2.3f, -2.3f};
+    const float unaligned_max[3] = {2.3f, 2.3f, 2.3f};
+    ConvexRegion<float, 3> unaligned(unaligned_min, unaligned_max);
+    ConvexRegion<float, 3> loose = unaligned;
+    loose.AddHalfSpace(normal, 100.0f);
+
+    for(const auto& region : {ConvexRegion<float, 3>::Frustum(near, far), ConvexRegion<float, 3>::OrientedBox(center, axes, half_sizes), slab, 
+        unaligned, loose}) {
+        std::vector<size_t> expected;
+        for(size_t i = 0; i < point_cloud.size(); ++i) {
+            if (region.IsInside(point_cloud[i].data())) {
+                expected.push_back(i);
+            }
+        }
+        ASSERT_FALSE(expected.empty());
+
+        auto result = points_table.RegionSearch(region);
+        std::sort(result.begin(), result.end());
+        ASSERT_EQ(expected, result);
+
+        // inside voxels contain only region points, boundary voxels complete the result
+        std::vector<size_t> inside;
+        std::vector<size_t> boundary;
+        vector_table.RegionSearch(region, inside, boundary);
+        ASSERT_FALSE(inside.empty());
+        for(size_t ref : inside) {
+            ASSERT_TRUE(region.IsInside(point_cloud[ref].data()));
+        }
+        inside.insert(inside.end(), boundary.begin(), boundary.end());
+        std::sort(inside.begin(), inside.end());
+        ASSERT_TRUE(std::includes(inside.begin(), inside.end(), expected.begin(), expected.end()));
+    }
+
+    // frustum culling probes a fraction of its bounding box voxels
+    const auto frustum = ConvexRegion<float, 3>::Frustum(near, far);
+    vector_table.ResetCounters();
+    vector_table.ForEachInRegion(frustum, [](size_t, bool) {});
+    const uint64_t region_probes = vector_table.GetCounters().probes_;
+    vector_table.ResetCounters();
+    vector_table.CubeSearch(frustum.GetMin(), frustum.GetMax());
+    ASSERT_LT(region_probes, 0.6 * vector_table.GetCounters().probes_);
+
+    // few points, populated cells are scanned instead of the bounding box
+    SpatialHashTable3DPoints<float, size_t> small_table(voxel_size);
+    for(size_t i = 0; i < 100; ++i) {
+        small_table.Add(point_cloud[i].data(), i);
+    }
+    size_t expected_count = 0;
+    for(size_t i = 0; i < 100; ++i) {
+        expected_count += slab.IsInside(point_cloud[i].data()) ? 1 : 0;
+    }
+    ASSERT_EQ(expected_count, small_table.RegionSearch(slab).size());
+    const float wide_min[3] = {-7.3f, -7.3f, -7.3f};
+    const float wide_max[3] = {7.3f, 7.3f, 7.3f};
+    ConvexRegion<float, 3> wide(wide_min, wide_max);
+    wide.AddHalfSpace(normal, 100.0f);
+    expected_count = 0;
+    for(size_t i = 0; i < 100; ++i) {
+        expected_count += wide.IsInside(point_cloud[i].data()) ? 1 : 0;
+    }
+    ASSERT_LT(0u, expected_count);
+    ASSERT_EQ(expected_count, small_table.RegionSearch(wide).size());
+
+    // triangle
+    const float min_2d[2] = {0.0f, 0.0f};
+    const float max_2d[2] = {4.0f, 4.0f};
+    ConvexRegion<float, 2> triangle(min_2d, max_2d);
+    const float diagonal[2] = {1.0f, 1.0f};
+    triangle.AddHalfSpace(diagonal, 4.0f);
+    SpatialHashTable2DVector<float, size_t> table_2d(voxel_size);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        table_2d.Add(point_cloud[i].data(), i);
+    }
+    std::vector<size_t> result_2d;
+    table_2d.ForEachInPolygon(triangle, [&result_2d](size_t ref, bool) { result_2d.push_back(ref); });
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        if (triangle.IsInside(point_cloud[i].data())) {
+            ASSERT_TRUE(result_2d.end() != std::find(result_2d.begin(), result_2d.end(), i));
+        }
+    }
+    ASSERT_LT(result_2d.size(), table_2d.SquareSearch(min_2d, max_2d).size());
+}
+
+TEST(SpatialHashTable3DRolling, EvictionTest) {
+    std::default_random_engine rng;
+    std::uniform_real_distribution<float> urd(-5.0f, 5.0f);
+    const float voxel_size = 0.5f;
+    const uint32_t window = 10;
+    SpatialHashTable3DRolling<float, size_t> hash_table(voxel_size);
+    std::vector<Eigen::Vector3f> points;
+    std::vector<uint32_t> epochs;
+
+    size_t memory_bytes = 0;
+    for(uint32_t epoch = 0; epoch < 200; ++epoch) {
+        // sensor moves along x axis, scans are around the pose
+        const Eigen::Vector3f pose(0.2f * epoch, 0.0f, 0.0f);
+        for(int i = 0; i < 300; ++i) {
+            points.push_back(pose + Eigen::Vector3f(urd(rng), urd(rng), urd(rng)));
+            epochs.push_back(epoch);
+            hash_table.Add(points.back().data(), points.size() - 1, epoch);
+        }
+
+        const uint32_t oldest = epoch + 1 >= window ? epoch + 1 - window : 0;
+        const size_t expected_evicted = std::count(epochs.begin(), epochs.end(), oldest - 1);
+        ASSERT_EQ(oldest > 0 ? expected_evicted : 0, hash_table.EvictOlderThan(oldest));
+        ASSERT_EQ(oldest, hash_table.GetOldestEpoch());
+        ASSERT_EQ(epoch, hash_table.GetNewestEpoch());
+
+        std::vector<size_t> expected;
+        for(size_t i = 0; i < epochs.size(); ++i) {
+            if (epochs[i] >= oldest) {
+                expected.push_back(i);
+            }
+        }
+        auto result = hash_table.CubeSearch(pose.data(), 20.0f);
+        std::sort(result.begin(), result.end());
+        ASSERT_EQ(expected, result);
+        ASSERT_EQ(expected.size(), hash_table.GetStatistics().ref_count_);
+
+        // memory stops growing once the window is full
+        if (100 == epoch) {
+            memory_bytes = hash_table.GetStatistics().memory_bytes_;
+        }
+    }
+    ASSERT_LT(hash_table.GetStatistics().memory_bytes_, 1.5 * memory_bytes);
+
+    // whole voxels farther than the radius are removed, points within the radius are kept
+    const Eigen::Vector3f pose(0.2f * 199, 0.0f, 0.0f);
+    const float radius = 3.0f;
+    const auto before = hash_table.CubeSearch(pose.data(), 20.0f);
+    const size_t removed = hash_table.EvictFarFrom(pose.data(), radius);
+    const auto after = hash_table.CubeSearch(pose.data(), 20.0f);
+    ASSERT_LT(0, removed);
+    ASSERT_EQ(before.size(), after.size() + removed);
+    for(size_t ref : before) {
+        if ((points[ref] - pose).norm() <= radius) {
+            ASSERT_TRUE(after.end() != std::find(after.begin(), after.end(), ref));
+        }
+    }
+    for(size_t ref : after) {
+        ASSERT_LT((points[ref] - pose).norm(), radius + std::sqrt(3.0f) * voxel_size);
+    }
+
+    // evicting all epochs empties the table
+    ASSERT_EQ(after.size(), hash_table.EvictOlderThan(1000));
+    ASSERT_EQ(0, hash_table.GetStatistics().cell_count_);
+
+    // setting the voxel size drops epoch logs with the voxels
+    hash_table.Add(points[0].data(), 0, 2000);
+    hash_table.SetCellSize(2 * voxel_size);
+    ASSERT_EQ(0u, hash_table.GetOldestEpoch());
+    ASSERT_EQ(0u, hash_table.GetNewestEpoch());
+    hash_table.Add(points[0].data(), 0, 5);
+    ASSERT_EQ(5u, hash_table.GetNewestEpoch());
+    ASSERT_EQ(1u, hash_table.EvictOlderThan(6));
+}
+
+TEST(SpatialHashTable3DPyramid, HierarchicalSearchTest) {
+    std::vector<Eigen::Vector3f> point_cloud;
+    std::default_random_engine rng;
+    std::uniform_real_distribution<float> urd(-10.0f, 10.0f);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    // sphere surface with a dense cluster
+    for(int i = 0; i < 20000; ++i) {
+        Eigen::Vector3f direction(normal(rng), normal(rng), normal(rng));
+        point_cloud.push_back(20.0f * direction.normalized());
+    }
+    for(int i = 0; i < 5000; ++i) {
+        point_cloud.emplace_back(3.0f + 0.2f * normal(rng), -2.0f + 0.2f * normal(rng), 0.2f * normal(rng));
+    }
+
+    const float voxel_size = 0.5f;
+    SpatialHashTable3DVector<float, size_t, FlatHashMapBackend, AtomicCounters> expected_table(voxel_size);
+    SpatialHashTable3DPyramid<float, size_t, FlatHashMapBackend, AtomicCounters> hash_table(voxel_size, 8);
+    SpatialHashTable3DPyramid<float, size_t> built_table(voxel_size, 6);
+    for(size_t i = 0; i < point_cloud.size(); ++i) {
+        expected_table.Add(point_cloud[i].data(), i);
+        hash_table.Add(point_cloud[i].data(), i);
+    }
+    built_table.Build(point_cloud[0].data(), point_cloud.size());
+    ASSERT_EQ(8, hash_table.GetLevelCount());
+    for(size_t level = 1; level < built_table.GetLevelCount(); ++level) {
+        ASSERT_EQ(hash_table.GetLevelTable(level).size(), built_table.GetLevelTable(level).size());
+    }
+
+    for(float radius : {0.0f, 0.3f, 2.0f, 7.0f, 25.0f, 300.0f}) {
+        for(int q = 0; q < 10; ++q) {
+            const Eigen::Vector3f center = q < 5 ? point_cloud[q * 997] : Eigen::Vector3f(urd(rng), urd(rng), urd(rng));
+            auto expected = expected_table.SphereSearch(center.data(), radius);
+            std::sort(expected.begin(), expected.end());
+            auto result = hash_table.SphereSearchHierarchical(center.data(), radius);
+            std::sort(result.begin(), result.end());
+            ASSERT_EQ(expected, result);
+            std::vector<size_t> built_result;
+            built_table.ForEachInSphereHierarchical(center.data(), radius, [&built_result](size_t ref) { built_result.push_back(ref); });
+            std::sort(built_result.begin(), built_result.end());
+            ASSERT_EQ(expected, built_result);
+            ASSERT_EQ(expected.size(), hash_table.CountInSphere(center.data(), radius));
+
+            const Eigen::Vector3f corner = center + Eigen::Vector3f(radius, -0.5f * radius, 2.0f * radius);
+            std::vector<size_t> expected_box;
+            expected_table.ForEachInCube(center.data(), corner.data(), [&expected_box](size_t ref) { expected_box.push_back(ref); });
+            std::vector<size_t> result_box;
+            hash_table.ForEachInBoxHierarchical(center.data(), corner.data(), [&result_box](size_t ref) { result_box.push_back(ref); });
+            std::sort(expected_box.begin(), expected_box.end());
+            std::sort(result_box.begin(), result_box.end());
+            ASSERT_EQ(expected_box, result_box);
+        }
+    }
+
+    // empty blocks of the sphere around the surface are skipped
+    const Eigen::Vector3f center(20.0f, 0.0f, 0.0f);
+    hash_table.ResetCounters();
+    hash_table.SphereSearchHierarchical(center.data(), 4.0f);
+    const uint64_t pyramid_probes = hash_table.GetCounters().probes_;
+    expected_table.ResetCounters();
+    expected_table.SphereSearch(center.data(), 4.0f);
+    ASSERT_LT(pyramid_probes, expected_table.GetCounters().probes_ / 4);
+
+    // coarse levels follow removal
+    for(size_t i = 0; i < point_cloud.size(); i += 2) {
+        ASSERT_TRUE(hash_table.Remove(point_cloud[i].data(), i));
+        expected_table.Remove(point_cloud[i].data(), i);
+    }
+    const Eigen::Vector3f query(3.0f, -2.0f, 0.0f);
+    ASSERT_EQ(expected_table.SphereSearch(query.data(), 1.0f).size(), hash_table.CountInSphere(query.data(), 1.0f));
+    ASSERT_EQ(expected_table.SphereSearch(query.data(), 30.0f).size(), hash_table.CountInSphere(query.data(), 30.0f));
+    hash_table.Clear();
+    ASSERT_EQ(0, hash_table.GetLevelTable(7).size());
+
+    // default levels span three orders of magnitude, setting the voxel size clears coarse levels
+    SpatialHashTable3DPyramid<float, size_t> default_table(voxel_size);
+    ASSERT_EQ(11, default_table.GetLevelCount());
+    ASSERT_EQ(11, (SpatialHashTable3DPyramid<float, size_t>().GetLevelCount()));
+    default_table.Build(point_cloud[0].data(), point_cloud.size());
+    ASSERT_LT(0, default_table.GetLevelTable(10).size());
+    default_table.SetCellSize(2 * voxel_size);
+    for(size_t level = 1; level < default_table.GetLevelCount(); ++level) {
+        ASSERT_EQ(0, default_table.GetLevelTable(level).size());
+    }
+    default_table.Add(point_cloud[0].data(), 0);
+    ASSERT_EQ(1, default_table.CountInSphere(point_cloud[0].data(), 300.0f));
+}
+
+TEST(SpatialHashTable3DVector, SparseScanTest) {
+    // 27 points in distinct voxels, boxes around 27 voxels switch between probing and table scan,
+    // boxes around 64 voxels switch compact table between probing and Z-order walk
+    std::default_random_engine rng;
+    std::uniform_int_distribution<int32_t> uid(-8, 8);
+    std::vector<HashIndex3D> voxels;
+    while (voxels.size() < 27) {
+        HashIndex3D voxel(uid(rng), uid(rng), uid(rng));
+        if (std::find(voxels.begin(), voxels.end(), voxel) == voxels.end()) {
+            voxels.push_back(voxel);
+        }
+    }
+
+    SpatialHashTable3DVector<float, size_t> hash_table(1.0f);
+    SpatialHashTable3DVector<float, size_t, FlatHashMapBackend> flat_table(1.0f);
+    SpatialHashTable2DVector<float, size_t> table_2d(1.0f);
+    ConcurrentSpatialHashTable3D<float, size_t> concurrent_table(1.0f, 4);
+    std::vector<Eigen::Vector3f> point_cloud;
+    for(size_t i = 0; i < voxels.size(); ++i) {
+        point_cloud.emplace_back(voxels[i].x_ + 0.5f, voxels[i].y_ + 0.5f, voxels[i].z_ + 0.5f);
+        hash_table.Add(point_cloud[i].data(), i);
+        flat_table.Add(point_cloud[i].data(), i);
+        concurrent_table.Add(point_cloud[i].data(), i);
+    }
+    SpatialHashTable3DCompact<float, size_t> compact_table(1.0f);
+    compact_table.Build(point_cloud[0].data(), point_cloud.size());
+
+    // 2D table keeps one point per distinct (x, y) cell
+    std::vector<HashIndex2D> cells;
+    std::vector<size_t> cell_refs;
+    for(size_t i = 0; i < voxels.size(); ++i) {
+        HashIndex2D cell(voxels[i].x_, voxels[i].y_);
+        if (std::find(cells.begin(), cells.end(), cell) == cells.end()) {
+            cells.push_back(cell);
+            cell_refs.push_back(i);
+            const float point[2] = {cell.x_ + 0.5f, cell.y_ + 0.5f};
+            table_2d.Add(point, i);
+        }
+    }
+
+    const int32_t sizes[][3] = {{3, 3, 3}, {26, 1, 1}, {27, 1, 1}, {28, 1, 1}, {4, 4, 4}, {5, 13, 1}, {40, 40, 40}};
+    for(int i = 0; i < 100; ++i) {
+        for(const auto& size : sizes) {
+            const HashIndex3D corner_min(uid(rng), uid(rng), uid(rng));
+            const HashIndex3D corner_max(corner_min.x_ + size[0] - 1, corner_min.y_ + size[1] - 1, corner_min.z_ + size[2] - 1);
+            std::vector<size_t> expected;
+            for(size_t j = 0; j < voxels.size(); ++j) {
+                if (corner_min.x_ <= voxels[j].x_ && voxels[j].x_ <= corner_max.x_ && corner_min.y_ <= voxels[j].y_ &&
+                    voxels[j].y_ <= corner_max.y_ && corner_min.z_ <= voxels[j].z_ && voxels[j].z_ <= corner_max.z_) {
+                    expected.push_back(j);
+                }
+            }
+
+            auto result = hash_table.CubeSearch(corner_min, corner_max);
+            std::sort(result.begin(), result.end());
+            ASSERT_EQ(expected, result);
+            result = flat_table.CubeSearch(corner_min, corner_max);
+            std::sort(result.begin(), result.end());
+            ASSERT_EQ(expected, result);
+            result = compact_table.CubeSearch(corner_min, corner_max);
+            std::sort(result.begin(), result.end());
+            ASSERT_EQ(expected, result);
+            result.clear();
+            concurrent_table.CubeSearch(corner_min, corner_max, result);
+            std::sort(result.begin(), result.end());
+            ASSERT_EQ(expected, result);
+
+            const HashIndex2D left_top(corner_min.x_, corner_min.y_);
+            const HashIndex2D right_bottom(corner_min.x_ + size[0] * size[2] - 1, corner_max.y_);
+            std::vector<size_t> expected_2d;
+            for(size_t j = 0; j < cells.size(); ++j) {
+                if (left_top.x_ <= cells[j].x_ && cells[j].x_ <= right_bottom.x_ && left_top.y_ <= cells[j].y_ && cells[j].y_ <= right_bottom.y_) {
+                    expected_2d.push_back(cell_refs[j]);
+                }
+            }
+            std::vector<size_t> result_2d;
+            table_2d.ForEachInSquare(left_top, right_bottom, [&result_2d](size_t idx) {
+                result_2d.push_back(idx);
+            });
+            std::sort(expected_2d.begin(), expected_2d.end());
+            std::sort(result_2d.begin(), result_2d.end());
+            ASSERT_EQ(expected_2d, result_2d);
+        }
+    }
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();